@@ -0,0 +1,84 @@
+/*
+  Groups generated NDJSON log records in memory with json-agg.h: by a low cardinality key on an
+  increasing number of threads, then by a high cardinality one with and without spilling.
+
+  Usage: ./bench_bin
+*/
+#define JSONREAD_IMPL
+#define JSONWRITE_IMPL
+#define JSONAGG_IMPL
+#define JSONAGG_POSIX
+#include "../json-agg.h"
+#include <time.h>
+
+static const int record_count = 2000000;
+
+static double now_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static unsigned long generate(char *buf, unsigned long size) {
+  unsigned long used = 0;
+  int i;
+
+  for(i = 0; i < record_count && used < size; i++) {
+    used += snprintf(buf + used, size - used,
+      "{\"status\": %d, \"latency\": %d, \"method\": \"%s\", \"path\": \"/api/v1/items/%d\", "
+      "\"user\": {\"id\": %d, \"name\": \"user %d\"}, \"bytes\": %d}\n",
+      i % 100 == 0 ? 500 : 200, (int)((i * 7919ul) % 1000), i & 1 ? "GET" : "POST", (int)((i * 104729ul) % 500000), i % 5000, i % 5000, i * 3);
+  }
+  return used;
+}
+
+static void run(const char *what, const char *data, unsigned long length, const JSON_Agg_Column *columns, int column_count, int threads, unsigned long max_groups) {
+  static JSON_Agg agg;
+  JSON_Write_Data json;
+  double start, ms;
+  int ok;
+
+  start = now_ms();
+  jsona_init(&agg, columns, column_count, max_groups);
+  ok = jsona_feed_mem_parallel(&agg, data, length, threads);
+
+  jsonw_init(&json, fopen("/dev/null", "wb"));
+  ok = ok && jsona_write(&agg, &json);
+  jsonw_finish(&json);
+  fclose(json.f);
+  jsona_free(&agg);
+
+  ms = now_ms() - start;
+  printf("%-30s %2d threads %9.2f ms %8.1f MB/s%s\n", what, threads, ms, length / (ms * 1000.0), ok ? "" : "   (ERROR)");
+}
+
+int main() {
+  JSON_Agg_Column by_method[] = {
+    { JSONA_GROUP, "/method", "method" },
+    { JSONA_GROUP, "/status", "status" },
+    { JSONA_COUNT, 0, "count" },
+    { JSONA_SUM, "/latency", "latency_sum" },
+    { JSONA_MAX, "/latency", "latency_max" },
+    { JSONA_DISTINCT, "/user/id", "users" },
+  };
+  JSON_Agg_Column by_path[] = {
+    { JSONA_GROUP, "/path", "path" },
+    { JSONA_COUNT, 0, "count" },
+    { JSONA_SUM, "/bytes", "bytes" },
+  };
+  int threads[] = { 1, 2, 4, 8 };
+  unsigned long size = record_count * 192ul;
+  char *data = (char*)malloc(size);
+  unsigned long length;
+  int i;
+
+  if(!data) { printf("out of memory\n"); return 1; }
+  length = generate(data, size);
+
+  for(i = 0; i < 4; i++) run("method, status", data, length, by_method, 6, threads[i], 0);
+  for(i = 0; i < 4; i++) run("path (500k groups)", data, length, by_path, 3, threads[i], 0);
+  for(i = 0; i < 4; i++) run("path, spilling at 20k groups", data, length, by_path, 3, threads[i], 20000);
+
+  free(data);
+  return 0;
+}
@@ -0,0 +1,90 @@
+/*
+  Reads one generated top-level array of pretty printed records in memory with
+  jsonr_v_array_parallel on an increasing number of threads.
+
+  Usage: ./bench_bin
+*/
+#define JSONREAD_IMPL
+#define JSONREAD_POSIX
+#include "../json-read.h"
+#include <time.h>
+
+static const int record_count = 500000;
+
+typedef struct {
+  double sums[JSONR_THREADS];
+} Totals;
+
+static double now_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static unsigned long generate(char *buf, unsigned long size) {
+  unsigned long used = 0;
+  int i;
+
+  used += snprintf(buf + used, size - used, "[\n");
+  for(i = 0; i < record_count && used < size; i++) {
+    used += snprintf(buf + used, size - used,
+      "%s  {\n    \"id\": %d,\n    \"name\": \"entity %d, \\\"[%d]\\\"\",\n    \"pos\": [%d.5, %d.25, 0],\n    \"tags\": [{\"k\": \"a\"}, {\"k\": \"b\"}]\n  }",
+      i ? ",\n" : "", i, i, i, i, i * 2);
+  }
+  used += snprintf(buf + used, size - used, "\n]\n");
+  return used;
+}
+
+/* Reads every value. */
+static double read_value(JSON_Read_Data *j) {
+  double sum = 0;
+  char *str;
+  unsigned long len;
+
+  switch(jsonr_v_get_type(j)) {
+    case JSONR_V_TABLE: jsonr_v_table(j) { jsonr_k(j, &str, &len); sum += read_value(j); } break;
+    case JSONR_V_ARRAY: jsonr_v_array(j) { sum += read_value(j); } break;
+    case JSONR_V_NUMBER: sum += jsonr_v_number(j); break;
+    case JSONR_V_STRING: jsonr_v_string(j, &str, &len); sum += len; break;
+    default: jsonr_v_skip(j); break;
+  }
+  return sum;
+}
+
+/* Every thread has its own sum, nothing to lock. */
+static void read_element(JSON_Read_Data *j, int thread, void *user) {
+  Totals *totals = (Totals*)user;
+  totals->sums[thread] += read_value(j);
+}
+
+static void run(const char *data, unsigned long length, int threads) {
+  static Totals totals;
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+  double start, ms, sum = 0;
+  int i;
+
+  memset(&totals, 0, sizeof(totals));
+  start = now_ms();
+  jsonr_init_mem(j, data, length);
+  jsonr_v_array_parallel(j, threads, read_element, &totals);
+  ms = now_ms() - start;
+  for(i = 0; i < JSONR_THREADS; i++) sum += totals.sums[i];
+  printf("%d records %2d threads %9.2f ms %8.1f MB/s%s (%g)\n", record_count, threads, ms, length / (ms * 1000.0), j->error ? "   (ERROR)" : "", sum);
+}
+
+int main() {
+  unsigned long size = record_count * 160ul;
+  char *data = (char*)malloc(size);
+  unsigned long length;
+  int threads[] = { 1, 2, 4, 8 };
+  int i;
+
+  if(!data) { printf("out of memory\n"); return 1; }
+  length = generate(data, size);
+
+  for(i = 0; i < 4; i++) run(data, length, threads[i]);
+
+  free(data);
+  return 0;
+}
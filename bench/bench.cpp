@@ -0,0 +1,853 @@
+/*
+  Reader and writer throughput benchmarks.
+
+  Generates reproducible corpora of different shapes, runs every reader entry point over the
+  corpora it makes sense for and every writer entry point into a discarding sink. A summary is
+  printed to stderr, the results are written as json to stdout or to the given file.
+
+  With -p, cycles, instructions, branch misses and cache misses are collected for every case with
+  perf_event_open. If the counters can't be opened (containers, perf_event_paranoid) the
+  benchmarks still run and only report wall clock time.
+
+  With -b, results are compared against a previous results file. Every metric that got worse by
+  more than -t percent (default 5) is reported and the exit code is 2.
+
+  Usage: ./bench_bin [-o results.json] [-s corpus size in MB] [-r repetitions] [-p]
+                     [-b baseline.json] [-t threshold percent]
+*/
+#define JSONREAD_IMPL
+#include "../json-read.h"
+#define JSONWRITE_IMPL
+#include "../json-write.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+typedef struct {
+  const char *name;
+  char *data;
+  unsigned long size;
+  unsigned long values; /* scalar values in the corpus */
+} Corpus;
+
+enum {
+  COUNTER_CYCLES,
+  COUNTER_INSTRUCTIONS,
+  COUNTER_BRANCH_MISSES,
+  COUNTER_CACHE_MISSES,
+  COUNTER_COUNT,
+};
+
+static const char * counter_names[COUNTER_COUNT] = {
+  "cycles", "instructions", "branch_misses", "cache_misses",
+};
+
+typedef struct {
+  const char *name;
+  const char *corpus;
+  unsigned long bytes;
+  unsigned long values;
+  double seconds;
+  int has_counters;
+  unsigned long long counters[COUNTER_COUNT];
+} Result;
+
+enum {
+  CORPUS_NUMERIC,
+  CORPUS_STRINGS,
+  CORPUS_NESTED,
+  CORPUS_WIDE,
+  CORPUS_PRETTY,
+  CORPUS_NDJSON,
+  CORPUS_COUNT,
+};
+
+static const int wide_key_count = 32;
+static const char * wide_keys[] = {
+  "k00","k01","k02","k03","k04","k05","k06","k07","k08","k09","k10","k11","k12","k13","k14","k15",
+  "k16","k17","k18","k19","k20","k21","k22","k23","k24","k25","k26","k27","k28","k29","k30","k31",
+};
+
+static unsigned long corpus_size = 1024*1024*4;
+static int repetitions = 5;
+
+static Corpus corpora[CORPUS_COUNT];
+static Result results[256];
+static int result_count;
+
+static int counter_fds[COUNTER_COUNT] = { -1, -1, -1, -1 };
+static int counters_enabled;
+
+/* Keeps the compiler from throwing the parsed values away. */
+static volatile double sink_value;
+
+/* ============================================ */
+/* ============== Helpers ===================== */
+/* ============================================ */
+
+static unsigned long long rng_state = 0x9E3779B97F4A7C15ull;
+
+static unsigned long long rng() {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return rng_state;
+}
+
+static double now_seconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* ============================================ */
+/* ============== Perf counters =============== */
+/* ============================================ */
+
+static void open_counters() {
+  static const unsigned long long configs[COUNTER_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_BRANCH_MISSES,
+    PERF_COUNT_HW_CACHE_MISSES,
+  };
+  struct perf_event_attr attr;
+  int i;
+
+  for(i = 0; i < COUNTER_COUNT; i++) {
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = configs[i];
+    attr.disabled = i == 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+
+    counter_fds[i] = syscall(__NR_perf_event_open, &attr, 0, -1, i == 0 ? -1 : counter_fds[0], 0);
+    if(counter_fds[i] < 0) {
+      fprintf(stderr, "perf counters unavailable (%s), only measuring time.\n", counter_names[i]);
+      for(i = i - 1; i >= 0; i--) {
+        close(counter_fds[i]);
+        counter_fds[i] = -1;
+      }
+      return;
+    }
+  }
+  counters_enabled = 1;
+}
+
+static void start_counters() {
+  if(!counters_enabled) return;
+  ioctl(counter_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(counter_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+static int stop_counters(unsigned long long *out) {
+  unsigned long long values[1 + COUNTER_COUNT];
+  int i;
+
+  if(!counters_enabled) return 0;
+  ioctl(counter_fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+  if(read(counter_fds[0], values, sizeof(values)) != sizeof(values) || values[0] != COUNTER_COUNT) {
+    return 0;
+  }
+  for(i = 0; i < COUNTER_COUNT; i++) {
+    out[i] = values[1 + i];
+  }
+  return 1;
+}
+
+static void add_result(const char *name, const char *corpus, unsigned long bytes, unsigned long values, double seconds, int has_counters, unsigned long long *counters) {
+  Result *r = &results[result_count++];
+  int i;
+
+  r->name = name;
+  r->corpus = corpus;
+  r->bytes = bytes;
+  r->values = values;
+  r->seconds = seconds;
+  r->has_counters = has_counters;
+
+  fprintf(stderr, "%-24s %-10s %9.2f MB/s %9.2f ns/value",
+    name, corpus, bytes / seconds / (1024*1024), seconds * 1e9 / (values ? values : 1));
+
+  if(has_counters) {
+    for(i = 0; i < COUNTER_COUNT; i++) r->counters[i] = counters[i];
+    fprintf(stderr, "  %6.2f IPC %8.2f branch-miss/value %8.2f cache-miss/value",
+      (double)counters[COUNTER_INSTRUCTIONS] / (counters[COUNTER_CYCLES] ? counters[COUNTER_CYCLES] : 1),
+      (double)counters[COUNTER_BRANCH_MISSES] / (values ? values : 1),
+      (double)counters[COUNTER_CACHE_MISSES] / (values ? values : 1));
+  }
+  fputc('\n', stderr);
+}
+
+/* ============================================ */
+/* ============== Corpus generation =========== */
+/* ============================================ */
+
+static void random_string(char *buf, unsigned long *len) {
+  static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789/._-";
+  unsigned long i;
+
+  *len = rng() % 64;
+  for(i = 0; i < *len; i++) {
+    if(rng() % 32 == 0) buf[i] = "\n\t\"\\"[rng() % 4];
+    else buf[i] = alphabet[rng() % (sizeof(alphabet) - 1)];
+  }
+}
+
+static void random_number(JSON_Write_Data *j) {
+  if(rng() & 1) jsonw_v_int(j, (long)(rng() % 2000000) - 1000000);
+  else jsonw_v_float(j, ((long)(rng() % 2000000) - 1000000) / 64.0);
+}
+
+static void wide_record(JSON_Write_Data *j, Corpus *c) {
+  char str[64];
+  unsigned long len;
+  int k;
+
+  jsonw_v_table_begin(j);
+  for(k = 0; k < wide_key_count; k++) {
+    jsonw_k(j, wide_keys[k]);
+    if(k % 8 == 7) {
+      random_string(str, &len);
+      jsonw_v_stringlen(j, str, len);
+    }
+    else {
+      random_number(j);
+    }
+    c->values++;
+  }
+  jsonw_v_table_end(j);
+}
+
+static void nested_value(JSON_Write_Data *j, Corpus *c, int depth) {
+  if(depth == 0) {
+    random_number(j);
+    c->values++;
+    return;
+  }
+
+  if(depth & 1) {
+    jsonw_v_table_begin(j);
+      jsonw_k(j, "a");
+      nested_value(j, c, depth - 1);
+      jsonw_kv_bool(j, "flag", depth & 2);
+      c->values++;
+    jsonw_v_table_end(j);
+  }
+  else {
+    jsonw_v_array_begin(j);
+      nested_value(j, c, depth - 1);
+      jsonw_v_int(j, depth);
+      c->values++;
+    jsonw_v_array_end(j);
+  }
+}
+
+/* Re-indent minified json with two spaces per level. */
+static char * prettify(const char *src, unsigned long size, unsigned long *out_size) {
+  char *out = (char*)malloc(size * 8 + 64);
+  unsigned long o = 0;
+  unsigned long i;
+  int in_string = 0;
+  int escaped = 0;
+  int indent = 0;
+  int k;
+  char c;
+
+  for(i = 0; i < size; i++) {
+    c = src[i];
+
+    if(in_string) {
+      out[o++] = c;
+      if(escaped) escaped = 0;
+      else if(c == '\\') escaped = 1;
+      else if(c == '\"') in_string = 0;
+      continue;
+    }
+
+    if(c == '{' || c == '[') {
+      out[o++] = c;
+      out[o++] = '\n';
+      indent++;
+      for(k = 0; k < indent*2; k++) out[o++] = ' ';
+    }
+    else if(c == '}' || c == ']') {
+      out[o++] = '\n';
+      indent--;
+      for(k = 0; k < indent*2; k++) out[o++] = ' ';
+      out[o++] = c;
+    }
+    else if(c == ',') {
+      out[o++] = c;
+      out[o++] = '\n';
+      for(k = 0; k < indent*2; k++) out[o++] = ' ';
+    }
+    else if(c == ':') {
+      out[o++] = ' ';
+      out[o++] = ':';
+      out[o++] = ' ';
+    }
+    else {
+      if(c == '\"') in_string = 1;
+      out[o++] = c;
+    }
+  }
+
+  *out_size = o;
+  return out;
+}
+
+static void generate_corpora() {
+  JSON_Write_Data json;
+  JSON_Write_Data * j = &json;
+  Corpus *c;
+  char str[64];
+  unsigned long len;
+
+  c = &corpora[CORPUS_NUMERIC];
+  c->name = "numeric";
+  jsonw_init_mem(j, corpus_size);
+  jsonw_v_table_begin(j);
+    jsonw_k(j, "values");
+    jsonw_v_array_begin(j);
+    while(j->buf_used < corpus_size) {
+      random_number(j);
+      c->values++;
+    }
+    jsonw_v_array_end(j);
+  jsonw_v_table_end(j);
+  c->data = j->buf; c->size = j->buf_used;
+
+  c = &corpora[CORPUS_STRINGS];
+  c->name = "strings";
+  jsonw_init_mem(j, corpus_size);
+  jsonw_v_table_begin(j);
+    jsonw_k(j, "strings");
+    jsonw_v_array_begin(j);
+    while(j->buf_used < corpus_size) {
+      random_string(str, &len);
+      jsonw_v_stringlen(j, str, len);
+      c->values++;
+    }
+    jsonw_v_array_end(j);
+  jsonw_v_table_end(j);
+  c->data = j->buf; c->size = j->buf_used;
+
+  c = &corpora[CORPUS_NESTED];
+  c->name = "nested";
+  jsonw_init_mem(j, corpus_size);
+  jsonw_v_array_begin(j);
+    while(j->buf_used < corpus_size) {
+      nested_value(j, c, 32);
+    }
+  jsonw_v_array_end(j);
+  c->data = j->buf; c->size = j->buf_used;
+
+  c = &corpora[CORPUS_WIDE];
+  c->name = "wide";
+  jsonw_init_mem(j, corpus_size);
+  jsonw_v_array_begin(j);
+    while(j->buf_used < corpus_size) {
+      wide_record(j, c);
+    }
+  jsonw_v_array_end(j);
+  c->data = j->buf; c->size = j->buf_used;
+
+  c = &corpora[CORPUS_PRETTY];
+  c->name = "pretty";
+  c->values = corpora[CORPUS_WIDE].values;
+  c->data = prettify(corpora[CORPUS_WIDE].data, corpora[CORPUS_WIDE].size, &c->size);
+
+  c = &corpora[CORPUS_NDJSON];
+  c->name = "ndjson";
+  jsonw_init_mem(j, corpus_size);
+  while(j->buf_used < corpus_size) {
+    wide_record(j, c);
+    j->do_comma = 0;
+    jsonw_v_raw(j, "\n", 1);
+    j->do_comma = 0;
+  }
+  c->data = j->buf; c->size = j->buf_used;
+}
+
+/* ============================================ */
+/* ============== Reader benchmarks =========== */
+/* ============================================ */
+
+typedef void (*Read_Proc)(JSON_Read_Data *j, Corpus *c);
+
+static void read_skip(JSON_Read_Data *j, Corpus *c) {
+  if(c == &corpora[CORPUS_NDJSON]) {
+    while(!j->error && jsonr_v_get_type(j) != JSONR_V_INVALID) {
+      jsonr_v_skip(j);
+    }
+    return;
+  }
+  jsonr_v_skip(j);
+}
+
+static void read_numbers(JSON_Read_Data *j, Corpus *c) {
+  double sum = 0;
+
+  (void)c;
+
+  jsonr_v_table(j) {
+    if(jsonr_k_case(j, "values")) {
+      jsonr_v_array(j) {
+        sum += jsonr_v_number(j);
+      }
+    }
+    else {
+      jsonr_kv_skip(j);
+    }
+  }
+  sink_value = sum;
+}
+
+static void read_strings(JSON_Read_Data *j, Corpus *c) {
+  static char buf[1024];
+  unsigned long total = 0;
+  unsigned long len;
+
+  (void)c;
+
+  jsonr_v_table(j) {
+    if(jsonr_k_case(j, "strings")) {
+      jsonr_v_array(j) {
+        len = 0;
+        jsonr_begin_read_string(j);
+        jsonr_read_string(j, buf, sizeof(buf), &len);
+        jsonr_maybe_read_comma(j);
+        total += len;
+      }
+    }
+    else {
+      jsonr_kv_skip(j);
+    }
+  }
+  sink_value = total;
+}
+
+static void read_wide_record(JSON_Read_Data *j) {
+  char *str;
+  unsigned long len;
+  double sum = 0;
+  int k;
+
+  jsonr_v_table(j) {
+    /* Every key is tested against the list in order, like a hand written loader would. */
+    for(k = 0; k < wide_key_count; k++) {
+      if(jsonr_k_case(j, wide_keys[k])) {
+        if(k % 8 == 7) {
+          jsonr_v_string(j, &str, &len);
+          sum += len;
+        }
+        else {
+          sum += jsonr_v_number(j);
+        }
+        break;
+      }
+    }
+    if(k == wide_key_count) {
+      jsonr_kv_skip(j);
+    }
+  }
+  sink_value = sum;
+}
+
+static void read_k_case(JSON_Read_Data *j, Corpus *c) {
+  if(c == &corpora[CORPUS_NDJSON]) {
+    while(!j->error && jsonr_v_get_type(j) == JSONR_V_TABLE) {
+      read_wide_record(j);
+    }
+    return;
+  }
+
+  jsonr_v_array(j) {
+    read_wide_record(j);
+  }
+}
+
+static void bench_reader(const char *name, Read_Proc proc, Corpus *c) {
+  JSON_Read_Data json;
+  unsigned long long counters[COUNTER_COUNT];
+  unsigned long long best_counters[COUNTER_COUNT];
+  int has_counters = 0;
+  double best = 1e30;
+  double start, took;
+  FILE *f;
+  int r;
+
+  for(r = 0; r < repetitions; r++) {
+    f = fmemopen(c->data, c->size, "rb");
+
+    start = now_seconds();
+    start_counters();
+    jsonr_init(&json, f);
+    proc(&json, c);
+    has_counters = stop_counters(counters);
+    took = now_seconds() - start;
+
+    fclose(f);
+
+    if(json.error) {
+      fprintf(stderr, "%s on %s failed: %s\n", name, c->name, jsonr_error_message(&json, 0));
+      return;
+    }
+    if(took < best) {
+      best = took;
+      memcpy(best_counters, counters, sizeof(counters));
+    }
+  }
+
+  add_result(name, c->name, c->size, c->values, best, has_counters, best_counters);
+}
+
+/* ============================================ */
+/* ============== Writer benchmarks =========== */
+/* ============================================ */
+
+static const unsigned long write_count = 1000000;
+
+static long write_ints[1024];
+static double write_floats[1024];
+static const char * write_strings[1024];
+
+static int discard_flush(JSON_Write_Data *json, int finish) {
+  (void)finish;
+  *(unsigned long*)json->user += json->buf_used;
+  json->buf_used = 0;
+  return 1;
+}
+
+typedef void (*Write_Proc)(JSON_Write_Data *j);
+
+static void write_int(JSON_Write_Data *j) {
+  unsigned long i;
+  for(i = 0; i < write_count; i++) jsonw_v_int(j, write_ints[i & 1023]);
+}
+
+static void write_uint(JSON_Write_Data *j) {
+  unsigned long i;
+  for(i = 0; i < write_count; i++) jsonw_v_uint(j, (unsigned long)write_ints[i & 1023]);
+}
+
+static void write_float(JSON_Write_Data *j) {
+  unsigned long i;
+  for(i = 0; i < write_count; i++) jsonw_v_float(j, write_floats[i & 1023]);
+}
+
+static void write_bool(JSON_Write_Data *j) {
+  unsigned long i;
+  for(i = 0; i < write_count; i++) jsonw_v_bool(j, i & 1);
+}
+
+static void write_string(JSON_Write_Data *j) {
+  unsigned long i;
+  for(i = 0; i < write_count; i++) jsonw_v_string(j, write_strings[i & 1023]);
+}
+
+static void write_kv_int(JSON_Write_Data *j) {
+  unsigned long i;
+  jsonw_v_table_begin(j);
+  for(i = 0; i < write_count; i++) jsonw_kv_int(j, wide_keys[i & 31], write_ints[i & 1023]);
+  jsonw_v_table_end(j);
+}
+
+static void write_tables(JSON_Write_Data *j) {
+  unsigned long i;
+  for(i = 0; i < write_count; i++) {
+    jsonw_v_table_begin(j);
+    jsonw_v_table_end(j);
+  }
+}
+
+static void write_int_array(JSON_Write_Data *j) {
+  unsigned long i;
+  for(i = 0; i < write_count; i += 1024) jsonw_v_int_array(j, write_ints, 1024, 0);
+}
+
+static void write_float_array(JSON_Write_Data *j) {
+  unsigned long i;
+  for(i = 0; i < write_count; i += 1024) jsonw_v_float_array(j, write_floats, 1024, 0);
+}
+
+static void write_string_array(JSON_Write_Data *j) {
+  unsigned long i;
+  for(i = 0; i < write_count; i += 1024) jsonw_v_string_array(j, write_strings, 1024, 0);
+}
+
+static void write_raw(JSON_Write_Data *j) {
+  unsigned long i;
+  for(i = 0; i < write_count; i++) jsonw_v_raw(j, "{\"a\":[1,2,3]}", 13);
+}
+
+static void bench_writer(const char *name, Write_Proc proc) {
+  static char buf[1024*64];
+  JSON_Write_Data json;
+  unsigned long long counters[COUNTER_COUNT];
+  unsigned long long best_counters[COUNTER_COUNT];
+  int has_counters = 0;
+  unsigned long written;
+  double best = 1e30;
+  double start, took;
+  int r;
+
+  for(r = 0; r < repetitions; r++) {
+    written = 0;
+
+    start = now_seconds();
+    start_counters();
+    jsonw_init_sink(&json, buf, sizeof(buf), discard_flush, &written);
+    jsonw_v_array_begin(&json);
+    proc(&json);
+    jsonw_v_array_end(&json);
+    jsonw_finish(&json);
+    has_counters = stop_counters(counters);
+    took = now_seconds() - start;
+
+    if(took < best) {
+      best = took;
+      memcpy(best_counters, counters, sizeof(counters));
+    }
+  }
+
+  add_result(name, "-", written, write_count, best, has_counters, best_counters);
+}
+
+static void generate_write_data() {
+  static char strings[1024][64];
+  unsigned long len;
+  int i;
+
+  for(i = 0; i < 1024; i++) {
+    write_ints[i] = (long)(rng() % 2000000000) - 1000000000;
+    write_floats[i] = write_ints[i] / 1024.0;
+    random_string(strings[i], &len);
+    strings[i][len] = 0;
+    write_strings[i] = strings[i];
+  }
+}
+
+/* ============================================ */
+/* ============== Output ====================== */
+/* ============================================ */
+
+static void write_results(FILE *f) {
+  JSON_Write_Data json;
+  JSON_Write_Data * j = &json;
+  Result *r;
+  int i, k;
+
+  jsonw_init(j, f);
+  jsonw_v_table_begin(j);
+    jsonw_kv_int(j, "version", 1);
+    jsonw_kv_uint(j, "corpus_size", corpus_size);
+    jsonw_kv_int(j, "repetitions", repetitions);
+    jsonw_kv_bool(j, "counters", counters_enabled);
+
+    jsonw_k(j, "results");
+    jsonw_v_array_begin(j);
+    for(i = 0; i < result_count; i++) {
+      r = &results[i];
+      jsonw_v_table_begin(j);
+        jsonw_kv_string(j, "name", r->name);
+        jsonw_kv_string(j, "corpus", r->corpus);
+        jsonw_kv_uint(j, "bytes", r->bytes);
+        jsonw_kv_uint(j, "values", r->values);
+        jsonw_kv_float(j, "seconds", r->seconds);
+        jsonw_kv_float(j, "mb_per_s", r->bytes / r->seconds / (1024*1024));
+        jsonw_kv_float(j, "ns_per_value", r->seconds * 1e9 / (r->values ? r->values : 1));
+        if(r->has_counters) {
+          for(k = 0; k < COUNTER_COUNT; k++) {
+            jsonw_kv_uint(j, counter_names[k], r->counters[k]);
+          }
+        }
+      jsonw_v_table_end(j);
+    }
+    jsonw_v_array_end(j);
+  jsonw_v_table_end(j);
+  fputc('\n', f);
+  jsonw_finish(j);
+}
+
+/* ============================================ */
+/* ============== Baseline comparison ========= */
+/* ============================================ */
+
+static Result * find_result(const char *name, unsigned long name_len, const char *corpus, unsigned long corpus_len) {
+  int i;
+
+  for(i = 0; i < result_count; i++) {
+    if(strlen(results[i].name) == name_len && memcmp(results[i].name, name, name_len) == 0 &&
+       strlen(results[i].corpus) == corpus_len && memcmp(results[i].corpus, corpus, corpus_len) == 0) {
+      return &results[i];
+    }
+  }
+  return 0;
+}
+
+static int check_metric(Result *r, const char *metric, double baseline, double current, double threshold) {
+  double change;
+
+  if(baseline <= 0) return 0;
+
+  change = (current - baseline) / baseline * 100;
+  if(change > threshold) {
+    fprintf(stderr, "REGRESSION %-24s %-10s %-14s %+7.2f%%\n", r->name, r->corpus, metric, change);
+    return 1;
+  }
+  return 0;
+}
+
+/* Returns the number of regressed metrics, or -1 if the baseline couldn't be read. */
+static int compare_baseline(const char *path, double threshold) {
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+  char name[128], corpus[128];
+  unsigned long name_len, corpus_len;
+  double seconds;
+  double counters[COUNTER_COUNT];
+  int has_counter[COUNTER_COUNT];
+  int regressions = 0;
+  Result *r;
+  char *str;
+  unsigned long len;
+  int k;
+  FILE *f;
+
+  f = fopen(path, "rb");
+  if(!f) {
+    fprintf(stderr, "can't open baseline %s\n", path);
+    return -1;
+  }
+
+  jsonr_init(j, f);
+  jsonr_v_table(j) {
+    if(!jsonr_k_case(j, "results")) {
+      jsonr_kv_skip(j);
+      continue;
+    }
+
+    jsonr_v_array(j) {
+      name_len = corpus_len = 0;
+      seconds = 0;
+      memset(has_counter, 0, sizeof(has_counter));
+
+      jsonr_v_table(j) {
+        if(jsonr_k_case(j, "name")) {
+          jsonr_v_string(j, &str, &len);
+          name_len = len < sizeof(name) ? len : sizeof(name);
+          memcpy(name, str, name_len);
+        }
+        else if(jsonr_k_case(j, "corpus")) {
+          jsonr_v_string(j, &str, &len);
+          corpus_len = len < sizeof(corpus) ? len : sizeof(corpus);
+          memcpy(corpus, str, corpus_len);
+        }
+        else if(jsonr_k_case(j, "seconds")) {
+          seconds = jsonr_v_number(j);
+        }
+        else {
+          for(k = 0; k < COUNTER_COUNT; k++) {
+            if(jsonr_k_case(j, counter_names[k])) {
+              counters[k] = jsonr_v_number(j);
+              has_counter[k] = 1;
+              break;
+            }
+          }
+          if(k == COUNTER_COUNT) jsonr_kv_skip(j);
+        }
+      }
+
+      r = find_result(name, name_len, corpus, corpus_len);
+      if(!r) continue;
+
+      regressions += check_metric(r, "seconds", seconds, r->seconds, threshold);
+      if(r->has_counters) {
+        for(k = 0; k < COUNTER_COUNT; k++) {
+          if(has_counter[k]) {
+            regressions += check_metric(r, counter_names[k], counters[k], (double)r->counters[k], threshold);
+          }
+        }
+      }
+    }
+  }
+  fclose(f);
+
+  if(j->error) {
+    fprintf(stderr, "can't parse baseline %s: %s\n", path, jsonr_error_message(j, 0));
+    return -1;
+  }
+  return regressions;
+}
+
+int main(int argc, char **argv) {
+  const char *out_path = 0;
+  const char *baseline_path = 0;
+  double threshold = 5;
+  int regressions = 0;
+  FILE *out;
+  int i;
+
+  for(i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "-p") == 0) open_counters();
+    else if(i + 1 >= argc) break;
+    else if(strcmp(argv[i], "-o") == 0) out_path = argv[++i];
+    else if(strcmp(argv[i], "-s") == 0) corpus_size = strtoul(argv[++i], 0, 10) * 1024*1024;
+    else if(strcmp(argv[i], "-r") == 0) repetitions = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-b") == 0) baseline_path = argv[++i];
+    else if(strcmp(argv[i], "-t") == 0) threshold = atof(argv[++i]);
+  }
+
+  generate_corpora();
+  generate_write_data();
+
+  for(i = 0; i < CORPUS_COUNT; i++) {
+    bench_reader("jsonr_v_skip", read_skip, &corpora[i]);
+  }
+  bench_reader("jsonr_v_number", read_numbers, &corpora[CORPUS_NUMERIC]);
+  bench_reader("jsonr_read_string", read_strings, &corpora[CORPUS_STRINGS]);
+  bench_reader("jsonr_k_case", read_k_case, &corpora[CORPUS_WIDE]);
+  bench_reader("jsonr_k_case", read_k_case, &corpora[CORPUS_PRETTY]);
+  bench_reader("jsonr_k_case", read_k_case, &corpora[CORPUS_NDJSON]);
+
+  bench_writer("jsonw_v_int", write_int);
+  bench_writer("jsonw_v_uint", write_uint);
+  bench_writer("jsonw_v_float", write_float);
+  bench_writer("jsonw_v_bool", write_bool);
+  bench_writer("jsonw_v_string", write_string);
+  bench_writer("jsonw_kv_int", write_kv_int);
+  bench_writer("jsonw_v_table_begin/end", write_tables);
+  bench_writer("jsonw_v_int_array", write_int_array);
+  bench_writer("jsonw_v_float_array", write_float_array);
+  bench_writer("jsonw_v_string_array", write_string_array);
+  bench_writer("jsonw_v_raw", write_raw);
+
+  out = out_path ? fopen(out_path, "wb") : stdout;
+  if(!out) {
+    fprintf(stderr, "can't open %s\n", out_path);
+    return 1;
+  }
+  write_results(out);
+  if(out != stdout) fclose(out);
+
+  if(baseline_path) {
+    regressions = compare_baseline(baseline_path, threshold);
+    if(regressions < 0) return 1;
+    fprintf(stderr, "%d metric(s) regressed by more than %.2f%%\n", regressions, threshold);
+  }
+
+  for(i = 0; i < CORPUS_COUNT; i++) {
+    free(corpora[i].data);
+  }
+  return regressions > 0 ? 2 : 0;
+}
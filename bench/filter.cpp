@@ -0,0 +1,88 @@
+/*
+  Scans generated NDJSON log records in memory: fully parsing every record, then with
+  jsonr_filter_record and a selective (1% of the records match) and a non-selective predicate,
+  and with a jsonr_prefilter_skip substring check in front of the selective one.
+
+  Usage: ./bench_bin
+*/
+#define JSONREAD_IMPL
+#include "../json-read.h"
+#include <time.h>
+
+static const int record_count = 1000000;
+
+static double now_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static unsigned long generate(char *buf, unsigned long size) {
+  unsigned long used = 0;
+  int i;
+
+  for(i = 0; i < record_count && used < size; i++) {
+    used += snprintf(buf + used, size - used,
+      "{\"status\": %d, \"latency\": %d, \"method\": \"%s\", \"path\": \"/api/v1/items/%d\", "
+      "\"user\": {\"id\": %d, \"name\": \"user %d\", \"roles\": [\"a\", \"b\"]}, \"bytes\": %d}\n",
+      i % 100 == 0 ? 500 : 200, (int)((i * 7919ul) % 1000), i & 1 ? "GET" : "POST", i, i % 5000, i % 5000, i * 3);
+  }
+  return used;
+}
+
+static void scan(const char *what, const char *data, unsigned long length, const char *expr, const char *needle) {
+  static JSON_Read_Filter filter;
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+  JSON_Read_Prefilter prefilter;
+  unsigned long begin, end;
+  unsigned long matched = 0;
+  double start, ms;
+  int result;
+
+  jsonr_init_mem(j, data, length);
+  jsonr_prefilter_init(&prefilter);
+  if(needle) jsonr_prefilter_add(&prefilter, needle);
+  start = now_ms();
+
+  if(expr && needle) {
+    if(!jsonr_filter_compile(&filter, expr)) { printf("bad filter %s\n", expr); return; }
+    while(jsonr_prefilter_skip(j, &prefilter) && (result = jsonr_filter_record(j, &filter, &begin, &end))) {
+      matched += result == JSONR_FILTER_MATCH;
+    }
+  }
+  else if(expr) {
+    if(!jsonr_filter_compile(&filter, expr)) { printf("bad filter %s\n", expr); return; }
+    while((result = jsonr_filter_record(j, &filter, &begin, &end))) {
+      matched += result == JSONR_FILTER_MATCH;
+    }
+  }
+  else {
+    while(jsonr_v_get_type(j) != JSONR_V_INVALID) {
+      jsonr_v_skip(j);
+      matched += 1;
+    }
+  }
+
+  ms = now_ms() - start;
+  printf("%-34s %9.2f ms %8.1f MB/s %8lu records%s\n", what, ms, length / (ms * 1000.0), matched, j->error ? "   (ERROR)" : "");
+}
+
+int main() {
+  unsigned long size = record_count * 256ul;
+  char *data = (char*)malloc(size);
+  unsigned long length;
+
+  if(!data) { printf("out of memory\n"); return 1; }
+  length = generate(data, size);
+
+  scan("full parse", data, length, 0, 0);
+  scan("selective: /status == 500", data, length, "/status == 500", 0);
+  scan("prefilter \"500\" + /status == 500", data, length, "/status == 500", "500");
+  scan("selective, late key: /bytes < 30", data, length, "/bytes < 30", 0);
+  scan("non-selective: /latency >= 0", data, length, "/latency >= 0", 0);
+  scan("wildcard: /user/roles/* == \"b\"", data, length, "/user/roles/* == \"b\"", 0);
+
+  free(data);
+  return 0;
+}
@@ -0,0 +1,96 @@
+/*
+  Reads one generated document in memory (a handful of big sections of different sizes, like
+  meshes, entity lists and text tables) with jsonr_v_table_parallel on an increasing number of
+  threads.
+
+  Usage: ./bench_bin
+*/
+#define JSONREAD_IMPL
+#define JSONREAD_POSIX
+#include "../json-read.h"
+#include <time.h>
+
+static const int section_count = 8;
+static const int element_count = 100000;
+
+typedef struct {
+  double sums[8];
+} Totals;
+
+static double now_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static unsigned long generate(char *buf, unsigned long size) {
+  unsigned long used = 0;
+  int s, i;
+
+  used += snprintf(buf + used, size - used, "{\"version\": 1");
+  for(s = 0; s < section_count && used < size; s++) {
+    used += snprintf(buf + used, size - used, ",\n\"section%d\": [", s);
+    for(i = 0; i < element_count / (s % 3 + 1) && used < size; i++) {
+      used += snprintf(buf + used, size - used, "%s{\"id\": %d, \"name\": \"entity %d\", \"pos\": [%d.5, %d.25, 0]}", i ? ", " : "", i, i, i, i * 2);
+    }
+    used += snprintf(buf + used, size - used, "]");
+  }
+  used += snprintf(buf + used, size - used, "}");
+  return used;
+}
+
+/* Reads every value. */
+static double read_value(JSON_Read_Data *j) {
+  double sum = 0;
+  char *str;
+  unsigned long len;
+
+  switch(jsonr_v_get_type(j)) {
+    case JSONR_V_TABLE: jsonr_v_table(j) { jsonr_k(j, &str, &len); sum += read_value(j); } break;
+    case JSONR_V_ARRAY: jsonr_v_array(j) { sum += read_value(j); } break;
+    case JSONR_V_NUMBER: sum += jsonr_v_number(j); break;
+    case JSONR_V_STRING: jsonr_v_string(j, &str, &len); sum += len; break;
+    default: jsonr_v_skip(j); break;
+  }
+  return sum;
+}
+
+/* Every section has its own slot, nothing to lock. */
+static void read_section(JSON_Read_Data *j, const char *key, unsigned long key_length, void *user) {
+  Totals *totals = (Totals*)user;
+  int s = key_length == 8 && memcmp(key, "section", 7) == 0 ? key[7] - '0' : -1;
+  double sum = read_value(j);
+  if(s >= 0 && s < 8) totals->sums[s] = sum;
+}
+
+static void run(const char *data, unsigned long length, int threads) {
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+  Totals totals;
+  double start, ms, sum = 0;
+  int i;
+
+  memset(&totals, 0, sizeof(totals));
+  start = now_ms();
+  jsonr_init_mem(j, data, length);
+  jsonr_v_table_parallel(j, threads, read_section, &totals);
+  ms = now_ms() - start;
+  for(i = 0; i < 8; i++) sum += totals.sums[i];
+  printf("%d sections %2d threads %9.2f ms %8.1f MB/s%s (%g)\n", section_count, threads, ms, length / (ms * 1000.0), j->error ? "   (ERROR)" : "", sum);
+}
+
+int main() {
+  unsigned long size = section_count * (unsigned long)element_count * 80;
+  char *data = (char*)malloc(size);
+  unsigned long length;
+  int threads[] = { 1, 2, 4, 8 };
+  int i;
+
+  if(!data) { printf("out of memory\n"); return 1; }
+  length = generate(data, size);
+
+  for(i = 0; i < 4; i++) run(data, length, threads[i]);
+
+  free(data);
+  return 0;
+}
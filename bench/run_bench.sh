@@ -0,0 +1,4 @@
+#!/bin/bash
+for f in *.cpp; do
+  clang -O2 $f -o bench_bin && ./bench_bin || { echo "FAILED: $f"; exit 1; }
+done
@@ -0,0 +1,110 @@
+/*
+  Navigates one generated document (a handful of big sections) in memory several times: the cost
+  of recording a skip table while reading the whole thing once, then handlers that each pull out
+  their own section with jsonr_extract, without and with the table.
+
+  Usage: ./bench_bin
+*/
+#define JSONREAD_IMPL
+#include "../json-read.h"
+#include <time.h>
+
+static const int section_count = 8;
+static const int element_count = 100000;
+
+static double now_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static unsigned long generate(char *buf, unsigned long size) {
+  unsigned long used = 0;
+  int s, i;
+
+  used += snprintf(buf + used, size - used, "{\"version\": 1");
+  for(s = 0; s < section_count && used < size; s++) {
+    used += snprintf(buf + used, size - used, ",\n\"section%d\": [", s);
+    for(i = 0; i < element_count && used < size; i++) {
+      used += snprintf(buf + used, size - used, "%s{\"id\": %d, \"name\": \"entity %d\", \"pos\": [%d.5, %d.25, 0]}", i ? ", " : "", i, i, i, i * 2);
+    }
+    used += snprintf(buf + used, size - used, "]");
+  }
+  used += snprintf(buf + used, size - used, "}");
+  return used;
+}
+
+/* Reads every value. */
+static double read_value(JSON_Read_Data *j) {
+  double sum = 0;
+  char *str;
+  unsigned long len;
+
+  switch(jsonr_v_get_type(j)) {
+    case JSONR_V_TABLE: jsonr_v_table(j) { jsonr_k(j, &str, &len); sum += read_value(j); } break;
+    case JSONR_V_ARRAY: jsonr_v_array(j) { sum += read_value(j); } break;
+    case JSONR_V_NUMBER: sum += jsonr_v_number(j); break;
+    case JSONR_V_STRING: jsonr_v_string(j, &str, &len); sum += len; break;
+    default: jsonr_v_skip(j); break;
+  }
+  return sum;
+}
+
+static void read_all(const char *what, const char *data, unsigned long length, JSON_Read_Skips *skips) {
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+  double start, ms, sum;
+
+  start = now_ms();
+  jsonr_init_mem(j, data, length);
+  j->skips = skips;
+  sum = read_value(j);
+  ms = now_ms() - start;
+  printf("%-36s %9.2f ms %8.1f MB/s%s (%g)\n", what, ms, length / (ms * 1000.0), j->error ? "   (ERROR)" : "", sum);
+}
+
+/* Every handler pulls a few elements out of its own section. */
+static void handlers(const char *what, const char *data, unsigned long length, JSON_Read_Skips *skips) {
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+  char path[64];
+  double start, ms;
+  double sum = 0;
+  int error = 0;
+  int s, i;
+
+  start = now_ms();
+  for(s = 0; s < section_count; s++) {
+    for(i = 0; i < 4; i++) {
+      snprintf(path, sizeof(path), "/section%d/%d/pos/1", s, element_count / 4 * i + 1000);
+      jsonr_init_mem(j, data, length);
+      j->skips = skips;
+      if(jsonr_extract(j, path)) sum += jsonr_v_number(j);
+      error |= j->error;
+    }
+  }
+  ms = now_ms() - start;
+  printf("%-36s %9.2f ms %9.3f ms/lookup%s (%g)\n", what, ms, ms / (section_count * 4), error ? "   (ERROR)" : "", sum);
+}
+
+int main() {
+  static JSON_Read_Skip slots[1024*64];
+  JSON_Read_Skips skips;
+  unsigned long size = section_count * (unsigned long)element_count * 80;
+  char *data = (char*)malloc(size);
+  unsigned long length;
+
+  if(!data) { printf("out of memory\n"); return 1; }
+  length = generate(data, size);
+
+  read_all("read everything", data, length, 0);
+  jsonr_skips_init(&skips, slots, sizeof(slots)/sizeof(slots[0]));
+  read_all("read everything, recording skips", data, length, &skips);
+  printf("%lu skips recorded, %lu dropped\n", skips.count, skips.dropped);
+
+  handlers("32 lookups", data, length, 0);
+  handlers("32 lookups with the skip table", data, length, &skips);
+
+  free(data);
+  return 0;
+}
@@ -0,0 +1,151 @@
+/*
+  Writes a snapshot into memory with the C writer and jsonw::writer<span_sink>, then reads it back
+  with the C reader (jsonr_init_mem) and jsonr::reader<span_source>.
+
+  Usage: ./bench_bin
+*/
+#define JSONREAD_IMPL
+#define JSONWRITE_IMPL
+#include "../json-read.h"
+#include "../json-write.h"
+#include "../json-cpp.h"
+#include <time.h>
+
+static const int entity_count = 1000000;
+static const unsigned long buf_size = 1024*1024*128;
+
+static double now_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* Both writers get the same fixed buffer, running out of room is an error. */
+static int buffer_full(JSON_Write_Data *j, int finish) {
+  (void)finish;
+  return j->buf_used < j->buf_size;
+}
+
+static void write_c(JSON_Write_Data *j) {
+  int i;
+
+  jsonw_v_table_begin(j);
+    jsonw_kv_int(j, "version", 1);
+    jsonw_k(j, "entities");
+    jsonw_v_array_begin(j);
+    for(i = 0; i < entity_count; i++) {
+      jsonw_v_table_begin(j);
+        jsonw_kv_int(j, "id", i);
+        jsonw_kv_string(j, "name", "some entity name");
+        jsonw_kv_float(j, "x", i * 0.25);
+        jsonw_kv_float(j, "y", i * -0.5);
+        jsonw_kv_bool(j, "alive", i & 1);
+      jsonw_v_table_end(j);
+    }
+    jsonw_v_array_end(j);
+  jsonw_v_table_end(j);
+}
+
+template<typename Sink>
+static void write_cpp(jsonw::writer<Sink> &j) {
+  int i;
+
+  j.table_begin();
+    j.kv_int("version", 1);
+    j.k("entities");
+    j.array_begin();
+    for(i = 0; i < entity_count; i++) {
+      j.table_begin();
+        j.kv_int("id", i);
+        j.kv_string("name", "some entity name");
+        j.kv_float("x", i * 0.25);
+        j.kv_float("y", i * -0.5);
+        j.kv_bool("alive", i & 1);
+      j.table_end();
+    }
+    j.array_end();
+  j.table_end();
+}
+
+static double read_c(JSON_Read_Data *j) {
+  double sum = 0;
+  char *str;
+  unsigned long len;
+
+  jsonr_v_table(j) {
+    if(jsonr_k_case(j, "entities")) {
+      jsonr_v_array(j) {
+        jsonr_v_table(j) {
+          if(jsonr_k_case(j, "id")) sum += jsonr_v_number(j);
+          else if(jsonr_k_case(j, "name")) { jsonr_v_string(j, &str, &len); sum += len; }
+          else if(jsonr_k_case(j, "x")) sum += jsonr_v_number(j);
+          else jsonr_kv_skip(j);
+        }
+      }
+    }
+    else jsonr_kv_skip(j);
+  }
+  return sum;
+}
+
+template<typename Source>
+static double read_cpp(jsonr::reader<Source> &j) {
+  double sum = 0;
+  char *str;
+  unsigned long len;
+
+  for(j.table_begin(); j.table_can_read(); ) {
+    if(j.k_case("entities")) {
+      for(j.array_begin(); j.array_can_read(); ) {
+        for(j.table_begin(); j.table_can_read(); ) {
+          if(j.k_case("id")) sum += j.v_number();
+          else if(j.k_case("name")) { j.v_string(&str, &len); sum += len; }
+          else if(j.k_case("x")) sum += j.v_number();
+          else j.kv_skip();
+        }
+      }
+    }
+    else j.kv_skip();
+  }
+  return sum;
+}
+
+int main() {
+  static JSON_Read_Data json;
+  JSON_Write_Data jw;
+  char *buf = (char*)malloc(buf_size);
+  unsigned long length;
+  double start, sum;
+
+  if(!buf) { printf("out of memory\n"); return 1; }
+
+  start = now_ms();
+  jsonw_init_sink(&jw, buf, buf_size, buffer_full, 0);
+  write_c(&jw);
+  jsonw_finish(&jw);
+  length = jw.buf_used;
+  printf("C writer:                    %9.2f ms (%lu bytes)%s\n", now_ms() - start, length, jw.error ? "   (ERROR)" : "");
+
+  {
+    jsonw::writer<jsonw::span_sink> j(jsonw::span_sink(buf, buf_size));
+    start = now_ms();
+    write_cpp(j);
+    j.finish();
+    printf("jsonw::writer<span_sink>:    %9.2f ms (%lu bytes)%s\n", now_ms() - start, j.sink.used(), j.error ? "   (ERROR)" : "");
+  }
+
+  start = now_ms();
+  jsonr_init_mem(&json, buf, length);
+  sum = read_c(&json);
+  printf("C reader:                    %9.2f ms (sum %f)%s\n", now_ms() - start, sum, json.error ? "   (ERROR)" : "");
+
+  {
+    jsonr::reader<jsonr::span_source> j((jsonr::span_source(buf, length)));
+    start = now_ms();
+    sum = read_cpp(j);
+    printf("jsonr::reader<span_source>:  %9.2f ms (sum %f)%s\n", now_ms() - start, sum, j.error ? "   (ERROR)" : "");
+  }
+
+  free(buf);
+  return 0;
+}
@@ -0,0 +1,81 @@
+/*
+  Measures how long the producing thread is busy writing a large snapshot to disk, with the plain
+  FILE writer and with the async writer. 'producer' is the time spent in jsonw_* calls, 'total'
+  also includes jsonw_finish waiting for the data to hit the file.
+
+  Usage: ./bench_bin [output path]
+*/
+#define JSONWRITE_IMPL
+#define JSONWRITE_POSIX
+#include "../json-write.h"
+#include <time.h>
+
+static const char * path = "/tmp/jsonw_bench_async.json";
+static const int entity_count = 2000000;
+
+static double now_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void write_snapshot(JSON_Write_Data *j) {
+  int i;
+
+  jsonw_v_table_begin(j);
+    jsonw_kv_int(j, "version", 1);
+
+    jsonw_k(j, "entities");
+    jsonw_v_array_begin(j);
+    for(i = 0; i < entity_count; i++) {
+      jsonw_v_table_begin(j);
+        jsonw_kv_int(j, "id", i);
+        jsonw_kv_string(j, "name", "some entity name");
+        jsonw_kv_float(j, "x", i * 0.25);
+        jsonw_kv_float(j, "y", i * -0.5);
+        jsonw_kv_bool(j, "alive", i & 1);
+      jsonw_v_table_end(j);
+    }
+    jsonw_v_array_end(j);
+  jsonw_v_table_end(j);
+}
+
+static void report(const char *name, double start, double produced, double finished, int ok) {
+  printf("%-24s producer: %9.2f ms   total: %9.2f ms%s\n",
+    name, produced - start, finished - start, ok ? "" : "   (I/O ERROR)");
+}
+
+int main(int argc, char **argv) {
+  static char mem[1024*1024*4];
+  JSON_Write_Data json;
+  JSON_Write_Data * j = &json;
+  JSON_Write_Async async;
+  double start, produced;
+  FILE *f;
+  int ok;
+
+  if(argc > 1) path = argv[1];
+
+  f = fopen(path, "wb");
+  if(!f) { printf("can't open %s\n", path); return 1; }
+  start = now_ms();
+  jsonw_init(j, f);
+  write_snapshot(j);
+  produced = now_ms();
+  ok = jsonw_finish(j);
+  fclose(f);
+  report("jsonw_init", start, produced, now_ms(), ok);
+
+  f = fopen(path, "wb");
+  if(!f) { printf("can't open %s\n", path); return 1; }
+  start = now_ms();
+  jsonw_init_async(j, &async, f, mem, sizeof(mem));
+  write_snapshot(j);
+  produced = now_ms();
+  ok = jsonw_finish(j);
+  fclose(f);
+  report("jsonw_init_async (4MB)", start, produced, now_ms(), ok);
+
+  remove(path);
+  return 0;
+}
@@ -0,0 +1,85 @@
+/*
+  Writes the same snapshot through the FILE writer, the buffered file descriptor writer and the
+  mmap writer.
+
+  Usage: ./bench_bin [output path]
+*/
+#define JSONWRITE_IMPL
+#define JSONWRITE_POSIX
+#include "../json-write.h"
+#include <time.h>
+
+static const char * path = "/tmp/jsonw_bench_mmap.json";
+static const int entity_count = 2000000;
+
+static double now_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void write_snapshot(JSON_Write_Data *j) {
+  int i;
+
+  jsonw_v_table_begin(j);
+    jsonw_kv_int(j, "version", 1);
+
+    jsonw_k(j, "entities");
+    jsonw_v_array_begin(j);
+    for(i = 0; i < entity_count; i++) {
+      jsonw_v_table_begin(j);
+        jsonw_kv_int(j, "id", i);
+        jsonw_kv_string(j, "name", "some entity name");
+        jsonw_kv_float(j, "x", i * 0.25);
+        jsonw_kv_float(j, "y", i * -0.5);
+        jsonw_kv_bool(j, "alive", i & 1);
+      jsonw_v_table_end(j);
+    }
+    jsonw_v_array_end(j);
+  jsonw_v_table_end(j);
+}
+
+static void report(const char *name, double start, int ok) {
+  printf("%-24s %9.2f ms%s\n", name, now_ms() - start, ok ? "" : "   (I/O ERROR)");
+}
+
+int main(int argc, char **argv) {
+  static char buf[1024*64];
+  JSON_Write_Data json;
+  JSON_Write_Data * j = &json;
+  JSON_Write_Fd fd_sink;
+  JSON_Write_Mmap mmap_sink;
+  double start;
+  FILE *f;
+  int fd;
+  int ok;
+
+  if(argc > 1) path = argv[1];
+
+  start = now_ms();
+  f = fopen(path, "wb");
+  if(!f) { printf("can't open %s\n", path); return 1; }
+  jsonw_init(j, f);
+  write_snapshot(j);
+  ok = jsonw_finish(j);
+  fclose(f);
+  report("jsonw_init", start, ok);
+
+  start = now_ms();
+  fd = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+  if(fd < 0) { printf("can't open %s\n", path); return 1; }
+  jsonw_init_fd(j, &fd_sink, fd, buf, sizeof(buf));
+  write_snapshot(j);
+  ok = jsonw_finish(j);
+  close(fd);
+  report("jsonw_init_fd (64KB)", start, ok);
+
+  start = now_ms();
+  if(!jsonw_init_mmap(j, &mmap_sink, path)) { printf("can't map %s\n", path); return 1; }
+  write_snapshot(j);
+  ok = jsonw_finish(j);
+  report("jsonw_init_mmap", start, ok);
+
+  remove(path);
+  return 0;
+}
@@ -0,0 +1,58 @@
+/*
+  Writes one big array of records to a file with jsonw_v_array_parallel and an increasing number
+  of threads.
+
+  Usage: ./bench_bin [output path]
+*/
+#define JSONWRITE_IMPL
+#define JSONWRITE_POSIX
+#include "../json-write.h"
+#include <time.h>
+
+static const char * path = "/tmp/jsonw_bench_parallel.json";
+static const unsigned long record_count = 2000000;
+
+static double now_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void write_record(JSON_Write_Data *j, unsigned long index, void *user) {
+  (void)user;
+  jsonw_v_table_begin(j);
+    jsonw_kv_int(j, "id", index);
+    jsonw_kv_string(j, "name", "some record name");
+    jsonw_kv_float(j, "x", index * 0.25);
+    jsonw_kv_float(j, "y", index * -0.5);
+    jsonw_kv_bool(j, "alive", index & 1);
+  jsonw_v_table_end(j);
+}
+
+int main(int argc, char **argv) {
+  int threads[] = { 1, 2, 4, 8 };
+  JSON_Write_Data json;
+  JSON_Write_Data * j = &json;
+  double start;
+  FILE *f;
+  int ok;
+  int i;
+
+  if(argc > 1) path = argv[1];
+
+  for(i = 0; i < (int)(sizeof(threads)/sizeof(threads[0])); i++) {
+    f = fopen(path, "wb");
+    if(!f) { printf("can't open %s\n", path); return 1; }
+
+    start = now_ms();
+    jsonw_init(j, f);
+    jsonw_v_array_parallel(j, record_count, threads[i], write_record, 0);
+    ok = jsonw_finish(j);
+    fclose(f);
+
+    printf("jsonw_v_array_parallel %d thread(s): %9.2f ms%s\n", threads[i], now_ms() - start, ok ? "" : "   (I/O ERROR)");
+  }
+
+  remove(path);
+  return 0;
+}
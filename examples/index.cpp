@@ -0,0 +1,101 @@
+/*
+  Command line tool for sidecar indexes (json-index.h).
+
+  Usage:
+    ./index build file.json [depth]   index file.json into file.json.idx, depth defaults to 2
+    ./index get file.json /pointer    print the value at the JSON Pointer. The index is (re)built
+                                      first if it's missing or stale.
+*/
+#define JSONREAD_IMPL
+#define JSONINDEX_IMPL
+#define JSONINDEX_POSIX
+#include "../json-index.h"
+#include <stdlib.h>
+#include <string.h>
+
+static int build(FILE *json, const char *index_path, int depth) {
+  FILE *out = fopen(index_path, "wb");
+  int ok;
+
+  if(!out) {
+    fprintf(stderr, "can't create %s\n", index_path);
+    return 0;
+  }
+
+  ok = jsoni_build(json, out, depth);
+  if(fclose(out) != 0) ok = 0;
+  if(!ok) fprintf(stderr, "indexing failed\n");
+  return ok;
+}
+
+static int get(FILE *json, const char *index_path, const char *pointer) {
+  static JSON_Read_Data j;
+  JSON_Read_Index index;
+  FILE *f = fopen(index_path, "rb");
+  char buf[1024*4];
+  unsigned long begin, length, count;
+
+  if(!f || !jsoni_open(&index, json, f)) {
+    if(f) fclose(f);
+    if(!build(json, index_path, 2)) return 0;
+
+    f = fopen(index_path, "rb");
+    if(!f || !jsoni_open(&index, json, f)) {
+      fprintf(stderr, "can't open %s\n", index_path);
+      return 0;
+    }
+  }
+
+  jsonr_init(&j, json);
+  if(!jsonr_seek_path(&j, &index, pointer)) {
+    if(j.error) fprintf(stderr, "%s\n", jsonr_error_message(&j, 0));
+    else fprintf(stderr, "%s isn't there\n", pointer);
+    fclose(f);
+    return 0;
+  }
+
+  /* Skip it to find where it ends, then copy the bytes. */
+  jsonr_v_get_type(&j);
+  begin = j.offset - 1;
+  jsonr_v_skip_fast(&j);
+  if(j.error) {
+    fprintf(stderr, "%s\n", jsonr_error_message(&j, 0));
+    fclose(f);
+    return 0;
+  }
+
+  fseek(json, (long)begin, SEEK_SET);
+  for(length = j.value_end - begin; length > 0; length -= count) {
+    count = length < sizeof(buf) ? length : sizeof(buf);
+    if(fread(buf, 1, count, json) != count) break;
+    fwrite(buf, 1, count, stdout);
+  }
+  printf("\n");
+
+  fclose(f);
+  return 1;
+}
+
+int main(int argc, char **argv) {
+  char index_path[1024];
+  FILE *json;
+  int ok;
+
+  if(argc < 3 || (strcmp(argv[1], "build") != 0 && strcmp(argv[1], "get") != 0) || (strcmp(argv[1], "get") == 0 && argc < 4)) {
+    fprintf(stderr, "usage: %s build file.json [depth]\n       %s get file.json /pointer\n", argv[0], argv[0]);
+    return 1;
+  }
+
+  json = fopen(argv[2], "rb");
+  if(!json) {
+    fprintf(stderr, "can't open %s\n", argv[2]);
+    return 1;
+  }
+  snprintf(index_path, sizeof(index_path), "%s.idx", argv[2]);
+
+  if(strcmp(argv[1], "build") == 0) ok = build(json, index_path, argc > 3 ? atoi(argv[3]) : 2);
+  else ok = get(json, index_path, argv[3]);
+
+  fclose(json);
+  return ok ? 0 : 1;
+}
@@ -169,12 +169,81 @@ static v4 jsonr_v_v4(JSON_Read_Data *j) {
   return ret;
 }
 
+struct Section {
+  char key[64];
+  JSON_Read_Deferred value;
+};
+
+static void read_section(JSON_Read_Data *j, const char *key) {
+  if(strcmp(key, "last_resource_directory") == 0) {
+    String_Len str = jsonr_v_string_malloc(j);
+    printf("last_resource_directory: '%.*s'\n", (int)str.num_bytes, str.str);
+    free((void*)str.str);
+  }
+  else if(strcmp(key, "camera_zoom") == 0) {
+    float camera_zoom = jsonr_v_number(j);
+    printf("camera_zoom: %f\n", camera_zoom);
+  }
+  else if(strcmp(key, "camera_position") == 0) {
+    v2 camera_position = jsonr_v_v2(j);
+    printf("camera_position.x: %f\n", camera_position.x);
+    printf("camera_position.y: %f\n", camera_position.y);
+  }
+  else if(strcmp(key, "color") == 0) {
+    v4 color = jsonr_v_v4(j);
+    printf("color.x: %f\n", color.x);
+    printf("color.y: %f\n", color.y);
+  }
+  else if(strcmp(key, "text_inline") == 0) {
+    int count = 0;
+    jsonr_v_array(j) {
+      printf("text_inline number %d:\n", count);
+      jsonr_v_table(j) {
+        if(jsonr_k_case(j, "id")) {
+          int id = jsonr_v_number(j);
+          printf("  id: %d\n", id);
+        }
+        else if(jsonr_k_case(j, "origin")) {
+          v2 origin = jsonr_v_v2(j);
+          printf("  origin.x: %f\n", origin.x);
+          printf("  origin.y: %f\n", origin.y);
+        }
+        else if(jsonr_k_case(j, "extents")) {
+          v2 extents = jsonr_v_v2(j);
+          printf("  extents.x: %f\n", extents.x);
+          printf("  extents.y: %f\n", extents.y);
+        }
+        else if(jsonr_k_case(j, "color")) {
+          v4 color = jsonr_v_v4(j);
+          printf("  color.x: %f\n", color.x);
+          printf("  color.y: %f\n", color.y);
+          printf("  color.z: %f\n", color.z);
+          printf("  color.w: %f\n", color.w);
+        }
+        else if(jsonr_k_case(j, "scale")) {
+          v2 scale = jsonr_v_v2(j);
+          printf("  scale.x: %f\n", scale.x);
+          printf("  scale.y: %f\n", scale.y);
+        }
+        else if(jsonr_k_case(j, "text")) {
+          String_Len str = jsonr_v_string_malloc(j);
+          printf("  text: '%.*s'\n", (int)str.num_bytes, str.str);
+          free((void*)str.str);
+        }
+        else {
+          jsonr_kv_skip(j);
+        }
+      }
+    }
+  }
+  else {
+    jsonr_v_skip(j);
+  }
+}
+
 int main() {
   FILE * f = fmemopen((void*)data, strlen(data), "rb");
 
-  fpos_t start;
-  fgetpos(f, &start);
-
   JSON_Read_Data json;
   JSON_Read_Data * j = &json;
 
@@ -183,11 +252,25 @@ int main() {
   int ver = -1;
   int got_version = 0;
 
+  /* The version decides how to read the rest, but it can come last. Remember where everything
+   * else is and read it once we know. */
+  Section sections[16];
+  int section_count = 0;
+
   jsonr_v_table(j) {
     if(jsonr_k_case(j, "version")) {
       ver = jsonr_v_number(j);
       got_version = 1;
     }
+    else if(section_count < 16) {
+      char * key;
+      unsigned long len;
+      jsonr_k(j, &key, &len);
+
+      Section *section = &sections[section_count++];
+      snprintf(section->key, sizeof(section->key), "%.*s", (int)len, key);
+      section->value = jsonr_v_defer(j);
+    }
     else {
       jsonr_kv_skip(j);
     }
@@ -196,7 +279,7 @@ int main() {
   if(!got_version) {
     if(j->error) {
       printf("Encountered an error during parsing.\n");
-      printf("%.*s\n", (int)j->error_msg_length, j->error_msg);
+      printf("%s\n", jsonr_error_message(j, 0));
       return 1;
     }
 
@@ -205,79 +288,15 @@ int main() {
   }
 
   if(ver == 1) {
-    fsetpos(f, &start);
-    jsonr_init(j, f);
-
-    jsonr_v_table(j) {
-      if(jsonr_k_case(j, "last_resource_directory")) {
-        String_Len str = jsonr_v_string_malloc(j);
-        printf("last_resource_directory: '%.*s'\n", (int)str.num_bytes, str.str);
-        free((void*)str.str);
-      }
-      else if(jsonr_k_case(j, "camera_zoom")) {
-        float camera_zoom = jsonr_v_number(j);
-        printf("camera_zoom: %f\n", camera_zoom);
-      }
-      else if(jsonr_k_case(j, "camera_position")) {
-        v2 camera_position = jsonr_v_v2(j);
-        printf("camera_position.x: %f\n", camera_position.x);
-        printf("camera_position.y: %f\n", camera_position.y);
-      }
-      else if(jsonr_k_case(j, "color")) {
-        v4 color = jsonr_v_v4(j);
-        printf("color.x: %f\n", color.x);
-        printf("color.y: %f\n", color.y);
-      }
-      else if(jsonr_k_case(j, "text_inline")) {
-        int count = 0;
-        jsonr_v_array(j) {
-          printf("text_inline number %d:\n", count);
-          jsonr_v_table(j) {
-            if(jsonr_k_case(j, "id")) {
-              int id = jsonr_v_number(j);
-              printf("  id: %d\n", id);
-            }
-            else if(jsonr_k_case(j, "origin")) {
-              v2 origin = jsonr_v_v2(j);
-              printf("  origin.x: %f\n", origin.x);
-              printf("  origin.y: %f\n", origin.y);
-            }
-            else if(jsonr_k_case(j, "extents")) {
-              v2 extents = jsonr_v_v2(j);
-              printf("  extents.x: %f\n", extents.x);
-              printf("  extents.y: %f\n", extents.y);
-            }
-            else if(jsonr_k_case(j, "color")) {
-              v4 color = jsonr_v_v4(j);
-              printf("  color.x: %f\n", color.x);
-              printf("  color.y: %f\n", color.y);
-              printf("  color.z: %f\n", color.z);
-              printf("  color.w: %f\n", color.w);
-            }
-            else if(jsonr_k_case(j, "scale")) {
-              v2 scale = jsonr_v_v2(j);
-              printf("  scale.x: %f\n", scale.x);
-              printf("  scale.y: %f\n", scale.y);
-            }
-            else if(jsonr_k_case(j, "text")) {
-              String_Len str = jsonr_v_string_malloc(j);
-              printf("  text: '%.*s'\n", (int)str.num_bytes, str.str);
-              free((void*)str.str);
-            }
-            else {
-              jsonr_kv_skip(j);
-            }
-          }
-        }
-      }
-      else {
-        jsonr_kv_skip(j);
+    for(int i = 0; i < section_count && !j->error; i++) {
+      if(jsonr_defer_open(j, sections[i].value)) {
+        read_section(j, sections[i].key);
       }
     }
 
     if(j->error) {
       printf("Encountered an error during parsing.\n");
-      printf("%.*s\n", (int)j->error_msg_length, j->error_msg);
+      printf("%s\n", jsonr_error_message(j, 0));
       return 1;
     }
   }
@@ -0,0 +1,1037 @@
+/*
+  * json-agg.h - public domain - group-by aggregation over NDJSON
+
+  * Counts, sums, minimums, maximums and distinct counts over NDJSON records, grouped by any
+    number of fields. Records are read with json-read.h (jsonr_project, so only the fields that
+    are asked for get parsed) and the result is written with json-write.h as an array of tables:
+      [{"host": "a", "status": 500, "count": 12, "latency_sum": 3400}, ...]
+  * Every thread aggregates into its own open addressing hash table. The group values of a record
+    are interned into the table once, then only hashed and compared. The tables are merged by
+    jsona_write.
+  * Integers are summed/compared as longs straight from their digits (jsonr_v_number_int). strtod
+    only runs for numbers with a fraction or exponent (or more than 18 digits), and a sum only
+    turns into a double if one of those came along or it would overflow.
+  * Memory is bounded by the max_groups given to jsona_init: a table that has that many groups is
+    spilled to JSONA_PARTITIONS tmpfile()s by group hash and emptied. jsona_write then merges one
+    partition at a time, so about JSONA_PARTITIONS * max_groups groups fit in the same memory. A
+    table has up to JSONA_PARTITIONS spill files open.
+  * Distinct counts are HyperLogLog estimates with 2^JSONA_HLL_BITS one byte registers per group
+    and column (~6.5% error with the default of 8 bits). Counts of up to a few dozen values are
+    close to exact.
+  * Tables, arrays, null and missing fields group as null and aren't counted by the other
+    aggregates. Strings longer than JSONR_STRINGLEN_READ_BUFFER_SIZE are cut off.
+  * Allocates with malloc/realloc.
+  * Define JSONAGG_POSIX to get jsona_feed_mem_parallel. It uses pthreads.
+
+  * Usage:
+    1. Define JSONAGG_IMPL once while including the file to include the implementation. It needs
+       the json-read.h and json-write.h implementations to be included somewhere as well.
+    {
+      #define JSONREAD_IMPL
+      #define JSONWRITE_IMPL
+      #define JSONAGG_IMPL
+      #include "json-agg.h"
+    }
+
+    2. Use the API.
+    {
+      static JSON_Agg agg;
+      JSON_Agg_Column columns[] = {
+        { JSONA_GROUP, "/host", "host" },
+        { JSONA_COUNT, 0, "count" },
+        { JSONA_SUM, "/latency", "latency_sum" },
+        { JSONA_DISTINCT, "/user/id", "users" },
+      };
+
+      jsona_init(&agg, columns, 4, 0);
+      jsona_feed(&agg, &json_read);  (or jsona_feed_mem_parallel)
+      jsona_write(&agg, &json_write);
+      jsona_free(&agg);
+    }
+*/
+
+#ifndef JSONAGG_DEF
+
+/* json-read.h/json-write.h have no include guards, so only pull them in if they weren't
+ * included yet. json-write.h first, so jsonr_stats_write is there with JSONREAD_STATS. */
+#ifndef JSONWRITE_DEF
+  #include "json-write.h"
+#endif
+#ifndef JSONREAD_DEF
+  #include "json-read.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+
+#ifdef JSONAGG_POSIX
+  #include <pthread.h>
+#endif
+
+#define JSONAGG_DEF extern
+
+#ifndef JSONA_COLUMNS
+  #define JSONA_COLUMNS 16
+#endif
+
+#ifndef JSONA_THREADS
+  #define JSONA_THREADS 64
+#endif
+
+#ifndef JSONA_PARTITIONS
+  #define JSONA_PARTITIONS 16 /* spill files per table. */
+#endif
+
+#ifndef JSONA_HLL_BITS
+  #define JSONA_HLL_BITS 8
+#endif
+
+#ifndef JSONA_RECORD_TEXT
+  #define JSONA_RECORD_TEXT (1024*8) /* string values of a record kept for grouping and counting. */
+#endif
+
+#ifndef JSONA_MAX_GROUPS
+  #define JSONA_MAX_GROUPS (1024*1024) /* used for a max_groups of 0. */
+#endif
+
+enum {
+  JSONA_GROUP, /* a field to group by. */
+  JSONA_COUNT, /* records in the group. Has no path. */
+  JSONA_SUM,
+  JSONA_MIN,
+  JSONA_MAX,
+  JSONA_DISTINCT, /* estimated number of distinct values. */
+};
+
+enum {
+  JSONA_E_NONE,
+  JSONA_E_SPEC, /* a path didn't parse, too many columns or JSONR_PROJECTION_NODES ran out. */
+  JSONA_E_READ, /* a record didn't parse: read_error_code (JSONR_E_*) at error_offset. */
+  JSONA_E_MEMORY,
+  JSONA_E_SPILL, /* couldn't create/write/read a spill file. */
+};
+
+typedef struct {
+  int op; /* JSONA_* */
+  const char * path; /* JSON Pointer into the record. Not copied. */
+  const char * name; /* key in the output. Not copied. */
+} JSON_Agg_Column;
+
+typedef struct {
+  int type; /* JSONR_V_*, JSONR_V_INVALID if it isn't in the record. */
+  int is_int;
+  long i; /* also the bool. */
+  double d;
+  unsigned long text; /* strings: where it is in the table's text. */
+  unsigned long length;
+} _JSON_Agg_Value;
+
+typedef struct {
+  unsigned long long hash;
+  unsigned long index; /* entry index + 1, 0 for an empty slot. */
+} _JSON_Agg_Slot;
+
+/* The groups of one thread. */
+typedef struct {
+  _JSON_Agg_Slot * slots;
+  unsigned long slot_count; /* a power of two. */
+  char * entries; /* JSON_Agg.entry_size bytes each. */
+  unsigned long entry_count;
+  unsigned long entry_capacity;
+  char * keys; /* interned group values. */
+  unsigned long keys_used;
+  unsigned long keys_capacity;
+  FILE * spill[JSONA_PARTITIONS];
+  int spilled;
+  unsigned long records;
+
+  int error; /* JSONA_E_*, see JSON_Agg. */
+  int read_error_code;
+  unsigned long error_offset;
+
+  /* The record being read. 'values' are indexed by path. */
+  _JSON_Agg_Value values[JSONA_COLUMNS];
+  char text[JSONA_RECORD_TEXT];
+  unsigned long text_used;
+  char key[JSONA_RECORD_TEXT + JSONA_COLUMNS*32];
+} JSON_Agg_Table;
+
+/* Points into itself, don't copy it. */
+typedef struct {
+  JSON_Agg_Column columns[JSONA_COLUMNS];
+  int column_count;
+  unsigned long max_groups;
+
+  JSON_Read_Projection projection;
+  const char * paths[JSONA_COLUMNS]; /* distinct paths of the columns, ids in the projection. */
+  int path_count;
+  int column_path[JSONA_COLUMNS]; /* -1 for JSONA_COUNT. */
+  unsigned long hll_offset[JSONA_COLUMNS]; /* JSONA_DISTINCT: registers from the entry start. */
+  unsigned long entry_size;
+
+  JSON_Agg_Table * tables[JSONA_THREADS];
+  int table_count;
+  unsigned long records; /* fed so far. */
+
+  int error; /* JSONA_E_*. Once set, nothing else is done. */
+  int read_error_code;
+  unsigned long error_offset; /* from the start of the input. */
+} JSON_Agg;
+
+/* Set up an aggregation producing 'columns' for every group. Keep at most 'max_groups' groups per
+ * thread in memory (0 for JSONA_MAX_GROUPS). Returns 0 if a column doesn't work out (i.e two
+ * JSONA_GROUP columns on the same path), a->error is JSONA_E_SPEC then. */
+JSONAGG_DEF int jsona_init(JSON_Agg *a, const JSON_Agg_Column *columns, int column_count, unsigned long max_groups);
+
+/* Aggregate every NDJSON record from the cursor to the end of the input. Returns 0 on error. */
+JSONAGG_DEF int jsona_feed(JSON_Agg *a, JSON_Read_Data *j);
+
+#ifdef JSONAGG_POSIX
+/* Aggregate the NDJSON records in data[0..length) on 'thread_count' threads (the calling one
+ * included), each taking a run of whole lines. Returns 0 on error, a->error_offset is relative to
+ * 'data'. */
+JSONAGG_DEF int jsona_feed_mem_parallel(JSON_Agg *a, const char *data, unsigned long length, int thread_count);
+#endif
+
+/* Merge what was fed and write it as an array with a table per group. Groups come in no particular
+ * order. Empties the aggregation, so it can only be written once. Returns 0 on error. */
+JSONAGG_DEF int jsona_write(JSON_Agg *a, JSON_Write_Data *w);
+
+/* Free the tables and close the spill files. */
+JSONAGG_DEF void jsona_free(JSON_Agg *a);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JSONAGG_DEF */
+
+/* ============================================ */
+/* ============== Implementation ============== */
+/* ============================================ */
+
+#ifdef JSONAGG_IMPL
+#ifndef _JSONAGG_IMPL_DONE
+#define _JSONAGG_IMPL_DONE
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  unsigned long long hash;
+  unsigned long key; /* offset into the table's keys. */
+  unsigned long key_length;
+  unsigned long count; /* records. */
+} _JSON_Agg_Entry;
+
+/* SUM/MIN/MAX of the integers and of the other numbers, kept apart. */
+typedef struct {
+  unsigned long ints;
+  unsigned long doubles; /* also counts sums that would have overflowed 'i'. */
+  long i;
+  double d;
+} _JSON_Agg_Acc;
+
+#define _JSONA_ENTRY(a, t, index) ((_JSON_Agg_Entry*)((t)->entries + (index) * (a)->entry_size))
+#define _JSONA_ACC(e, column) ((_JSON_Agg_Acc*)((e) + 1) + (column))
+#define _JSONA_HLL(a, e, column) ((unsigned char*)(e) + (a)->hll_offset[column])
+
+/* FNV-1a, then mixed (murmur3's finalizer) so the high bits are as good as the low ones: the low
+ * bits pick the slot, the high ones the partition and the HyperLogLog register. */
+static unsigned long long _jsona_hash(const char *data, unsigned long length, unsigned long long seed) {
+  unsigned long long h = 14695981039346656037ull ^ seed;
+  unsigned long i;
+
+  for(i = 0; i < length; i++) {
+    h ^= (unsigned char)data[i];
+    h *= 1099511628211ull;
+  }
+
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+/* ln(x) for x >= 1, without libm: x = 2^k * y with y in [1, 2), then the atanh series for ln(y). */
+static double _jsona_log(double x) {
+  double k = 0;
+  double z, z2, term;
+  double sum = 0;
+  int n;
+
+  while(x >= 2) {
+    x /= 2;
+    k += 1;
+  }
+
+  z = (x - 1) / (x + 1);
+  z2 = z * z;
+  term = z;
+  for(n = 1; n < 40; n += 2) {
+    sum += term / n;
+    term *= z2;
+  }
+  return k * 0.69314718055994531 + 2 * sum;
+}
+
+static void _jsona_hll_add(unsigned char *registers, unsigned long long hash) {
+  unsigned long long rest = hash << JSONA_HLL_BITS;
+  unsigned char rank = 1;
+
+  while(rank <= 64 - JSONA_HLL_BITS && !(rest & 0x8000000000000000ull)) {
+    rank += 1;
+    rest <<= 1;
+  }
+
+  if(rank > registers[hash >> (64 - JSONA_HLL_BITS)]) {
+    registers[hash >> (64 - JSONA_HLL_BITS)] = rank;
+  }
+}
+
+static unsigned long _jsona_hll_estimate(const unsigned char *registers) {
+  double m = 1 << JSONA_HLL_BITS;
+  double sum = 0;
+  double estimate;
+  unsigned long zeros = 0;
+  unsigned long i;
+
+  for(i = 0; i < (1ul << JSONA_HLL_BITS); i++) {
+    sum += 1.0 / (double)(1ull << registers[i]);
+    zeros += registers[i] == 0;
+  }
+
+  estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+
+  /* Small counts: linear counting on the registers that are still empty is much closer. */
+  if(estimate <= 2.5 * m && zeros) estimate = m * _jsona_log(m / zeros);
+  return (unsigned long)(estimate + 0.5);
+}
+
+/* Add 'n' integers (that all were 'val', or whose sum is 'val'). */
+static void _jsona_int(_JSON_Agg_Acc *acc, int op, long val, unsigned long n) {
+  unsigned long sum;
+
+  switch(op) {
+    case JSONA_SUM: {
+      /* Overflowed if both have the same sign and the sum doesn't. That part goes to 'd'. */
+      sum = (unsigned long)acc->i + (unsigned long)val;
+      if(((acc->i ^ (long)sum) & (val ^ (long)sum)) < 0) {
+        acc->d += (double)val;
+        acc->doubles += 1;
+      }
+      else {
+        acc->i = (long)sum;
+      }
+      break;
+    }
+    case JSONA_MIN: if(!acc->ints || val < acc->i) acc->i = val; break;
+    case JSONA_MAX: if(!acc->ints || val > acc->i) acc->i = val; break;
+  }
+  acc->ints += n;
+}
+
+static void _jsona_double(_JSON_Agg_Acc *acc, int op, double val, unsigned long n) {
+  switch(op) {
+    case JSONA_SUM: acc->d += val; break;
+    case JSONA_MIN: if(!acc->doubles || val < acc->d) acc->d = val; break;
+    case JSONA_MAX: if(!acc->doubles || val > acc->d) acc->d = val; break;
+  }
+  acc->doubles += n;
+}
+
+static void _jsona_fail(JSON_Agg_Table *t, int error) {
+  if(!t->error) t->error = error;
+}
+
+static JSON_Agg_Table * _jsona_table(JSON_Agg *a, int index) {
+  if(!a->tables[index]) {
+    a->tables[index] = (JSON_Agg_Table*)calloc(1, sizeof(JSON_Agg_Table));
+    if(!a->tables[index]) {
+      a->error = JSONA_E_MEMORY;
+      return 0;
+    }
+  }
+  if(a->table_count <= index) a->table_count = index + 1;
+  return a->tables[index];
+}
+
+static void _jsona_clear(JSON_Agg_Table *t) {
+  t->entry_count = 0;
+  t->keys_used = 0;
+  if(t->slots) memset(t->slots, 0, t->slot_count * sizeof(_JSON_Agg_Slot));
+}
+
+/* Room for one more entry with a 'key_length' byte key, keeping the slots at most half full. */
+static int _jsona_reserve(JSON_Agg *a, JSON_Agg_Table *t, unsigned long key_length) {
+  _JSON_Agg_Slot *slots;
+  unsigned long slot_count;
+  unsigned long capacity;
+  unsigned long i, k;
+  char *grown;
+
+  if(t->entry_count == t->entry_capacity) {
+    capacity = t->entry_capacity ? t->entry_capacity * 2 : 1024;
+    grown = (char*)realloc(t->entries, capacity * a->entry_size);
+    if(!grown) return 0;
+    t->entries = grown;
+    t->entry_capacity = capacity;
+  }
+
+  if(t->keys_used + key_length > t->keys_capacity) {
+    capacity = t->keys_capacity ? t->keys_capacity * 2 : 1024*16;
+    if(capacity < t->keys_used + key_length) capacity = t->keys_used + key_length;
+    grown = (char*)realloc(t->keys, capacity);
+    if(!grown) return 0;
+    t->keys = grown;
+    t->keys_capacity = capacity;
+  }
+
+  if((t->entry_count + 1) * 2 > t->slot_count) {
+    slot_count = t->slot_count ? t->slot_count * 2 : 2048;
+    slots = (_JSON_Agg_Slot*)calloc(slot_count, sizeof(_JSON_Agg_Slot));
+    if(!slots) return 0;
+
+    for(i = 0; i < t->slot_count; i++) {
+      if(!t->slots[i].index) continue;
+      for(k = t->slots[i].hash & (slot_count - 1); slots[k].index; k = (k + 1) & (slot_count - 1));
+      slots[k] = t->slots[i];
+    }
+
+    free(t->slots);
+    t->slots = slots;
+    t->slot_count = slot_count;
+  }
+  return 1;
+}
+
+/* Write every group of the table to the spill file of its partition and empty it. */
+static int _jsona_spill(JSON_Agg *a, JSON_Agg_Table *t) {
+  _JSON_Agg_Entry *e;
+  FILE *f;
+  unsigned long i;
+  int p;
+
+  for(i = 0; i < t->entry_count; i++) {
+    e = _JSONA_ENTRY(a, t, i);
+    p = (int)((e->hash >> 32) % JSONA_PARTITIONS);
+
+    if(!t->spill[p]) t->spill[p] = tmpfile();
+    f = t->spill[p];
+    if(!f || fwrite(e, a->entry_size, 1, f) != 1 || fwrite(t->keys + e->key, 1, e->key_length, f) != e->key_length) {
+      _jsona_fail(t, JSONA_E_SPILL);
+      return 0;
+    }
+  }
+
+  _jsona_clear(t);
+  t->spilled = 1;
+  return 1;
+}
+
+/* The group with the given key, added if it isn't there yet. A table that's full is spilled first
+ * if 'can_spill'. Returns 0 on error. */
+static _JSON_Agg_Entry * _jsona_find(JSON_Agg *a, JSON_Agg_Table *t, unsigned long long hash, const char *key, unsigned long key_length, int can_spill) {
+  _JSON_Agg_Entry *e;
+  unsigned long mask;
+  unsigned long i;
+
+  if(t->slot_count) {
+    mask = t->slot_count - 1;
+    for(i = hash & mask; t->slots[i].index; i = (i + 1) & mask) {
+      if(t->slots[i].hash != hash) continue;
+
+      e = _JSONA_ENTRY(a, t, t->slots[i].index - 1);
+      if(e->key_length == key_length && memcmp(t->keys + e->key, key, key_length) == 0) return e;
+    }
+  }
+
+  if(can_spill && t->entry_count >= a->max_groups && !_jsona_spill(a, t)) return 0;
+  if(!_jsona_reserve(a, t, key_length)) {
+    _jsona_fail(t, JSONA_E_MEMORY);
+    return 0;
+  }
+
+  /* Spilling/growing moved things around, look for the free slot again. */
+  mask = t->slot_count - 1;
+  for(i = hash & mask; t->slots[i].index; i = (i + 1) & mask);
+  t->slots[i].hash = hash;
+  t->slots[i].index = t->entry_count + 1;
+
+  e = _JSONA_ENTRY(a, t, t->entry_count);
+  memset(e, 0, a->entry_size);
+  e->hash = hash;
+  e->key = t->keys_used;
+  e->key_length = key_length;
+
+  memcpy(t->keys + t->keys_used, key, key_length);
+  t->keys_used += key_length;
+  t->entry_count += 1;
+  return e;
+}
+
+/* Merge a group from another table or a spill file into 't'. */
+static int _jsona_absorb(JSON_Agg *a, JSON_Agg_Table *t, const _JSON_Agg_Entry *src, const char *key, int can_spill) {
+  _JSON_Agg_Entry *e = _jsona_find(a, t, src->hash, key, src->key_length, can_spill);
+  const _JSON_Agg_Acc *from;
+  unsigned char *registers;
+  const unsigned char *from_registers;
+  unsigned long i;
+  int c;
+
+  if(!e) return 0;
+
+  e->count += src->count;
+  for(c = 0; c < a->column_count; c++) {
+    switch(a->columns[c].op) {
+      case JSONA_SUM:
+      case JSONA_MIN:
+      case JSONA_MAX: {
+        from = _JSONA_ACC(src, c);
+        if(from->ints) _jsona_int(_JSONA_ACC(e, c), a->columns[c].op, from->i, from->ints);
+        if(from->doubles) _jsona_double(_JSONA_ACC(e, c), a->columns[c].op, from->d, from->doubles);
+        break;
+      }
+      case JSONA_DISTINCT: {
+        registers = _JSONA_HLL(a, e, c);
+        from_registers = _JSONA_HLL(a, src, c);
+        for(i = 0; i < (1ul << JSONA_HLL_BITS); i++) {
+          if(from_registers[i] > registers[i]) registers[i] = from_registers[i];
+        }
+        break;
+      }
+    }
+  }
+  return 1;
+}
+
+/* JSON_Read_Project_Hit: keep the value for when the whole record was seen. */
+static int _jsona_hit(JSON_Read_Data *j, int path, void *user) {
+  JSON_Agg_Table *t = (JSON_Agg_Table*)user;
+  _JSON_Agg_Value *v = &t->values[path];
+  char *str;
+  unsigned long length;
+
+  v->type = jsonr_v_get_type(j);
+  switch(v->type) {
+    case JSONR_V_NUMBER: v->is_int = jsonr_v_number_int(j, &v->i, &v->d); break;
+    case JSONR_V_STRING: {
+      jsonr_v_string(j, &str, &length);
+      if(length > JSONA_RECORD_TEXT - t->text_used) length = JSONA_RECORD_TEXT - t->text_used;
+
+      memcpy(t->text + t->text_used, str, length);
+      v->text = t->text_used;
+      v->length = length;
+      t->text_used += length;
+      break;
+    }
+    case JSONR_V_BOOL: v->i = jsonr_v_bool(j); break;
+    default: {
+      jsonr_v_skip_fast(j);
+      v->type = JSONR_V_NULL;
+      break;
+    }
+  }
+  return !j->error;
+}
+
+/* The record's group values one after the other: a type byte, then the value. */
+static unsigned long _jsona_key(JSON_Agg *a, JSON_Agg_Table *t) {
+  const _JSON_Agg_Value *v;
+  char *cursor = t->key;
+  int c;
+
+  for(c = 0; c < a->column_count; c++) {
+    if(a->columns[c].op != JSONA_GROUP) continue;
+
+    v = &t->values[a->column_path[c]];
+    switch(v->type) {
+      case JSONR_V_STRING: {
+        *cursor++ = 's';
+        memcpy(cursor, &v->length, sizeof(v->length));
+        cursor += sizeof(v->length);
+        memcpy(cursor, t->text + v->text, v->length);
+        cursor += v->length;
+        break;
+      }
+      case JSONR_V_NUMBER: {
+        if(v->is_int) {
+          *cursor++ = 'i';
+          memcpy(cursor, &v->i, sizeof(v->i));
+          cursor += sizeof(v->i);
+        }
+        else {
+          *cursor++ = 'd';
+          memcpy(cursor, &v->d, sizeof(v->d));
+          cursor += sizeof(v->d);
+        }
+        break;
+      }
+      case JSONR_V_BOOL: *cursor++ = v->i ? 't' : 'f'; break;
+      default: *cursor++ = 'n'; break;
+    }
+  }
+  return cursor - t->key;
+}
+
+static int _jsona_add_record(JSON_Agg *a, JSON_Agg_Table *t) {
+  unsigned long key_length = _jsona_key(a, t);
+  const _JSON_Agg_Value *v;
+  _JSON_Agg_Entry *e;
+  unsigned long long hash;
+  int c;
+
+  e = _jsona_find(a, t, _jsona_hash(t->key, key_length, 0), t->key, key_length, 1);
+  if(!e) return 0;
+
+  e->count += 1;
+  for(c = 0; c < a->column_count; c++) {
+    if(a->column_path[c] < 0) continue;
+    v = &t->values[a->column_path[c]];
+
+    switch(a->columns[c].op) {
+      case JSONA_SUM:
+      case JSONA_MIN:
+      case JSONA_MAX: {
+        if(v->type != JSONR_V_NUMBER) break;
+        if(v->is_int) _jsona_int(_JSONA_ACC(e, c), a->columns[c].op, v->i, 1);
+        else _jsona_double(_JSONA_ACC(e, c), a->columns[c].op, v->d, 1);
+        break;
+      }
+      case JSONA_DISTINCT: {
+        /* Seeded with the type, so 1, 1.0, "1" and true are all different values. */
+        switch(v->type) {
+          case JSONR_V_STRING: hash = _jsona_hash(t->text + v->text, v->length, 's'); break;
+          case JSONR_V_NUMBER: hash = v->is_int ? _jsona_hash((const char*)&v->i, sizeof(v->i), 'i') : _jsona_hash((const char*)&v->d, sizeof(v->d), 'd'); break;
+          case JSONR_V_BOOL: hash = _jsona_hash((const char*)&v->i, sizeof(v->i), 'b'); break;
+          default: continue;
+        }
+        _jsona_hll_add(_JSONA_HLL(a, e, c), hash);
+        break;
+      }
+    }
+  }
+  return 1;
+}
+
+static int _jsona_feed_table(JSON_Agg *a, JSON_Agg_Table *t, JSON_Read_Data *j) {
+  int i;
+
+  while(!t->error && !j->error) {
+    if(jsonr_v_get_type(j) == JSONR_V_INVALID) {
+      /* Not the end of the input: let jsonr_v_skip report what's there. */
+      if(j->c != EOF) jsonr_v_skip(j);
+      break;
+    }
+
+    for(i = 0; i < a->path_count; i++) t->values[i].type = JSONR_V_INVALID;
+    t->text_used = 0;
+
+    /* Stopped early: everything we're after was found, the rest of the record doesn't matter. */
+    if(!jsonr_project(j, &a->projection, _jsona_hit, t)) {
+      if(j->error) break;
+      jsonr_skip_line(j);
+    }
+
+    if(!_jsona_add_record(a, t)) break;
+    t->records += 1;
+  }
+
+  if(j->error && !t->error) {
+    t->error = JSONA_E_READ;
+    t->read_error_code = j->error_code;
+    t->error_offset = j->error_offset;
+  }
+  return !t->error;
+}
+
+/* Take over the first error of a table, 'base' is where the table's input started. */
+static void _jsona_table_error(JSON_Agg *a, JSON_Agg_Table *t, unsigned long base) {
+  if(!t->error || a->error) return;
+
+  a->error = t->error;
+  a->read_error_code = t->read_error_code;
+  a->error_offset = base + t->error_offset;
+}
+
+static void _jsona_count_records(JSON_Agg *a) {
+  int i;
+
+  a->records = 0;
+  for(i = 0; i < a->table_count; i++) {
+    if(a->tables[i]) a->records += a->tables[i]->records;
+  }
+}
+
+JSONAGG_DEF int jsona_init(JSON_Agg *a, const JSON_Agg_Column *columns, int column_count, unsigned long max_groups) {
+  int c, p, i;
+
+  memset(a, 0, sizeof(*a));
+  jsonr_projection_init(&a->projection);
+  a->max_groups = max_groups ? max_groups : JSONA_MAX_GROUPS;
+  a->entry_size = sizeof(_JSON_Agg_Entry) + column_count * sizeof(_JSON_Agg_Acc);
+
+  if(column_count > JSONA_COLUMNS) {
+    a->error = JSONA_E_SPEC;
+    return 0;
+  }
+
+  for(c = 0; c < column_count; c++) {
+    a->columns[c] = columns[c];
+    a->column_path[c] = -1;
+    if(columns[c].op == JSONA_COUNT) continue;
+
+    /* Columns on the same path share its value. */
+    for(p = 0; p < a->path_count; p++) {
+      if(strcmp(a->paths[p], columns[c].path) == 0) break;
+    }
+    if(p == a->path_count) {
+      if(!jsonr_projection_add(&a->projection, columns[c].path, p)) {
+        a->error = JSONA_E_SPEC;
+        return 0;
+      }
+      a->paths[p] = columns[c].path;
+      a->path_count += 1;
+    }
+    a->column_path[c] = p;
+
+    /* Grouping by the same path twice adds nothing, and every group value has to fit the key. */
+    if(columns[c].op == JSONA_GROUP) {
+      for(i = 0; i < c; i++) {
+        if(a->columns[i].op == JSONA_GROUP && a->column_path[i] == p) {
+          a->error = JSONA_E_SPEC;
+          return 0;
+        }
+      }
+    }
+
+    if(columns[c].op == JSONA_DISTINCT) {
+      a->hll_offset[c] = a->entry_size;
+      a->entry_size += 1 << JSONA_HLL_BITS;
+    }
+  }
+  a->column_count = column_count;
+
+  /* Entries are laid out back to back. */
+  a->entry_size = (a->entry_size + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+  return 1;
+}
+
+JSONAGG_DEF int jsona_feed(JSON_Agg *a, JSON_Read_Data *j) {
+  JSON_Agg_Table *t;
+
+  if(a->error) return 0;
+
+  t = _jsona_table(a, 0);
+  if(!t) return 0;
+
+  _jsona_feed_table(a, t, j);
+  _jsona_table_error(a, t, 0);
+  _jsona_count_records(a);
+  return !a->error;
+}
+
+#ifdef JSONAGG_POSIX
+typedef struct {
+  pthread_t thread;
+  JSON_Agg *a;
+  JSON_Agg_Table *table;
+  const char *data;
+  unsigned long begin;
+  unsigned long end;
+  JSON_Read_Data j;
+} _JSON_Agg_Worker;
+
+static void *_jsona_worker_thread(void *arg) {
+  _JSON_Agg_Worker *worker = (_JSON_Agg_Worker*)arg;
+
+  jsonr_init_mem(&worker->j, worker->data + worker->begin, worker->end - worker->begin);
+  _jsona_feed_table(worker->a, worker->table, &worker->j);
+  return 0;
+}
+
+JSONAGG_DEF int jsona_feed_mem_parallel(JSON_Agg *a, const char *data, unsigned long length, int thread_count) {
+  _JSON_Agg_Worker *workers;
+  const char *newline;
+  unsigned long begin = 0;
+  unsigned long end;
+  int started;
+  int i;
+
+  if(a->error) return 0;
+  if(thread_count < 1) thread_count = 1;
+  if(thread_count > JSONA_THREADS) thread_count = JSONA_THREADS;
+
+  /* The readers are big, keep them off the stack. */
+  workers = (_JSON_Agg_Worker*)malloc(thread_count * sizeof(_JSON_Agg_Worker));
+  if(!workers) {
+    a->error = JSONA_E_MEMORY;
+    return 0;
+  }
+
+  /* Even runs of bytes, each pushed out to the end of the line it stops in. */
+  for(i = 0; i < thread_count; i++) {
+    end = i == thread_count - 1 ? length : length / thread_count * (i + 1);
+    if(end < begin) end = begin;
+    if(end > 0 && end < length && data[end - 1] != '\n') {
+      newline = (const char*)memchr(data + end, '\n', length - end);
+      end = newline ? (unsigned long)(newline - data) + 1 : length;
+    }
+
+    workers[i].a = a;
+    workers[i].table = _jsona_table(a, i);
+    workers[i].data = data;
+    workers[i].begin = begin;
+    workers[i].end = end;
+    begin = end;
+
+    if(!workers[i].table) {
+      free(workers);
+      return 0;
+    }
+  }
+
+  /* Worker 0 runs on the calling thread. */
+  for(started = 1; started < thread_count; started++) {
+    if(pthread_create(&workers[started].thread, 0, _jsona_worker_thread, &workers[started]) != 0) {
+      break;
+    }
+  }
+  _jsona_worker_thread(&workers[0]);
+  for(i = started; i < thread_count; i++) {
+    _jsona_worker_thread(&workers[i]);
+  }
+  for(i = 1; i < started; i++) {
+    pthread_join(workers[i].thread, 0);
+  }
+
+  for(i = 0; i < thread_count; i++) {
+    _jsona_table_error(a, workers[i].table, workers[i].begin);
+  }
+  _jsona_count_records(a);
+
+  free(workers);
+  return !a->error;
+}
+#endif
+
+/* Writes the group value at 'key', returns where the next one starts. */
+static const char * _jsona_write_value(JSON_Write_Data *w, const char *key) {
+  unsigned long length;
+  long i;
+  double d;
+
+  switch(*key) {
+    case 's': {
+      memcpy(&length, key + 1, sizeof(length));
+      jsonw_v_stringlen(w, key + 1 + sizeof(length), length);
+      return key + 1 + sizeof(length) + length;
+    }
+    case 'i': {
+      memcpy(&i, key + 1, sizeof(i));
+      jsonw_v_int(w, i);
+      return key + 1 + sizeof(i);
+    }
+    case 'd': {
+      memcpy(&d, key + 1, sizeof(d));
+      jsonw_v_float(w, d);
+      return key + 1 + sizeof(d);
+    }
+    case 't': jsonw_v_bool(w, 1); return key + 1;
+    case 'f': jsonw_v_bool(w, 0); return key + 1;
+  }
+
+  jsonw_v_raw(w, "null", 4);
+  return key + 1;
+}
+
+static void _jsona_write_entry(JSON_Agg *a, JSON_Write_Data *w, JSON_Agg_Table *t, _JSON_Agg_Entry *e) {
+  const char *key = t->keys + e->key;
+  const _JSON_Agg_Acc *acc;
+  int op;
+  int c;
+
+  jsonw_v_table_begin(w);
+  for(c = 0; c < a->column_count; c++) {
+    op = a->columns[c].op;
+    acc = _JSONA_ACC(e, c);
+    jsonw_k(w, a->columns[c].name);
+
+    switch(op) {
+      case JSONA_GROUP: key = _jsona_write_value(w, key); break;
+      case JSONA_COUNT: jsonw_v_uint(w, e->count); break;
+      case JSONA_DISTINCT: jsonw_v_uint(w, _jsona_hll_estimate(_JSONA_HLL(a, e, c))); break;
+      default: {
+        if(!acc->ints && !acc->doubles) {
+          jsonw_v_raw(w, "null", 4);
+        }
+        else if(op == JSONA_SUM) {
+          if(acc->doubles) jsonw_v_float(w, acc->i + acc->d);
+          else jsonw_v_int(w, acc->i);
+        }
+        else if(acc->doubles && (!acc->ints || (op == JSONA_MIN ? acc->d < acc->i : acc->d > acc->i))) {
+          jsonw_v_float(w, acc->d);
+        }
+        else {
+          jsonw_v_int(w, acc->i);
+        }
+        break;
+      }
+    }
+  }
+  jsonw_v_table_end(w);
+}
+
+static void _jsona_free_groups(JSON_Agg_Table *t) {
+  free(t->slots);
+  free(t->entries);
+  free(t->keys);
+  t->slots = 0;
+  t->slot_count = 0;
+  t->entries = 0;
+  t->entry_count = 0;
+  t->entry_capacity = 0;
+  t->keys = 0;
+  t->keys_used = 0;
+  t->keys_capacity = 0;
+}
+
+/* Merge partition 'p' of every table's spill files into 't' and write it out. */
+static int _jsona_write_partition(JSON_Agg *a, JSON_Write_Data *w, JSON_Agg_Table *t, _JSON_Agg_Entry *entry, int p) {
+  JSON_Agg_Table *from;
+  FILE *f;
+  unsigned long i;
+  int k;
+
+  for(k = 0; k < a->table_count; k++) {
+    from = a->tables[k];
+    f = from->spill[p];
+    if(!f) continue;
+
+    rewind(f);
+    while(fread(entry, a->entry_size, 1, f) == 1) {
+      /* The key came from a table's key buffer, so it fits in one. */
+      if(entry->key_length > sizeof(t->key) || fread(t->key, 1, entry->key_length, f) != entry->key_length) {
+        _jsona_fail(t, JSONA_E_SPILL);
+        return 0;
+      }
+      if(!_jsona_absorb(a, t, entry, t->key, 0)) return 0;
+    }
+    if(ferror(f)) {
+      _jsona_fail(t, JSONA_E_SPILL);
+      return 0;
+    }
+
+    fclose(f);
+    from->spill[p] = 0;
+  }
+
+  for(i = 0; i < t->entry_count; i++) {
+    _jsona_write_entry(a, w, t, _JSONA_ENTRY(a, t, i));
+  }
+  _jsona_clear(t);
+  return 1;
+}
+
+JSONAGG_DEF int jsona_write(JSON_Agg *a, JSON_Write_Data *w) {
+  JSON_Agg_Table *t;
+  JSON_Agg_Table *from;
+  _JSON_Agg_Entry *entry;
+  unsigned long i;
+  int spilled = 0;
+  int k, p;
+
+  if(a->error) return 0;
+
+  t = _jsona_table(a, 0);
+  if(!t) return 0;
+
+  /* Everything into the first table. It spills like it would while feeding. */
+  for(k = 1; k < a->table_count && !t->error; k++) {
+    from = a->tables[k];
+    for(i = 0; i < from->entry_count; i++) {
+      entry = _JSONA_ENTRY(a, from, i);
+      if(!_jsona_absorb(a, t, entry, from->keys + entry->key, 1)) break;
+    }
+    _jsona_free_groups(from);
+  }
+
+  for(k = 0; k < a->table_count; k++) {
+    spilled |= a->tables[k]->spilled;
+  }
+
+  jsonw_v_array_begin(w);
+
+  if(!spilled) {
+    for(i = 0; i < t->entry_count && !t->error; i++) {
+      _jsona_write_entry(a, w, t, _JSONA_ENTRY(a, t, i));
+    }
+    _jsona_clear(t);
+  }
+  else if(_jsona_spill(a, t)) {
+    entry = (_JSON_Agg_Entry*)malloc(a->entry_size);
+    if(!entry) _jsona_fail(t, JSONA_E_MEMORY);
+
+    for(p = 0; p < JSONA_PARTITIONS && !t->error; p++) {
+      _jsona_write_partition(a, w, t, entry, p);
+    }
+    free(entry);
+  }
+
+  jsonw_v_array_end(w);
+
+  _jsona_table_error(a, t, 0);
+  return !a->error && !w->error;
+}
+
+JSONAGG_DEF void jsona_free(JSON_Agg *a) {
+  int k, p;
+
+  for(k = 0; k < a->table_count; k++) {
+    if(!a->tables[k]) continue;
+
+    _jsona_free_groups(a->tables[k]);
+    for(p = 0; p < JSONA_PARTITIONS; p++) {
+      if(a->tables[k]->spill[p]) fclose(a->tables[k]->spill[p]);
+    }
+    free(a->tables[k]);
+    a->tables[k] = 0;
+  }
+  a->table_count = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+#endif
+
+/*
+  Public Domain (www.unlicense.org)
+  This is free and unencumbered software released into the public domain.
+  Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+  software, either in source code form or as a compiled binary, for any purpose,
+  commercial or non-commercial, and by any means.
+  In jurisdictions that recognize copyright laws, the author or authors of this
+  software dedicate any and all copyright interest in the software to the public
+  domain. We make this dedication for the benefit of the public at large and to
+  the detriment of our heirs and successors. We intend this dedication to be an
+  overt act of relinquishment in perpetuity of all present and future rights to
+  this software under copyright law.
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
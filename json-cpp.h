@@ -0,0 +1,830 @@
+/*
+  * json-cpp.h - public domain - C++ front end for json-read.h/json-write.h
+
+  * jsonr::reader<Source> and jsonw::writer<Sink> do what the jsonr_* / jsonw_* functions do, but
+    the input/output is a policy type known at compile time. Every byte access and flush inlines
+    into the parsing/formatting code, and loops over contiguous input can be vectorized.
+  * Same rules as the C API: commas are checked like jsonr_v_table_can_read/jsonr_v_array_can_read
+    do, jsonw_maybe_comma style commas are written, strings are escaped the same way, errors are
+    JSONR_E_* codes. Keys and strings are read into a JSONR_STRINGLEN_READ_BUFFER_SIZE buffer
+    inside the reader.
+  * Header only, no IMPL define needed. No exceptions, no allocations, no standard library.
+
+  * Sources: jsonr::span_source (memory), jsonr::file_source (FILE *), jsonr::fd_source and
+    jsonr::mmap_source (POSIX).
+    A source has 'cur' and 'end' pointers to the bytes it has ready and a 'bool refill()' that is
+    called when cur reaches end. It returns false at the end of the input.
+
+  * Sinks: jsonw::span_sink (memory), jsonw::file_sink (FILE *), jsonw::fd_sink (POSIX).
+    A sink has 'cur' and 'end' pointers to the space it has ready, a 'bool flush()' that is called
+    when cur reaches end (and has to make room) and a 'bool finish()'.
+
+  * Usage:
+    {
+      jsonr::reader<jsonr::span_source> r(jsonr::span_source(data, length));
+      for(r.table_begin(); r.table_can_read(); ) {
+        if(r.k_case("x")) x = r.v_number();
+        else r.kv_skip();
+      }
+      if(r.error) ...
+
+      jsonw::writer<jsonw::file_sink<> > w(jsonw::file_sink<>(stdout));
+      w.table_begin();
+        w.kv_int("x", 1);
+      w.table_end();
+      if(!w.finish()) ...
+    }
+*/
+
+#ifndef JSON_CPP_H
+#define JSON_CPP_H
+
+/* json-read.h has no include guard, so only pull it in for the JSONR_* enums and sizes if it
+ * wasn't included yet. */
+#ifndef JSONREAD_DEF
+  #include "json-read.h"
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+  #define JSON_CPP_POSIX
+  #include <errno.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
+
+namespace jsonr {
+
+/* ============================================ */
+/* ================= Sources ================== */
+/* ============================================ */
+
+struct span_source {
+  const char *cur;
+  const char *end;
+
+  span_source(const char *data, unsigned long length) : cur(data), end(data + length) {}
+  bool refill() { return false; }
+};
+
+template<unsigned long BlockSize = JSONR_FILE_BLOCK_SIZE>
+struct file_source {
+  FILE *f;
+  const char *cur;
+  const char *end;
+  char block[BlockSize];
+
+  /* cur/end start out empty so copies don't point into the original's block. */
+  explicit file_source(FILE *f) : f(f), cur(0), end(0) {}
+
+  bool refill() {
+    unsigned long got = fread(block, 1, BlockSize, f);
+    cur = block;
+    end = block + got;
+    return got > 0;
+  }
+};
+
+#ifdef JSON_CPP_POSIX
+template<unsigned long BlockSize = JSONR_FILE_BLOCK_SIZE>
+struct fd_source {
+  int fd;
+  const char *cur;
+  const char *end;
+  char block[BlockSize];
+
+  explicit fd_source(int fd) : fd(fd), cur(0), end(0) {}
+
+  bool refill() {
+    long got;
+    do {
+      got = read(fd, block, BlockSize);
+    } while(got < 0 && errno == EINTR);
+
+    cur = block;
+    end = block + (got > 0 ? got : 0);
+    return got > 0;
+  }
+};
+
+/* Maps the whole file and reads it like a span_source. The mapping is owned by this object, not
+ * by the readers it's copied into: call unmap when done. */
+struct mmap_source : span_source {
+  void *base;
+  unsigned long length;
+
+  explicit mmap_source(const char *path) : span_source(0, 0), base(0), length(0) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return;
+
+    if(fstat(fd, &st) == 0 && st.st_size > 0) {
+      base = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if(base == MAP_FAILED) {
+        base = 0;
+      }
+      else {
+        length = st.st_size;
+        madvise(base, length, MADV_SEQUENTIAL);
+      }
+    }
+    close(fd);
+
+    cur = (const char*)base;
+    end = cur + length;
+  }
+
+  bool ok() const { return base != 0; }
+  void unmap() { if(base) munmap(base, length); base = 0; }
+};
+#endif
+
+/* ============================================ */
+/* ================== Reader ================== */
+/* ============================================ */
+
+template<typename Source>
+struct reader {
+  Source src;
+  int got_comma;
+  int error; /* if set to 1: we encountered an error. */
+  int error_code; /* JSONR_E_* */
+
+  /* See JSON_Read_Data::key_pending. */
+  int key_pending;
+  char *key;
+  unsigned long key_length;
+
+  char buf[JSONR_STRINGLEN_READ_BUFFER_SIZE];
+
+  explicit reader(const Source &src) :
+    src(src), got_comma(0), error(0), error_code(JSONR_E_NONE), key_pending(0), key(0), key_length(0) {}
+
+  /* ============== Byte access ============== */
+
+  int peek() {
+    if(src.cur == src.end && !src.refill()) return EOF;
+    return (unsigned char)*src.cur;
+  }
+
+  void advance() {
+    src.cur++;
+  }
+
+  int skip_whitespace() {
+    for(;;) {
+      while(src.cur != src.end) {
+        switch(*src.cur) {
+          case ' ': case '\t': case '\n': case '\r': case '\v': case '\f': src.cur++; break;
+          default: return (unsigned char)*src.cur;
+        }
+      }
+      if(!src.refill()) return EOF;
+    }
+  }
+
+  void fail(int code) {
+    if(error) return;
+    error = 1;
+    error_code = code;
+  }
+
+  /* ============== Structure ============== */
+
+  int maybe_read_comma() {
+    if(skip_whitespace() == ',') {
+      got_comma = 1;
+      advance();
+      return 1;
+    }
+    return 0;
+  }
+
+  int table_begin() { return begin('{'); }
+  int array_begin() { return begin('['); }
+
+  int table_can_read() {
+    if(error) return 0;
+    if(key_pending) {
+      kv_skip();
+      if(error) return 0;
+    }
+    return can_read('}', JSONR_E_TABLE_ENDED);
+  }
+
+  int array_can_read() {
+    if(error) return 0;
+    return can_read(']', JSONR_E_ARRAY_ENDED);
+  }
+
+  /* ============== Keys ============== */
+
+  void k(char **out, unsigned long *len) {
+    if(error) return;
+
+    if(key_pending) {
+      key_pending = 0;
+      *out = key;
+      *len = key_length;
+      return;
+    }
+
+    read_string_fixed_size(out, len);
+    if(error) return;
+
+    if(skip_whitespace() != ':') {
+      fail(JSONR_E_UNEXPECTED_CHAR);
+      return;
+    }
+    advance();
+  }
+
+  int k_is(const char *wants, unsigned long wants_len) {
+    if(error) return 0;
+
+    if(!key_pending) {
+      k(&key, &key_length);
+      if(error) return 0;
+      key_pending = 1;
+    }
+    return key_length == wants_len && memcmp(key, wants, wants_len) == 0;
+  }
+
+  int k_is(const char *wants) { return k_is(wants, strlen(wants)); }
+
+  int k_case(const char *wants) {
+    if(k_is(wants)) {
+      k_eat();
+      return 1;
+    }
+    return 0;
+  }
+
+  void k_eat() {
+    char *out;
+    unsigned long len;
+    k(&out, &len);
+  }
+
+  void kv_skip() {
+    k_eat();
+    if(error) return;
+    v_skip();
+  }
+
+  /* ============== Values ============== */
+
+  int v_get_type() {
+    if(error) return JSONR_V_INVALID;
+
+    switch(skip_whitespace()) {
+      case '\"': return JSONR_V_STRING;
+      case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
+      case '-': case '+': case '.': return JSONR_V_NUMBER;
+      case 't': case 'f': return JSONR_V_BOOL;
+      case 'n': return JSONR_V_NULL;
+      case '{': return JSONR_V_TABLE;
+      case '[': return JSONR_V_ARRAY;
+    }
+    return JSONR_V_INVALID;
+  }
+
+  double v_number() {
+    char num[JSONR_NUMBER_MAX_LENGTH+1];
+    unsigned long length = 0;
+    char *num_end;
+    double val;
+    int c;
+
+    if(error) return 0;
+
+    for(c = skip_whitespace(); is_number_char(c); c = peek()) {
+      if(length == JSONR_NUMBER_MAX_LENGTH) {
+        fail(JSONR_E_NUMBER_TOO_LONG);
+        return 0;
+      }
+      num[length++] = (char)c;
+      advance();
+    }
+    num[length] = 0;
+
+    if(length == 0) {
+      fail(JSONR_E_EXPECTED_NUMBER);
+      return 0;
+    }
+
+    val = strtod(num, &num_end);
+    if(num_end != num + length) {
+      fail(JSONR_E_MALFORMED_NUMBER);
+      return 0;
+    }
+
+    maybe_read_comma();
+    return val;
+  }
+
+  int v_bool() {
+    int c;
+    if(error) return 0;
+
+    c = skip_whitespace();
+    if(c == 't') {
+      if(!match_literal("true", 4)) return 0;
+      maybe_read_comma();
+      return 1;
+    }
+    else if(c == 'f') {
+      if(!match_literal("false", 5)) return 0;
+      maybe_read_comma();
+      return 0;
+    }
+
+    fail(JSONR_E_EXPECTED_BOOL);
+    return 0;
+  }
+
+  int v_null() {
+    if(error) return 0;
+
+    if(skip_whitespace() != 'n') {
+      fail(JSONR_E_UNEXPECTED_CHAR);
+      return 0;
+    }
+    if(!match_literal("null", 4)) return 0;
+    maybe_read_comma();
+    return 1;
+  }
+
+  void v_string(char **val, unsigned long *len) {
+    read_string_fixed_size(val, len);
+    if(error) return;
+    maybe_read_comma();
+  }
+
+  void v_skip() {
+    int type;
+
+    if(error) return;
+
+    type = v_get_type();
+    switch(type) {
+      case JSONR_V_INVALID: fail(JSONR_E_INVALID_VALUE); break;
+      case JSONR_V_NUMBER: v_number(); break;
+      case JSONR_V_BOOL: v_bool(); break;
+      case JSONR_V_NULL: v_null(); break;
+      case JSONR_V_STRING: {
+        advance();
+        read_string(0, 0, 0);
+        if(!error) maybe_read_comma();
+        break;
+      }
+      case JSONR_V_ARRAY: {
+        for(array_begin(); array_can_read(); ) v_skip();
+        break;
+      }
+      case JSONR_V_TABLE: {
+        for(table_begin(); table_can_read(); ) {
+          k_eat();
+          v_skip();
+        }
+        break;
+      }
+    }
+  }
+
+  /* ============== Low-level ============== */
+
+  /* Reads the rest of a string whose opening quote was consumed into out[0..cap), skipping what
+   * doesn't fit. Pass out = 0 to only skip it. Runs without escapes are copied in one go. */
+  void read_string(char *out, unsigned long cap, unsigned long *len) {
+    unsigned long used = 0;
+    const char *run;
+    unsigned long run_length;
+    char c;
+
+    for(;;) {
+      if(src.cur == src.end && !src.refill()) {
+        fail(JSONR_E_STRING_EOF);
+        break;
+      }
+
+      run = src.cur;
+      while(src.cur != src.end && !is_string_special(*src.cur)) src.cur++;
+
+      run_length = src.cur - run;
+      if(out && used < cap) {
+        if(run_length > cap - used) run_length = cap - used;
+        memcpy(out + used, run, run_length);
+        used += run_length;
+      }
+
+      if(src.cur == src.end) continue;
+
+      c = *src.cur;
+      src.cur++;
+
+      if(c == '\"') break;
+      if(c != '\\') {
+        fail(JSONR_E_UNESCAPED_CHAR);
+        break;
+      }
+
+      if(src.cur == src.end && !src.refill()) {
+        fail(JSONR_E_STRING_EOF);
+        break;
+      }
+      c = *src.cur;
+      src.cur++;
+
+      if(is_unescaped_char(c)) {
+        fail(JSONR_E_UNESCAPED_CHAR);
+        break;
+      }
+
+      switch(c) {
+        case 'b': c = '\b'; break;
+        case 'f': c = '\f'; break;
+        case 'n': c = '\n'; break;
+        case 'r': c = '\r'; break;
+        case 't': c = '\t'; break;
+      }
+      if(out && used < cap) out[used++] = c;
+    }
+
+    if(len) *len = used;
+  }
+
+  void read_string_fixed_size(char **val, unsigned long *len) {
+    *val = buf;
+    *len = 0;
+
+    if(error) return;
+
+    if(skip_whitespace() != '\"') {
+      fail(JSONR_E_UNEXPECTED_CHAR);
+      return;
+    }
+    advance();
+
+    read_string(buf, sizeof(buf), len);
+  }
+
+private:
+  int begin(char open) {
+    int c;
+    if(error) return 0;
+
+    c = skip_whitespace();
+    if(c == open) {
+      got_comma = 1;
+      advance();
+      return 1;
+    }
+    else if(c == EOF) {
+      fail(JSONR_E_UNEXPECTED_EOF);
+    }
+    return 0;
+  }
+
+  int can_read(char close, int ended_code) {
+    if(skip_whitespace() == close) {
+      if(got_comma) {
+        got_comma = 0;
+        fail(ended_code);
+        return 0;
+      }
+      advance();
+      maybe_read_comma();
+      return 0;
+    }
+
+    if(!got_comma) {
+      fail(JSONR_E_EXPECTED_COMMA);
+      return 0;
+    }
+    got_comma = 0;
+    return 1;
+  }
+
+  int match_literal(const char *literal, int length) {
+    int i;
+    for(i = 0; i < length; i++) {
+      if(peek() != literal[i]) {
+        fail(JSONR_E_UNEXPECTED_CHAR);
+        return 0;
+      }
+      advance();
+    }
+    return 1;
+  }
+
+  static bool is_number_char(int c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+  }
+
+  static bool is_unescaped_char(char c) {
+    return c == '\b' || c == '\f' || c == '\n' || c == '\r' || c == '\t';
+  }
+
+  static bool is_string_special(char c) {
+    return c == '\"' || c == '\\' || is_unescaped_char(c);
+  }
+};
+
+}
+
+namespace jsonw {
+
+/* ============================================ */
+/* ================== Sinks =================== */
+/* ============================================ */
+
+/* Writes into a fixed block of memory. Runs out of room instead of flushing. */
+struct span_sink {
+  char *begin;
+  char *cur;
+  char *end;
+
+  span_sink(char *buf, unsigned long size) : begin(buf), cur(buf), end(buf + size) {}
+  bool flush() { return false; }
+  bool finish() { return true; }
+  unsigned long used() const { return cur - begin; }
+};
+
+template<unsigned long BlockSize = 1024*8>
+struct file_sink {
+  FILE *f;
+  char *cur;
+  char *end;
+  char block[BlockSize];
+
+  /* cur/end start out empty so copies don't point into the original's block. */
+  explicit file_sink(FILE *f) : f(f), cur(0), end(0) {}
+
+  bool flush() {
+    bool ok = true;
+    if(cur) ok = fwrite(block, 1, cur - block, f) == (unsigned long)(cur - block);
+    cur = block;
+    end = block + BlockSize;
+    return ok;
+  }
+
+  bool finish() {
+    return flush() && fflush(f) == 0;
+  }
+};
+
+#ifdef JSON_CPP_POSIX
+template<unsigned long BlockSize = 1024*64>
+struct fd_sink {
+  int fd;
+  char *cur;
+  char *end;
+  char block[BlockSize];
+
+  explicit fd_sink(int fd) : fd(fd), cur(0), end(0) {}
+
+  bool flush() {
+    const char *data = block;
+    long got;
+
+    if(cur) {
+      while(data != cur) {
+        got = write(fd, data, cur - data);
+        if(got < 0 && errno == EINTR) continue;
+        if(got <= 0) return false;
+        data += got;
+      }
+    }
+    cur = block;
+    end = block + BlockSize;
+    return true;
+  }
+
+  bool finish() { return flush(); }
+};
+#endif
+
+/* ============================================ */
+/* ================== Writer ================== */
+/* ============================================ */
+
+template<typename Sink>
+struct writer {
+  Sink sink;
+  long table_stack;
+  long array_stack;
+  int do_comma;
+  int error; /* if set to 1: the sink couldn't take the output. */
+
+  explicit writer(const Sink &sink) : sink(sink), table_stack(0), array_stack(0), do_comma(0), error(0) {}
+
+  /* ============== Output ============== */
+
+  void put(char c) {
+    if(sink.cur == sink.end && !make_room()) return;
+    *sink.cur++ = c;
+  }
+
+  void write(const char *data, unsigned long length) {
+    unsigned long room;
+    while(length > 0) {
+      if(sink.cur == sink.end && !make_room()) return;
+
+      room = sink.end - sink.cur;
+      if(room > length) room = length;
+      memcpy(sink.cur, data, room);
+      sink.cur += room;
+      data += room;
+      length -= room;
+    }
+  }
+
+  bool finish() {
+    if(!sink.finish()) error = 1;
+    return !error;
+  }
+
+  /* ============== Structure ============== */
+
+  void maybe_comma() {
+    if(do_comma) {
+      put(',');
+      do_comma = 0;
+    }
+  }
+
+  void table_begin() { maybe_comma(); table_stack++; put('{'); }
+  void table_end() {
+    if(table_stack <= 0) {
+      assert(0 && "Mismatched table_begin and table_end calls!");
+    }
+    table_stack--;
+    put('}');
+    do_comma = 1;
+  }
+
+  void array_begin() { maybe_comma(); array_stack++; put('['); }
+  void array_end() {
+    if(array_stack <= 0) {
+      assert(0 && "Mismatched array_begin and array_end calls!");
+    }
+    array_stack--;
+    put(']');
+    do_comma = 1;
+  }
+
+  void k(const char *str, unsigned long length) {
+    maybe_comma();
+    put('\"');
+    escaped_string(str, length);
+    put('\"');
+    put(':');
+  }
+
+  void k(const char *cstr) { k(cstr, strlen(cstr)); }
+
+  /* ============== Values ============== */
+
+  void v_int(long val) {
+    char num[24];
+    unsigned long length;
+    maybe_comma();
+    if(val < 0) {
+      put('-');
+      length = format_uint(num, 0ul - (unsigned long)val);
+    }
+    else {
+      length = format_uint(num, val);
+    }
+    write(num, length);
+    do_comma = 1;
+  }
+
+  void v_uint(unsigned long val) {
+    char num[24];
+    maybe_comma();
+    write(num, format_uint(num, val));
+    do_comma = 1;
+  }
+
+  void v_float(double val) {
+    char num[512];
+    maybe_comma();
+    write(num, snprintf(num, sizeof(num), "%f", val));
+    do_comma = 1;
+  }
+
+  void v_bool(int val) {
+    maybe_comma();
+    if(val == 0) write("false", 5);
+    else write("true", 4);
+    do_comma = 1;
+  }
+
+  void v_string(const char *val, unsigned long len) {
+    maybe_comma();
+    put('\"');
+    escaped_string(val, len);
+    put('\"');
+    do_comma = 1;
+  }
+
+  void v_string(const char *val) { v_string(val, strlen(val)); }
+
+  void v_raw(const char *val, unsigned long len) {
+    maybe_comma();
+    write(val, len);
+    do_comma = 1;
+  }
+
+  void kv_int(const char *key, long val) { k(key); v_int(val); }
+  void kv_uint(const char *key, unsigned long val) { k(key); v_uint(val); }
+  void kv_float(const char *key, double val) { k(key); v_float(val); }
+  void kv_bool(const char *key, int val) { k(key); v_bool(val); }
+  void kv_string(const char *key, const char *val) { k(key); v_string(val); }
+
+  /* ============== Low-level ============== */
+
+  void escaped_string(const char *str, unsigned long length) {
+    const char *end = str + length;
+    const char *run;
+    const char *escape;
+
+    while(str != end) {
+      run = str;
+      while(str != end && !(escape = escape_of(*str))) str++;
+      write(run, str - run);
+
+      if(str != end) {
+        write(escape, 2);
+        str++;
+      }
+    }
+  }
+
+private:
+  bool make_room() {
+    if(!sink.flush() || sink.cur == sink.end) {
+      error = 1;
+      return false;
+    }
+    return true;
+  }
+
+  static unsigned long format_uint(char *out, unsigned long val) {
+    char digits[24];
+    unsigned long length = 0;
+    unsigned long i;
+
+    do {
+      digits[length++] = '0' + (char)(val % 10);
+      val /= 10;
+    } while(val);
+
+    for(i = 0; i < length; i++) out[i] = digits[length - 1 - i];
+    return length;
+  }
+
+  static const char * escape_of(char c) {
+    switch(c) {
+      case '\"': return "\\\"";
+      case '\\': return "\\\\";
+      case '\b': return "\\b";
+      case '\f': return "\\f";
+      case '\n': return "\\n";
+      case '\r': return "\\r";
+      case '\t': return "\\t";
+    }
+    return 0;
+  }
+};
+
+}
+
+#endif
+/*
+  Public Domain (www.unlicense.org)
+  This is free and unencumbered software released into the public domain.
+  Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+  software, either in source code form or as a compiled binary, for any purpose,
+  commercial or non-commercial, and by any means.
+  In jurisdictions that recognize copyright laws, the author or authors of this
+  software dedicate any and all copyright interest in the software to the public
+  domain. We make this dedication for the benefit of the public at large and to
+  the detriment of our heirs and successors. We intend this dedication to be an
+  overt act of relinquishment in perpetuity of all present and future rights to
+  this software under copyright law.
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
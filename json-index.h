@@ -0,0 +1,306 @@
+/*
+  * json-index.h - public domain - sidecar indexes for json-read.h
+
+  * Builds the index files that jsonr_index_open/jsonr_seek_path read: the byte range of every
+    value down to a given depth (keyed by JSON Pointer, so by key and array index), sorted by path.
+    Looking a value up is a binary search over the file, then one seek into the JSON file.
+  * The index remembers the size, the mtime (with JSONINDEX_POSIX) and a hash of the JSON file it
+    was built from. jsoni_open refuses an index that doesn't match anymore. Only the first and last
+    JSONI_HASH_BYTES go into the hash, so checking stays cheap for huge files. Without
+    JSONINDEX_POSIX there's no mtime, so an edit in the middle that keeps the size goes unnoticed.
+  * The entries are collected and sorted in memory while building: allocates with malloc/realloc.
+  * Define JSONINDEX_POSIX to use fstat for the mtime.
+
+  * Usage:
+    1. Define JSONINDEX_IMPL once while including the file to include the implementation. It needs
+       the json-read.h implementation to be included somewhere as well.
+    {
+      #define JSONREAD_IMPL
+      #define JSONINDEX_IMPL
+      #include "json-index.h"
+    }
+
+    2. Use the API.
+    {
+      if(!jsoni_open(&index, json_file, index_file)) {
+        jsoni_build(json_file, index_file, 2);
+        jsoni_open(&index, json_file, index_file);
+      }
+
+      jsonr_init(&j, json_file);
+      if(jsonr_seek_path(&j, &index, "/records/100000/name")) jsonr_v_string(&j, &str, &len);
+    }
+*/
+
+#ifndef JSONINDEX_DEF
+
+/* json-read.h has no include guard, so only pull it in if it wasn't included yet. */
+#ifndef JSONREAD_DEF
+  #include "json-read.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+
+#define JSONINDEX_DEF extern
+
+#ifndef JSONI_HASH_BYTES
+  #define JSONI_HASH_BYTES (1024*64)
+#endif
+
+/* Fill in the source_* fields of 'header' for the JSON file 'f' and rewind it. Returns 0 if the
+ * file can't be read. */
+JSONINDEX_DEF int jsoni_stamp(FILE *f, JSON_Read_Index_Header *header);
+
+/* Index the JSON file 'json' down to 'depth' levels below the document (0 is just the document)
+ * into 'out', which has to be opened for writing in binary mode. Returns 0 if the JSON doesn't
+ * parse, memory runs out or writing fails. */
+JSONINDEX_DEF int jsoni_build(FILE *json, FILE *out, int depth);
+
+/* jsonr_index_open, but also returns 0 if 'f' isn't an index of 'json' as it is now. Without
+ * JSONINDEX_POSIX that's best effort: only the size and the hash of the first and last
+ * JSONI_HASH_BYTES are compared, so an edit in the middle that keeps the size isn't noticed and
+ * jsonr_seek_path would jump to stale offsets. Rebuild the index yourself after such edits. */
+JSONINDEX_DEF int jsoni_open(JSON_Read_Index *index, FILE *json, FILE *f);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JSONINDEX_DEF */
+
+/* ============================================ */
+/* ============== Implementation ============== */
+/* ============================================ */
+
+#ifdef JSONINDEX_IMPL
+#ifndef _JSONINDEX_IMPL_DONE
+#define _JSONINDEX_IMPL_DONE
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef JSONINDEX_POSIX
+  #include <sys/stat.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  const char * path; /* path_offset until the walk is done and 'paths' stops moving. */
+  unsigned long path_offset;
+  unsigned long path_length;
+  unsigned long begin;
+  unsigned long end;
+} _JSON_Index_Entry;
+
+typedef struct {
+  _JSON_Index_Entry * entries;
+  unsigned long count;
+  unsigned long capacity;
+  char * paths;
+  unsigned long paths_used;
+  unsigned long paths_capacity;
+} _JSON_Index_Build;
+
+static unsigned long long _jsoni_hash(unsigned long long h, const char *data, unsigned long length) {
+  unsigned long i;
+
+  for(i = 0; i < length; i++) {
+    h ^= (unsigned char)data[i];
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+/* Hash 'length' bytes of 'f' from 'offset'. */
+static int _jsoni_hash_range(FILE *f, unsigned long offset, unsigned long length, unsigned long long *h) {
+  char buf[1024*4];
+  unsigned long count;
+
+  if(fseek(f, (long)offset, SEEK_SET) != 0) return 0;
+
+  while(length > 0) {
+    count = length < sizeof(buf) ? length : sizeof(buf);
+    if(fread(buf, 1, count, f) != count) return 0;
+    *h = _jsoni_hash(*h, buf, count);
+    length -= count;
+  }
+  return 1;
+}
+
+JSONINDEX_DEF int jsoni_stamp(FILE *f, JSON_Read_Index_Header *header) {
+  unsigned long long h = 14695981039346656037ull;
+  unsigned long size;
+  unsigned long head;
+  long end;
+#ifdef JSONINDEX_POSIX
+  struct stat st;
+#endif
+
+  if(fseek(f, 0, SEEK_END) != 0 || (end = ftell(f)) < 0) return 0;
+  size = (unsigned long)end;
+
+  /* The head, and the tail if it doesn't overlap the head. */
+  head = size < JSONI_HASH_BYTES ? size : JSONI_HASH_BYTES;
+  if(!_jsoni_hash_range(f, 0, head, &h)) return 0;
+  if(size > head) {
+    if(size - head > JSONI_HASH_BYTES) head = size - JSONI_HASH_BYTES;
+    if(!_jsoni_hash_range(f, head, size - head, &h)) return 0;
+  }
+
+  header->source_size = size;
+  header->source_hash = h;
+  header->source_mtime = 0;
+#ifdef JSONINDEX_POSIX
+  if(fstat(fileno(f), &st) != 0) return 0;
+  header->source_mtime = (unsigned long long)st.st_mtime;
+#endif
+
+  rewind(f);
+  return 1;
+}
+
+/* JSON_Read_Index_Hit */
+static int _jsoni_collect(const char *path, unsigned long path_length, unsigned long begin, unsigned long end, void *user) {
+  _JSON_Index_Build *build = (_JSON_Index_Build*)user;
+  _JSON_Index_Entry *entries;
+  unsigned long capacity;
+  char *paths;
+
+  if(build->count == build->capacity) {
+    capacity = build->capacity ? build->capacity * 2 : 1024;
+    entries = (_JSON_Index_Entry*)realloc(build->entries, capacity * sizeof(*entries));
+    if(!entries) return 0;
+    build->entries = entries;
+    build->capacity = capacity;
+  }
+
+  if(build->paths_used + path_length > build->paths_capacity) {
+    capacity = build->paths_capacity ? build->paths_capacity * 2 : 1024*16;
+    if(capacity < build->paths_used + path_length) capacity = build->paths_used + path_length;
+    paths = (char*)realloc(build->paths, capacity);
+    if(!paths) return 0;
+    build->paths = paths;
+    build->paths_capacity = capacity;
+  }
+
+  memcpy(build->paths + build->paths_used, path, path_length);
+  build->entries[build->count].path_offset = build->paths_used;
+  build->entries[build->count].path_length = path_length;
+  build->entries[build->count].begin = begin;
+  build->entries[build->count].end = end;
+  build->paths_used += path_length;
+  build->count += 1;
+  return 1;
+}
+
+/* Same order as jsonr_index_find searches in: bytewise, then shorter first. */
+static int _jsoni_compare(const void *a, const void *b) {
+  const _JSON_Index_Entry *x = (const _JSON_Index_Entry*)a;
+  const _JSON_Index_Entry *y = (const _JSON_Index_Entry*)b;
+  int cmp = memcmp(x->path, y->path, x->path_length < y->path_length ? x->path_length : y->path_length);
+
+  if(cmp) return cmp;
+  return (x->path_length > y->path_length) - (x->path_length < y->path_length);
+}
+
+static int _jsoni_write(_JSON_Index_Build *build, FILE *out, const JSON_Read_Index_Header *header) {
+  JSON_Read_Index_Entry entry;
+  unsigned long long path = 0;
+  unsigned long i;
+
+  if(fwrite(header, sizeof(*header), 1, out) != 1) return 0;
+
+  for(i = 0; i < build->count; i++) {
+    entry.path = path;
+    entry.path_length = build->entries[i].path_length;
+    entry.begin = build->entries[i].begin;
+    entry.end = build->entries[i].end;
+    if(fwrite(&entry, sizeof(entry), 1, out) != 1) return 0;
+    path += entry.path_length;
+  }
+
+  /* The paths in the same order, so a search reads them close together. */
+  for(i = 0; i < build->count; i++) {
+    if(fwrite(build->entries[i].path, 1, build->entries[i].path_length, out) != build->entries[i].path_length) return 0;
+  }
+
+  return fflush(out) == 0;
+}
+
+JSONINDEX_DEF int jsoni_build(FILE *json, FILE *out, int depth) {
+  JSON_Read_Index_Header header;
+  _JSON_Index_Build build;
+  JSON_Read_Data j;
+  unsigned long i;
+  int ok;
+
+  memset(&header, 0, sizeof(header));
+  memset(&build, 0, sizeof(build));
+  if(!jsoni_stamp(json, &header)) return 0;
+
+  jsonr_init(&j, json);
+  ok = jsonr_index_walk(&j, depth, _jsoni_collect, &build);
+
+  if(ok) {
+    for(i = 0; i < build.count; i++) {
+      build.entries[i].path = build.paths + build.entries[i].path_offset;
+    }
+    qsort(build.entries, build.count, sizeof(*build.entries), _jsoni_compare);
+
+    memcpy(header.magic, "JSONRIDX", 8);
+    header.version = 1;
+    header.depth = depth;
+    header.count = build.count;
+    header.paths_offset = sizeof(header) + build.count * sizeof(JSON_Read_Index_Entry);
+    ok = _jsoni_write(&build, out, &header);
+  }
+
+  free(build.entries);
+  free(build.paths);
+  rewind(json);
+  return ok;
+}
+
+JSONINDEX_DEF int jsoni_open(JSON_Read_Index *index, FILE *json, FILE *f) {
+  JSON_Read_Index_Header now;
+
+  if(!jsonr_index_open(index, f) || !jsoni_stamp(json, &now)) return 0;
+
+  return index->header.source_size == now.source_size
+    && index->header.source_mtime == now.source_mtime
+    && index->header.source_hash == now.source_hash;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+#endif
+
+/*
+  Public Domain (www.unlicense.org)
+  This is free and unencumbered software released into the public domain.
+  Anyone is free to copy, modify, publish, use, compile, sell, or distribute this
+  software, either in source code form or as a compiled binary, for any purpose,
+  commercial or non-commercial, and by any means.
+  In jurisdictions that recognize copyright laws, the author or authors of this
+  software dedicate any and all copyright interest in the software to the public
+  domain. We make this dedication for the benefit of the public at large and to
+  the detriment of our heirs and successors. We intend this dedication to be an
+  overt act of relinquishment in perpetuity of all present and future rights to
+  this software under copyright law.
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
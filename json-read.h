@@ -1,10 +1,14 @@
 /*
   * json-read.h - public domain - decode json - Justas Dabrila 2021
  
-  * Just read json data from a file stream.
+  * Just read json data from a file stream, a block of memory or your own source (see
+    jsonr_init_source).
   * Strings are escaped (decoded as ascii. no utf8 decode).
-  * fgetc, ungetc, ftell, fseek, fscanf are used. 
-  * vnsprintf, snprintf is used for error reporting.
+  * Input is consumed in blocks. FILEs are read with fread in JSONR_FILE_BLOCK_SIZE blocks, so
+    the FILE ends up ahead of what was parsed. strtod is used for numbers. ftell/fseek only by the
+    peek API and JSONREAD_LAZY_POSITION.
+  * Errors are recorded as a JSONR_E_* code. The message is only formatted (snprintf) when asked for
+    with jsonr_error_message.
   * No explicit allocations (unless the aformentioned cstdlib funcs decide to allocate.)
   * No formatting or indentation.
 
@@ -22,6 +26,27 @@
 
     3. Use the API.
        See either the 'High-level API', 'Low-level API' sections or example files.
+
+  * Define JSONREAD_STATS to have every JSON_Read_Data count what it spends its time on in
+    j->stats. Dump them with jsonr_stats_write. Compiled out when not defined.
+
+  * Define JSONREAD_LAZY_POSITION to only count the byte offset while parsing. j->line/j->column
+    are then worked out by counting newlines when the error message is built, or when you call
+    jsonr_update_position. The stream has to be seekable for that.
+
+  * Point j->skips at a JSON_Read_Skips to navigate the same document many times: where every
+    table, array and string of at least JSONR_SKIP_MIN_LENGTH bytes ends is recorded as it's read
+    or skipped, and skipping it again (jsonr_v_skip, jsonr_v_skip_fast, jsonr_extract,
+    jsonr_v_array_at) jumps straight past it. The source has to be able to seek for jumps past the
+    current block.
+
+  * Define JSONREAD_POSIX to get jsonr_v_table_parallel and jsonr_v_array_parallel, which read
+    the values of a table or the elements of an array in memory on several threads. They use
+    pthreads.
+
+  * Define JSONREAD_PROFILE to attribute cycles (rdtsc) and bytes to the key paths they were spent
+    under. Point j->profile at a JSON_Read_Profile after jsonr_init and dump it as folded stacks
+    (flamegraph.pl input) with jsonr_profile_write_folded. Compiled out when not defined.
 */
 
 #ifdef __cplusplus
@@ -31,36 +56,368 @@ extern "C" {
 #include <stdio.h>
 #include <stdarg.h>
 
+#ifdef JSONREAD_POSIX
+  #include <pthread.h>
+#endif
+
 #ifndef JSONR_STRINGLEN_READ_BUFFER_SIZE
   #define JSONR_STRINGLEN_READ_BUFFER_SIZE (1024*8)
 #endif
 
+#ifndef JSONR_RECENT_SIZE
+  #define JSONR_RECENT_SIZE 64 /* recent input kept for error messages. Has to be a power of two. */
+#endif
+
+#ifndef JSONR_FILE_BLOCK_SIZE
+  #define JSONR_FILE_BLOCK_SIZE (1024*4)
+#endif
+
+#ifndef JSONR_NUMBER_MAX_LENGTH
+  #define JSONR_NUMBER_MAX_LENGTH 64
+#endif
+
+#ifndef JSONR_THREADS
+  #define JSONR_THREADS 64 /* most threads jsonr_v_table_parallel uses. */
+#endif
+
+#ifndef JSONR_PARALLEL_SECTIONS
+  #define JSONR_PARALLEL_SECTIONS 256 /* keys jsonr_v_table_parallel finds before handing them out. */
+#endif
+
+#ifndef JSONR_PARALLEL_MIN_BYTES
+  #define JSONR_PARALLEL_MIN_BYTES (1024*64) /* smallest split jsonr_v_array_parallel makes. */
+#endif
+
+#ifndef JSONR_ERROR_MESSAGE_SIZE
+  #define JSONR_ERROR_MESSAGE_SIZE 1024 /* longest jsonr_error text. */
+#endif
+
 #ifndef JSONREAD_DEF 
   #define JSONREAD_DEF extern
 #endif
 
+#ifdef JSONREAD_STATS
+typedef struct {
+  unsigned long bytes; /* bytes consumed from the stream. */
+  unsigned long tables;
+  unsigned long arrays;
+  unsigned long strings;
+  unsigned long numbers;
+  unsigned long bools;
+  unsigned long nulls;
+  unsigned long keys; /* keys read from the stream. */
+  unsigned long keys_compared; /* jsonr_k_case calls. */
+  unsigned long keys_matched; /* jsonr_k_case calls that matched. */
+  unsigned long skips; /* jsonr_v_skip calls, not counting the nested values they skip. */
+  unsigned long skipped_bytes;
+  unsigned long jumps; /* skips and jsonr_v_array_at calls that went through j->skips. */
+  unsigned long peeks;
+  unsigned long seeks; /* calls to the source's seek. */
+  unsigned long refills; /* calls to the source's refill. */
+  unsigned long errors;
+} JSON_Read_Stats;
+#endif
+
+#ifdef JSONREAD_PROFILE
+#ifndef JSONR_PROFILE_SLOTS
+  #define JSONR_PROFILE_SLOTS 1024 /* distinct key paths. Has to be a power of two. */
+#endif
+
+#ifndef JSONR_PROFILE_DEPTH
+  #define JSONR_PROFILE_DEPTH 64 /* nested keys tracked. Deeper ones count towards their parent. */
+#endif
+
+#ifndef JSONR_PROFILE_KEY_LENGTH
+  #define JSONR_PROFILE_KEY_LENGTH 32 /* longer keys are truncated and may share a slot. */
+#endif
+
+typedef struct {
+  int used;
+  long parent; /* slot of the enclosing key path, -1 for top level keys. */
+  char key[JSONR_PROFILE_KEY_LENGTH];
+  unsigned long key_length;
+
+  unsigned long hits;
+  unsigned long cycles; /* spent from reading the key to reading the next key at the same level. */
+  unsigned long bytes;
+  unsigned long child_cycles; /* the part of the above spent under nested keys. */
+  unsigned long child_bytes;
+} JSON_Read_Profile_Entry;
+
+/* Aggregated over every JSON_Read_Data pointing at it, so one can cover many files. Zero it with
+ * jsonr_profile_init. */
+typedef struct {
+  JSON_Read_Profile_Entry entries[JSONR_PROFILE_SLOTS];
+  unsigned long dropped; /* key paths that didn't get a slot. */
+} JSON_Read_Profile;
+
+typedef struct {
+  long slot;
+  long depth;
+  unsigned long cycles;
+  unsigned long offset;
+} _JSON_Read_Profile_Frame;
+
+enum {
+  JSONR_PROFILE_CYCLES,
+  JSONR_PROFILE_BYTES,
+};
+#endif
+
+#ifndef JSONR_PROJECTION_NODES
+  #define JSONR_PROJECTION_NODES 128 /* path components over every path in a projection. */
+#endif
+
+#ifndef JSONR_PROJECTION_ACTIVE
+  #define JSONR_PROJECTION_ACTIVE 16 /* paths a value can be on at once, through wildcards. */
+#endif
+
+typedef struct {
+  const char * token; /* points into the path given to jsonr_projection_add. */
+  unsigned long token_length;
+  long index; /* array index, -1 if the token isn't one. */
+  int wildcard; /* "*": any key or array element. */
+  int path; /* id of the path ending here, -1 for none. */
+  int first_child;
+  int next_sibling;
+} _JSON_Read_Projection_Node;
+
+/* A set of JSON Pointers compiled into a trie, see jsonr_project. Node 0 is the root. */
+typedef struct {
+  _JSON_Read_Projection_Node nodes[JSONR_PROJECTION_NODES];
+  int node_count;
+  int path_count;
+  int has_wildcards;
+} JSON_Read_Projection;
+
+typedef struct JSON_Read_Data JSON_Read_Data;
+
+/* Called by jsonr_project with the cursor on the value of path 'path'. Has to consume the value:
+ * read it with a jsonr_v_* function or skip it. Return 0 to stop the walk. When a number, string,
+ * bool or null is on several paths, 'j' is a context over a copy of it instead. */
+typedef int (*JSON_Read_Project_Hit)(JSON_Read_Data *j, int path, void *user);
+
+#ifndef JSONR_FILTER_NODES
+  #define JSONR_FILTER_NODES 64 /* comparisons and and/or/not operators in a filter. */
+#endif
+
+#ifndef JSONR_FILTER_TEXT
+  #define JSONR_FILTER_TEXT 1024 /* paths and string literals of a filter. */
+#endif
+
+typedef struct {
+  int type; /* _JSONR_FILTER_COMPARE/AND/OR/NOT */
+  int a; /* operands of and/or/not. */
+  int b;
+
+  /* _JSONR_FILTER_COMPARE: the value at path 'path' against the literal. */
+  int path;
+  int any; /* the path has a wildcard: true if any of the values on it compares true. */
+  int op;
+  int literal_type; /* JSONR_V_NUMBER/STRING/BOOL/NULL */
+  double number;
+  const char * string;
+  unsigned long string_length;
+} _JSON_Read_Filter_Node;
+
+/* A compiled filter expression, see jsonr_filter_compile. Points into itself, don't copy it. */
+typedef struct {
+  _JSON_Read_Filter_Node nodes[JSONR_FILTER_NODES];
+  int node_count;
+  int root;
+  const char * paths[JSONR_FILTER_NODES]; /* path ids in the projection index this. */
+  int path_count;
+  char text[JSONR_FILTER_TEXT]; /* null terminated copies of the paths and string literals. */
+  unsigned long text_used;
+  unsigned long error_offset; /* where jsonr_filter_compile gave up. */
+  JSON_Read_Projection projection;
+  signed char state[JSONR_FILTER_NODES]; /* comparison results for the current record. */
+} JSON_Read_Filter;
+
+#ifndef JSONR_PREFILTER_NEEDLES
+  #define JSONR_PREFILTER_NEEDLES 8
+#endif
+
+/* Substrings that all have to occur in an NDJSON line for it to be parsed, see
+ * jsonr_prefilter_skip. */
+typedef struct {
+  const char * needles[JSONR_PREFILTER_NEEDLES];
+  unsigned long lengths[JSONR_PREFILTER_NEEDLES];
+  int count;
+} JSON_Read_Prefilter;
+
+enum {
+  JSONR_FILTER_END, /* no more records, or an error. */
+  JSONR_FILTER_REJECT,
+  JSONR_FILTER_MATCH,
+};
+
+#ifndef JSONR_INDEX_PATH_LENGTH
+  #define JSONR_INDEX_PATH_LENGTH 1024 /* longest JSON Pointer in a sidecar index. */
+#endif
+
+/* Called by jsonr_index_walk for every value down to its depth once the value was read. [begin,
+ * end) are its byte offsets, 'path' its JSON Pointer (not null terminated). Children come before
+ * their parents. Return 0 to stop the walk. */
+typedef int (*JSON_Read_Index_Hit)(const char *path, unsigned long path_length, unsigned long begin, unsigned long end, void *user);
+
+/* Sidecar index file: this header, 'count' JSON_Read_Index_Entry sorted by path, then the paths
+ * at 'paths_offset'. Native byte order. See json-index.h for building one. */
+typedef struct {
+  char magic[8]; /* "JSONRIDX" */
+  unsigned long long version;
+  unsigned long long source_size; /* of the JSON file it was built from, for telling it's stale. */
+  unsigned long long source_mtime;
+  unsigned long long source_hash;
+  unsigned long long depth;
+  unsigned long long count;
+  unsigned long long paths_offset;
+} JSON_Read_Index_Header;
+
+typedef struct {
+  unsigned long long path; /* from paths_offset. */
+  unsigned long long path_length;
+  unsigned long long begin; /* byte offsets of the value. */
+  unsigned long long end;
+} JSON_Read_Index_Entry;
+
 typedef struct {
   FILE * f;
+  JSON_Read_Index_Header header;
+} JSON_Read_Index;
+
+#ifndef JSONR_SKIP_DEPTH
+  #define JSONR_SKIP_DEPTH 64 /* nested tables/arrays whose end gets recorded. Deeper ones don't. */
+#endif
+
+#ifndef JSONR_SKIP_MIN_LENGTH
+  #define JSONR_SKIP_MIN_LENGTH 256 /* shorter values are about as quick to scan again as to look up. */
+#endif
+
+#ifndef JSONR_SKIP_STRIDE
+  #define JSONR_SKIP_STRIDE 64 /* the start of every this many'th array element is recorded too. */
+#endif
+
+typedef struct {
+  unsigned long begin; /* offset of the value plus one, 0 for an unused slot. */
+  unsigned long element; /* 0: 'to' is where the value ends. Otherwise where that element starts. */
+  unsigned long to;
+} JSON_Read_Skip;
+
+/* Where the values of one document end, see j->skips. Any number of JSON_Read_Data can use it
+ * one after the other, as long as they read the same bytes. Set up with jsonr_skips_init. */
+typedef struct {
+  JSON_Read_Skip * slots;
+  unsigned long capacity;
+  unsigned long count;
+  unsigned long dropped; /* recordings that didn't fit. */
+} JSON_Read_Skips;
+
+typedef struct {
+  unsigned long begin;
+  long elements; /* elements begun so far, -1 for tables. */
+} _JSON_Read_Skip_Frame;
+
+/* Point j->block at the next block of input and set j->block_length (the memory stays owned by
+ * the source and has to stay valid until the next refill/seek). Return 0 at the end of the input
+ * or on error. */
+typedef int (*JSON_Read_Refill)(JSON_Read_Data *j);
+
+/* Optional. Make the next refill start 'offset' bytes from the start of the input. Return 0 if
+ * that's not possible. Only needed for peeks that go past the current block and for
+ * JSONREAD_LAZY_POSITION. */
+typedef int (*JSON_Read_Seek)(JSON_Read_Data *j, unsigned long offset);
+
+struct JSON_Read_Data {
+  /* The block being parsed. Bytes [block_pos, block_length) are yet to be consumed, 'block_offset'
+   * is where the block starts in the input. */
+  const char * block;
+  unsigned long block_pos;
+  unsigned long block_length;
+  unsigned long block_offset;
+  JSON_Read_Refill refill;
+  JSON_Read_Seek seek;
+  void * user;
+
+  FILE * f; /* jsonr_init only. */
   char c;
   int read;
   int got_comma;
+  unsigned long offset; /* bytes consumed from the stream. */
+  unsigned long value_end; /* offset one past the last value that was read or skipped. */
   unsigned long line;
   unsigned long column;
+#ifdef JSONREAD_LAZY_POSITION
+  unsigned long line_offset; /* the offset line/column are up to date for. */
+#endif
+
+  /* A key read by jsonr_k_is/jsonr_k_case that didn't match yet. Kept around so the next
+   * comparison doesn't have to seek back and read it again. */
+  int key_pending;
+  char * key;
+  unsigned long key_length;
 
   int error; /* if set to 1: we encountered an error. */
-  char * error_msg;
+  int error_code; /* JSONR_E_* */
+  const char * error_where; /* the function that failed. */
+  unsigned long error_offset;
+  int error_expected;
+  int error_got;
+  char * error_msg; /* only set by jsonr_error_message. */
   unsigned long error_msg_length;
-} JSON_Read_Data;
+  /* The text of jsonr_error and the formatted message. Per context, like 'string_buffer'. */
+  char error_custom[JSONR_ERROR_MESSAGE_SIZE];
+  char error_buffer[JSONR_ERROR_MESSAGE_SIZE + 256];
+
+  char recent[JSONR_RECENT_SIZE]; /* the last bytes consumed, indexed by offset. */
+  unsigned long recent_begin; /* 'recent' has nothing from before this offset, i.e after a jump. */
+
+  /* Keys and strings read by jsonr_read_string_fixed_size. Per context so that separate contexts
+   * can be used from separate threads. */
+  char string_buffer[JSONR_STRINGLEN_READ_BUFFER_SIZE];
+
+  /* The tables and arrays being read, so their end can be recorded in 'skips' when they're done.
+   * Nothing is recorded or looked up while 'skips' is 0. */
+  JSON_Read_Skips * skips;
+  int skip_depth;
+  _JSON_Read_Skip_Frame skip_frames[JSONR_SKIP_DEPTH];
+
+#ifdef JSONREAD_STATS
+  JSON_Read_Stats stats;
+#endif
+
+#ifdef JSONREAD_PROFILE
+  JSON_Read_Profile * profile; /* nothing is recorded while 0. */
+  long depth;
+  int frame_count;
+  _JSON_Read_Profile_Frame frames[JSONR_PROFILE_DEPTH];
+#endif
+
+  char file_block[JSONR_FILE_BLOCK_SIZE]; /* jsonr_init only. */
+};
 
 typedef struct {
   int line;
   int column;
+  unsigned long offset;
   char c;
-  long pos;
   int read;
   int got_comma;
+  int key_pending;
+  char * key;
+  unsigned long key_length;
+  int skip_depth;
 } JSON_Read_Peek; 
 
+/* A value that was skipped to be read later, see jsonr_v_defer. */
+typedef struct {
+  int type; /* JSONR_V_*, JSONR_V_INVALID if it couldn't be skipped. */
+  unsigned long begin; /* offset of its first byte. */
+  unsigned long end; /* one past its last byte. */
+  unsigned long line; /* where it begins. Not known with JSONREAD_LAZY_POSITION. */
+  unsigned long column;
+} JSON_Read_Deferred;
+
 enum {
   JSONR_V_INVALID,
   JSONR_V_NUMBER,
@@ -71,14 +428,40 @@ enum {
   JSONR_V_NULL,
 };
 
+enum {
+  JSONR_E_NONE,
+  JSONR_E_CUSTOM, /* reported with jsonr_error. */
+  JSONR_E_UNEXPECTED_CHAR, /* error_expected, error_got */
+  JSONR_E_UNEXPECTED_EOF, /* error_expected */
+  JSONR_E_STRING_EOF,
+  JSONR_E_UNESCAPED_CHAR, /* error_got */
+  JSONR_E_TABLE_ENDED,
+  JSONR_E_ARRAY_ENDED,
+  JSONR_E_EXPECTED_COMMA,
+  JSONR_E_EXPECTED_NUMBER, /* error_got */
+  JSONR_E_NUMBER_TOO_LONG,
+  JSONR_E_MALFORMED_NUMBER,
+  JSONR_E_EXPECTED_BOOL, /* error_got */
+  JSONR_E_INVALID_VALUE, /* error_got */
+  JSONR_E_SEEK,
+};
+
 enum {
   JSONR_READ_STRING_WANTS_MORE_MEMORY,
   JSONR_READ_STRING_DONE,
 };
 
-/* Init a read context. You'll want to call this to use any of the API. */
+/* Init a read context. You'll want to call this (or one of the other jsonr_init_*) to use any
+ * of the API. The FILE is read in JSONR_FILE_BLOCK_SIZE blocks. */
 JSONREAD_DEF void jsonr_init(JSON_Read_Data *j, FILE *f);
 
+/* Init a read context that parses 'length' bytes of memory in place. */
+JSONREAD_DEF void jsonr_init_mem(JSON_Read_Data *j, const char *data, unsigned long length);
+
+/* Init a read context that pulls its input from 'refill', see JSON_Read_Refill. 'seek' may be 0.
+ * 'user' is stored in j->user for the callbacks to use. */
+JSONREAD_DEF void jsonr_init_source(JSON_Read_Data *j, JSON_Read_Refill refill, JSON_Read_Seek seek, void *user);
+
 /* ============================================ */
 /* ============== High-level API ============== */
 /* ============================================ */
@@ -87,7 +470,7 @@ JSONREAD_DEF void jsonr_init(JSON_Read_Data *j, FILE *f);
 #define jsonr_v_table(j) for(jsonr_v_table_begin(j); jsonr_v_table_can_read(j); )
 #define jsonr_v_array(j) for(jsonr_v_array_begin(j); jsonr_v_array_can_read(j); )
 
-/* Parses and escapes a string into a STRINGLEN_READ_BUFFER_SIZE sized buffer. 
+/* Parses and escapes a string into the context's STRINGLEN_READ_BUFFER_SIZE sized buffer.
  * Used by all key reading functions for simplicity. 
  * You'll have to DIY if you need to parse keys of any size. */
 JSONREAD_DEF void jsonr_read_string_fixed_size(JSON_Read_Data *j, char **val, unsigned long *len);
@@ -96,7 +479,9 @@ JSONREAD_DEF void jsonr_read_string_fixed_size(JSON_Read_Data *j, char **val, un
  * returning true */
 JSONREAD_DEF int jsonr_k_case(JSON_Read_Data *j, const char *key);
 
-/* Check if the key under the cursor matches the given string */
+/* Check if the key under the cursor matches the given string. The key is read once and kept until
+ * it's consumed by jsonr_k_case, jsonr_k_eat, jsonr_k or jsonr_kv_skip, so testing a key against
+ * many candidates doesn't re-read it. */
 JSONREAD_DEF int jsonr_k_is_stringlen(JSON_Read_Data *j, const char *wants, unsigned long wants_len);
 /* This will call strlen on the key every call, so watch out speed. */
 JSONREAD_DEF int jsonr_k_is(JSON_Read_Data *j, const char *key);
@@ -111,11 +496,113 @@ JSONREAD_DEF void jsonr_k_eat(JSON_Read_Data *j);
  * and tables will be skipped recursively. */
 JSONREAD_DEF void jsonr_v_skip(JSON_Read_Data *j);
 
+/* Skip the value under the cursor like jsonr_v_skip, but only look at quotes, backslashes and
+ * brackets while doing so. Whole blocks are scanned at a time instead of going through the
+ * character at a time API. The skipped value isn't validated: malformed numbers, literals and
+ * commas inside of it go unnoticed. */
+JSONREAD_DEF void jsonr_v_skip_fast(JSON_Read_Data *j);
+
+/* Move the cursor onto the value at the JSON Pointer (RFC 6901) 'pointer', i.e
+ * "/text_inline/3/origin/x", from the value under the cursor. Keys that aren't on the path and
+ * array elements before the index are skipped with jsonr_v_skip_fast. Returns 1 if it's there,
+ * then read the value with any jsonr_v_* function: nothing past it is read. Returns 0 if it isn't
+ * there or on error, the cursor is left wherever the search stopped. "" is the value itself. */
+JSONREAD_DEF int jsonr_extract(JSON_Read_Data *j, const char *pointer);
+
+JSONREAD_DEF void jsonr_projection_init(JSON_Read_Projection *p);
+
+/* Add the JSON Pointer 'pointer' to the projection as path 'id'. A "*" component matches every
+ * key of a table or element of an array. 'pointer' isn't copied and has to stay around. Returns
+ * 0 if it's malformed, already added, or JSONR_PROJECTION_NODES ran out. */
+JSONREAD_DEF int jsonr_projection_add(JSON_Read_Projection *p, const char *pointer, int id);
+
+/* Walk the value under the cursor once, calling 'hit' for every value that's on one of the
+ * projection's paths. Everything else is skipped with jsonr_v_skip_fast. A value can be on
+ * several paths when a wildcard and a key/index both match it, 'hit' is called for each of them.
+ * A table or array on several paths is read again from where it began, which fails with
+ * JSONR_E_SEEK if the source can't go back there (see jsonr_peek_end). If a path is a prefix of
+ * another, the shorter one gets the value. Without wildcards, the walk stops as soon as every path
+ * was hit, then 0 is returned and the cursor is left in the middle of the value (i.e
+ * jsonr_skip_line to get past an NDJSON record). Returns 1 once the whole value was walked. */
+JSONREAD_DEF int jsonr_project(JSON_Read_Data *j, const JSON_Read_Projection *p, JSON_Read_Project_Hit hit, void *user);
+
+/* Compile a filter over NDJSON records, i.e:
+ *   /status == 500 && (/latency >= 200 || !(/method == "GET"))
+ * Operands are JSON Pointers (up to the next space or operator character, "*" works like it does
+ * for jsonr_projection_add) compared with ==, !=, <, <=, > or >= to a number, a "string" (only
+ * \" and \\ escapes), true, false or null. Comparing different types is false with every
+ * operator (!= too), so is comparing a path that isn't in the record. Combine with &&, || and !, group with ( and ). Returns 0 if the
+ * expression is malformed or too big, f->error_offset says where. */
+JSONREAD_DEF int jsonr_filter_compile(JSON_Read_Filter *f, const char *expr);
+
+/* Evaluate the filter on the NDJSON record under the cursor and move on to the next one. The
+ * record is walked like jsonr_project does, and abandoned with jsonr_skip_line as soon as the
+ * result is known. Returns JSONR_FILTER_MATCH or JSONR_FILTER_REJECT, [*begin, *end) are the
+ * offsets of the record and the whitespace after it. Returns JSONR_FILTER_END at the end of the
+ * input or on error. */
+JSONREAD_DEF int jsonr_filter_record(JSON_Read_Data *j, JSON_Read_Filter *f, unsigned long *begin, unsigned long *end);
+
+/* Move past the next newline without looking at anything before it, dropping whatever was being
+ * read (tables and arrays that were begun). For abandoning NDJSON records. */
+JSONREAD_DEF void jsonr_skip_line(JSON_Read_Data *j);
+
+JSONREAD_DEF void jsonr_prefilter_init(JSON_Read_Prefilter *p);
+
+/* Require 'needle' to occur in the raw bytes of a line, i.e "\"status\": 500" or "timeout". It
+ * isn't copied. Returns 0 if it's empty or JSONR_PREFILTER_NEEDLES ran out. Put the rarest first,
+ * a line is rejected on the first needle that's missing. */
+JSONREAD_DEF int jsonr_prefilter_add(JSON_Read_Prefilter *p, const char *needle);
+
+/* 1 if every needle occurs in line[0..length). Uses SSE2 when it's available. */
+JSONREAD_DEF int jsonr_prefilter_match(const JSON_Read_Prefilter *p, const char *line, unsigned long length);
+
+/* Skip the NDJSON lines under the cursor that don't have every needle in them without parsing
+ * them, stopping at the start of one that does. Lines that cross a block boundary aren't looked at
+ * and are stopped at too, so the parser has to confirm what's there (i.e jsonr_filter_record).
+ * Returns 0 at the end of the input. */
+JSONREAD_DEF int jsonr_prefilter_skip(JSON_Read_Data *j, const JSON_Read_Prefilter *p);
+
+/* Walk the value under the cursor and call 'hit' for it and every value nested in it down to
+ * 'depth' levels (0 is just the value itself). Paths longer than JSONR_INDEX_PATH_LENGTH are
+ * skipped. Returns 0 on error or if 'hit' stopped it. */
+JSONREAD_DEF int jsonr_index_walk(JSON_Read_Data *j, int depth, JSON_Read_Index_Hit hit, void *user);
+
+/* Read the header of a sidecar index. The FILE stays in use by the index. Returns 0 if it isn't
+ * one. This doesn't check whether it's stale, see jsoni_open in json-index.h. */
+JSONREAD_DEF int jsonr_index_open(JSON_Read_Index *index, FILE *f);
+
+/* Binary search the index for 'path'. Returns 0 if it isn't in there. */
+JSONREAD_DEF int jsonr_index_find(const JSON_Read_Index *index, const char *path, unsigned long path_length, JSON_Read_Index_Entry *entry);
+
+/* Move the cursor onto the value at the JSON Pointer 'path', like jsonr_extract does from the start
+ * of the document, but jump straight to the longest part of the path that's in the index and only
+ * search the rest. The source has to be able to seek there. j->line/j->column aren't known after
+ * the jump (except with JSONREAD_LAZY_POSITION). Returns 1 if the value is there. */
+JSONREAD_DEF int jsonr_seek_path(JSON_Read_Data *j, const JSON_Read_Index *index, const char *path);
+
+/* Use 'slots' ('capacity' of them, a power of two) as an empty skip table. Point j->skips at it
+ * after jsonr_init*. Recording stops once it's 3/4 full, a slot per JSONR_SKIP_MIN_LENGTH bytes
+ * of the document is plenty. j->line/j->column aren't kept up to date over jumps (except with
+ * JSONREAD_LAZY_POSITION). */
+JSONREAD_DEF void jsonr_skips_init(JSON_Read_Skips *skips, JSON_Read_Skip *slots, unsigned long capacity);
+
+/* Begin the array under the cursor and move onto element 'index', as if jsonr_v_array_can_read
+ * had just returned 1 for it: read it, then carry on with jsonr_v_array_can_read. The elements
+ * before it are skipped with jsonr_v_skip_fast, starting from the closest one j->skips knows the
+ * start of. Returns 0 if it isn't an array, or if it's shorter (then the array was read to the
+ * end). */
+JSONREAD_DEF int jsonr_v_array_at(JSON_Read_Data *j, long index);
+
 /* Get the type of the value under the cursor */
 JSONREAD_DEF int jsonr_v_get_type(JSON_Read_Data *j);
 
 /* Read & advance functions */
 JSONREAD_DEF double jsonr_v_number(JSON_Read_Data *j);
+
+/* Read a number like jsonr_v_number, but if it's an integer of up to 18 digits, put it in *i
+ * straight from its digits and return 1. Anything else goes through strtod into *d and returns 0
+ * (also on error). */
+JSONREAD_DEF int jsonr_v_number_int(JSON_Read_Data *j, long *i, double *d);
 JSONREAD_DEF int jsonr_v_bool(JSON_Read_Data *j);
 
 /* Read a string value and advance */
@@ -141,14 +628,24 @@ JSONREAD_DEF int jsonr_maybe_read_comma(JSON_Read_Data * j);
 JSONREAD_DEF void jsonr_skip_remaining_string(JSON_Read_Data *j);
 
 /* Report an error. Past this point, every call to jsonr_* becomes a noop until the error flag
-  is reset. */
+  is reset. The message is formatted right away, the error code is JSONR_E_CUSTOM. */
 JSONREAD_DEF void jsonr_error(JSON_Read_Data *j, const char * fmt, ...);
 
+/* Format the message for the error that happened: position, description and the input leading up
+ * to it (from the last JSONR_RECENT_SIZE bytes, the stream isn't touched unless
+ * JSONREAD_LAZY_POSITION needs to count lines). Also stored in j->error_msg/j->error_msg_length.
+ * The message is null terminated. Returns 0 if there was no error. */
+JSONREAD_DEF const char * jsonr_error_message(JSON_Read_Data *j, unsigned long *length);
+
+/* The name of a JSONR_E_* code, i.e "JSONR_E_STRING_EOF". */
+JSONREAD_DEF const char * jsonr_error_name(int code);
+
 /* Begin reading tables/arrays. */
 JSONREAD_DEF int jsonr_v_table_begin(JSON_Read_Data *j);
 JSONREAD_DEF int jsonr_v_array_begin(JSON_Read_Data *j);
 
-/* Check if the current table/array still has values in it. */
+/* Check if the current table/array still has values in it. If the last key of a table was tested
+ * with jsonr_k_is/jsonr_k_case but never consumed, its value is skipped. */
 JSONREAD_DEF int jsonr_v_table_can_read(JSON_Read_Data *j);
 JSONREAD_DEF int jsonr_v_array_can_read(JSON_Read_Data *j);
 
@@ -161,6 +658,76 @@ JSONREAD_DEF JSON_Read_Peek jsonr_peek_begin(JSON_Read_Data *j);
 /* Restore cursor information */
 JSONREAD_DEF void jsonr_peek_end(JSON_Read_Data *j, JSON_Read_Peek peek);
 
+/* Skip the value under the cursor with jsonr_v_skip_fast, but remember where it is so it can be
+ * read later with jsonr_defer_open. */
+JSONREAD_DEF JSON_Read_Deferred jsonr_v_defer(JSON_Read_Data *j);
+
+/* Move the cursor onto a deferred value, then read it with any jsonr_v_* function. 'j' has to read
+ * the same input the value was deferred from: the context it was deferred with (once it's done
+ * with everything else), or another one, i.e jsonr_init_mem over the same memory (one per thread
+ * if you like) or jsonr_init over another FILE of the same file. Only the value itself is read.
+ * Returns 0 if the source can't seek there. */
+JSONREAD_DEF int jsonr_defer_open(JSON_Read_Data *j, JSON_Read_Deferred d);
+
+#ifdef JSONREAD_POSIX
+/* Called by jsonr_v_table_parallel for every key of the table, on any of its threads and in any
+ * order. 'j' is a context of its own with the cursor on the value: read all of it or
+ * jsonr_v_skip it. 'key' is only valid until the next string is read through 'j'. */
+typedef void (*JSON_Read_Section)(JSON_Read_Data *j, const char *key, unsigned long key_length, void *user);
+
+/* Read the table under the cursor like jsonr_v_table, on up to 'thread_count' threads (the calling
+ * one included). Only where each value ends is looked for here (jsonr_v_skip_fast), then the
+ * biggest values are handed out first, each to a jsonr_init_mem context over the same memory.
+ * Anything 'read_section' shares has to be locked by it. The first error in the document is
+ * copied into 'j'. Sources other than jsonr_init_mem are read on the calling thread. The skip
+ * table is only used on the calling thread, and the other contexts' stats/profiles are dropped.
+ * Returns 0 on error. */
+JSONREAD_DEF int jsonr_v_table_parallel(JSON_Read_Data *j, int thread_count, JSON_Read_Section read_section, void *user);
+
+/* Called by jsonr_v_array_parallel for every element of the array, on any of its threads and in
+ * any order. 'j' is a context of its own with the cursor on the element: read all of it or
+ * jsonr_v_skip it. 'thread' is below the thread_count that was asked for, for per thread state. */
+typedef void (*JSON_Read_Element)(JSON_Read_Data *j, int thread, void *user);
+
+/* Read the array under the cursor like jsonr_v_array, on up to 'thread_count' threads (the calling
+ * one included), without finding where its elements are first. The memory after the '[' is
+ * scanned for quotes and brackets in windows split between the threads, twice: as if each split
+ * started outside a string and as if it started in one. Going through the splits in order then
+ * tells which guess was right and how deep each one starts. The windows start at thread_count *
+ * JSONR_PARALLEL_MIN_BYTES and double until the array is seen to end. The array is then split
+ * evenly (at least JSONR_PARALLEL_MIN_BYTES each) and each thread reads from the first element
+ * after its split up to the next thread's first one. That every thread stopped right where the
+ * next one started is checked at the end. If the end of the array isn't found, it's read on the
+ * calling thread instead (so is anything that isn't jsonr_init_mem, or too small to split). The
+ * first error in the document is copied into 'j', but elements after it may have been read by
+ * other threads already. Returns 0 on error. */
+JSONREAD_DEF int jsonr_v_array_parallel(JSON_Read_Data *j, int thread_count, JSON_Read_Element read_element, void *user);
+#endif
+
+/* Bring j->line/j->column up to date. Only needed with JSONREAD_LAZY_POSITION, where they're
+ * otherwise only updated on error. Counts the newlines since the last time it was called (or
+ * since the start of the stream if we went back) so calling it often is cheap. */
+JSONREAD_DEF void jsonr_update_position(JSON_Read_Data *j);
+
+#ifdef JSONREAD_STATS
+struct JSON_Write_Data;
+
+/* Write the counters as a json table value through json-write.h. Only available if json-write.h
+ * is included before the implementation of this file. Doesn't reset them. */
+JSONREAD_DEF void jsonr_stats_write(struct JSON_Write_Data *out, const JSON_Read_Stats *stats);
+#endif
+
+#ifdef JSONREAD_PROFILE
+JSONREAD_DEF void jsonr_profile_init(JSON_Read_Profile *profile);
+
+/* Close the keys that are still open (i.e when you stop reading before the document ends). */
+JSONREAD_DEF void jsonr_profile_end(JSON_Read_Data *j);
+
+/* Write one "key;nested_key;... value" line per key path, where value is the self time in cycles
+ * or the self size in bytes ('what' is JSONR_PROFILE_CYCLES or JSONR_PROFILE_BYTES). */
+JSONREAD_DEF void jsonr_profile_write_folded(const JSON_Read_Profile *profile, FILE *f, int what);
+#endif
+
 /* ============================================ */
 /* ============== Implementation ============== */
 /* ============================================ */
@@ -168,47 +735,172 @@ JSONREAD_DEF void jsonr_peek_end(JSON_Read_Data *j, JSON_Read_Peek peek);
 #ifdef JSONREAD_IMPL 
 
 #include <ctype.h>
+#include <stdlib.h>
 #include <string.h>
 
-#define _jsonr_error_string_eof(when) \
-  jsonr_error(j, "in '%s': malformed string: encountered EOF while reading string.", __func__);
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif
+
+#ifdef JSONREAD_STATS
+  #define _JSONR_STAT(field, n) (j->stats.field += (n))
+#else
+  #define _JSONR_STAT(field, n)
+#endif
+
+#ifdef JSONREAD_PROFILE
+  #if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+    #define _jsonr_cycles() ((unsigned long)__rdtsc())
+  #else
+    #include <time.h>
+    static unsigned long _jsonr_cycles(void) {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+    }
+  #endif
+
+  #define _JSONR_PROFILE_DEPTH(n) (j->depth += (n))
+  #define _JSONR_PROFILE_CLOSE() if(j->profile) _jsonr_profile_close(j, j->depth + 1, _jsonr_cycles(), j->offset)
+#else
+  #define _JSONR_PROFILE_DEPTH(n)
+  #define _JSONR_PROFILE_CLOSE()
+#endif
+
+#define _jsonr_error_string_eof() \
+  _jsonr_fail(j, JSONR_E_STRING_EOF, __func__, 0, 0);
 
 #define _jsonr_error_unescaped_char(c) \
-  jsonr_error(j, "in '%s': malformed string: encountered unescaped character (codepoint %d) while reading string.", __func__, (int)c);
+  _jsonr_fail(j, JSONR_E_UNESCAPED_CHAR, __func__, 0, c);
 
-#define _jsonr_error_unexpected_str(expected, got) \
-  jsonr_error(j, "in '%s': expected character '%s', got '%s'.", __func__, expected, got);
+#define _jsonr_error_unexpected_eof(expected) \
+  _jsonr_fail(j, JSONR_E_UNEXPECTED_EOF, __func__, expected, EOF);
 
 #define _jsonr_error_unexpected_char(expected, got) \
-  jsonr_error(j, "in '%s': expected character '%c', got '%c'.", __func__, expected, got);
+  _jsonr_fail(j, JSONR_E_UNEXPECTED_CHAR, __func__, expected, got);
+
+/* Only records what went wrong, so rejecting bad input stays cheap. jsonr_error_message does the
+ * formatting. */
+static void _jsonr_fail(JSON_Read_Data *j, int code, const char *where, int expected, int got) {
+  if(j->error) return;
+
+  _JSONR_STAT(errors, 1);
+  j->error = 1;
+  j->error_code = code;
+  j->error_where = where;
+  j->error_offset = j->offset;
+  j->error_expected = expected;
+  j->error_got = got;
+  j->error_msg = 0;
+  j->error_msg_length = 0;
+}
 
 JSONREAD_DEF void jsonr_error(JSON_Read_Data *j, const char *fmt, ...) {
-  static const int BUF_SIZE = 1024*16;
-  static char buf[BUF_SIZE];
-  char * cursor = buf;
-  long saved_pos;
-  int i;
-  char c;
   va_list args;
-  int result;
+
+  if(j->error) return;
+
+  va_start(args, fmt);
+  vsnprintf(j->error_custom, sizeof(j->error_custom), fmt, args);
+  va_end(args);
+
+  _jsonr_fail(j, JSONR_E_CUSTOM, 0, 0, 0);
+}
+
+JSONREAD_DEF const char * jsonr_error_name(int code) {
+  switch(code) {
+    case JSONR_E_NONE: return "JSONR_E_NONE";
+    case JSONR_E_CUSTOM: return "JSONR_E_CUSTOM";
+    case JSONR_E_UNEXPECTED_CHAR: return "JSONR_E_UNEXPECTED_CHAR";
+    case JSONR_E_UNEXPECTED_EOF: return "JSONR_E_UNEXPECTED_EOF";
+    case JSONR_E_STRING_EOF: return "JSONR_E_STRING_EOF";
+    case JSONR_E_UNESCAPED_CHAR: return "JSONR_E_UNESCAPED_CHAR";
+    case JSONR_E_TABLE_ENDED: return "JSONR_E_TABLE_ENDED";
+    case JSONR_E_ARRAY_ENDED: return "JSONR_E_ARRAY_ENDED";
+    case JSONR_E_EXPECTED_COMMA: return "JSONR_E_EXPECTED_COMMA";
+    case JSONR_E_EXPECTED_NUMBER: return "JSONR_E_EXPECTED_NUMBER";
+    case JSONR_E_NUMBER_TOO_LONG: return "JSONR_E_NUMBER_TOO_LONG";
+    case JSONR_E_MALFORMED_NUMBER: return "JSONR_E_MALFORMED_NUMBER";
+    case JSONR_E_EXPECTED_BOOL: return "JSONR_E_EXPECTED_BOOL";
+    case JSONR_E_INVALID_VALUE: return "JSONR_E_INVALID_VALUE";
+    case JSONR_E_SEEK: return "JSONR_E_SEEK";
+  }
+  return "JSONR_E_UNKNOWN";
+}
+
+/* 'c' for messages: the character in quotes or EOF. */
+static const char * _jsonr_char_str(int c, char *buf) {
+  if(c == EOF) return "EOF";
+  buf[0] = '\'';
+  buf[1] = (char)c;
+  buf[2] = '\'';
+  buf[3] = 0;
+  return buf;
+}
+
+JSONREAD_DEF const char * jsonr_error_message(JSON_Read_Data *j, unsigned long *length) {
+  char * buf = j->error_buffer;
+  char * cursor = buf;
+  char got[4];
+  unsigned long back;
+  unsigned long i;
+  int result = 0;
   int spaces;
-  int chars_back = 40;
-  int chars_forward = 40;
-  int move_result;
 
-  if(j->error) {
-    return;
+  if(!j->error) {
+    if(length) *length = 0;
+    return 0;
+  }
+  if(j->error_msg) {
+    if(length) *length = j->error_msg_length;
+    return j->error_msg;
   }
 
-#define CHECK_RESULT { if(result < 0) { j->error_msg = 0; j->error_msg_length = 0; return; } }
-#define REMAINING_BYTES (BUF_SIZE-(cursor-buf))
+  jsonr_update_position(j);
+
+#define CHECK_RESULT { if(result < 0 || result >= REMAINING_BYTES) { if(length) *length = 0; return 0; } }
+#define REMAINING_BYTES ((long)sizeof(j->error_buffer)-(cursor-buf))
 
   result = snprintf(cursor,REMAINING_BYTES,"%lu:%lu: error: ", j->line, j->column);
   CHECK_RESULT;
   cursor += result;
 
-  va_start(args, fmt);
-  result = vsnprintf(cursor,REMAINING_BYTES, fmt, args);
+  if(j->error_where) {
+    result = snprintf(cursor,REMAINING_BYTES,"in '%s': ", j->error_where);
+    CHECK_RESULT;
+    cursor += result;
+  }
+
+  switch(j->error_code) {
+    case JSONR_E_CUSTOM:
+      result = snprintf(cursor,REMAINING_BYTES,"%s", j->error_custom); break;
+    case JSONR_E_UNEXPECTED_CHAR:
+    case JSONR_E_UNEXPECTED_EOF:
+      result = snprintf(cursor,REMAINING_BYTES,"expected character '%c', got %s.", j->error_expected, _jsonr_char_str(j->error_got, got)); break;
+    case JSONR_E_STRING_EOF:
+      result = snprintf(cursor,REMAINING_BYTES,"malformed string: encountered EOF while reading string."); break;
+    case JSONR_E_UNESCAPED_CHAR:
+      result = snprintf(cursor,REMAINING_BYTES,"malformed string: encountered unescaped character (codepoint %d) while reading string.", j->error_got); break;
+    case JSONR_E_TABLE_ENDED:
+      result = snprintf(cursor,REMAINING_BYTES,"expected another key in table, but the table ended."); break;
+    case JSONR_E_ARRAY_ENDED:
+      result = snprintf(cursor,REMAINING_BYTES,"expected another value in array, but the array ended."); break;
+    case JSONR_E_EXPECTED_COMMA:
+      result = snprintf(cursor,REMAINING_BYTES,"expected comma."); break;
+    case JSONR_E_EXPECTED_NUMBER:
+      result = snprintf(cursor,REMAINING_BYTES,"expected a number, got %s.", _jsonr_char_str(j->error_got, got)); break;
+    case JSONR_E_NUMBER_TOO_LONG:
+      result = snprintf(cursor,REMAINING_BYTES,"number is longer than %d characters.", JSONR_NUMBER_MAX_LENGTH); break;
+    case JSONR_E_MALFORMED_NUMBER:
+      result = snprintf(cursor,REMAINING_BYTES,"malformed number."); break;
+    case JSONR_E_EXPECTED_BOOL:
+      result = snprintf(cursor,REMAINING_BYTES,"expected a bool, got %s.", _jsonr_char_str(j->error_got, got)); break;
+    case JSONR_E_INVALID_VALUE:
+      result = snprintf(cursor,REMAINING_BYTES,"expected a value, got %s.", _jsonr_char_str(j->error_got, got)); break;
+    case JSONR_E_SEEK:
+      result = snprintf(cursor,REMAINING_BYTES,"the source can't seek back."); break;
+  }
   CHECK_RESULT;
   cursor += result;
 
@@ -217,50 +909,95 @@ JSONREAD_DEF void jsonr_error(JSON_Read_Data *j, const char *fmt, ...) {
   spaces = result-1;
   cursor += result;
 
-  saved_pos = ftell(j->f);
-
-  for(i=0;i<chars_back;i++) {
-    move_result = fseek(j->f, -1, SEEK_CUR);
-    if(move_result != 0) break;
-
-    c = fgetc(j->f);
-
-    if(c==EOF||c=='\r'||c =='\n') {
-      break;
-    }
+  /* Up to 40 bytes leading up to the error, back to the start of the line. */
+  back = j->error_offset > j->recent_begin ? j->error_offset - j->recent_begin : 0;
+  if(back > 40) back = 40;
+  if(back > JSONR_RECENT_SIZE) back = JSONR_RECENT_SIZE;
+  for(i = 0; i < back; i++) {
+    char c = j->recent[(j->error_offset - 1 - i) & (JSONR_RECENT_SIZE-1)];
+    if(c == '\r' || c == '\n') break;
+  }
+  back = i;
 
-    fseek(j->f, -1, SEEK_CUR);
+  if(REMAINING_BYTES < (long)(back + spaces + 3)) {
+    if(length) *length = 0;
+    return 0;
   }
-  chars_back = i;
 
-  for(i=0;i<chars_back+chars_forward;i++) {
-    c = fgetc(j->f);
-    if(c==EOF||c=='\r'||c =='\n') break;
-    *cursor = c; cursor += 1;
+  for(i = back; i > 0; i--) {
+    *cursor = j->recent[(j->error_offset - i) & (JSONR_RECENT_SIZE-1)]; cursor += 1;
   }
   *cursor = '\n'; cursor += 1;
 
-  for(i=0;i<spaces+chars_back-1;i++) {
+  for(i = 1; i < spaces + back; i++) {
     *cursor = ' '; cursor += 1;
   }
   *cursor = '^'; cursor += 1;
-
-  fseek(j->f, saved_pos, SEEK_SET);
-
-  j->error = 1;
+  *cursor = 0;
 
   j->error_msg = buf;
   j->error_msg_length = cursor - buf;
 
+  if(length) *length = j->error_msg_length;
+  return j->error_msg;
+
 #undef REMAINING_BYTES
 #undef CHECK_RESULT
 }
 
+/* Moves to the next block. The source is only ever called from here and _jsonr_seek. */
+static int _jsonr_refill(JSON_Read_Data *j) {
+  /* jsonr_init_mem: the one block is all there is. Keep it so peeks can still go back. */
+  if(!j->refill) return 0;
+
+  j->block_offset += j->block_length;
+  j->block_pos = 0;
+  j->block_length = 0;
+
+  _JSONR_STAT(refills, 1);
+  if(!j->refill(j)) {
+    j->block_length = 0;
+    return 0;
+  }
+  return j->block_length > 0;
+}
+
+/* Make 'offset' the next byte to be consumed. Doesn't call the source if it's in the current
+ * block. */
+static int _jsonr_seek(JSON_Read_Data *j, unsigned long offset) {
+  if(offset >= j->block_offset && offset <= j->block_offset + j->block_length) {
+    j->block_pos = offset - j->block_offset;
+    return 1;
+  }
+
+  _JSONR_STAT(seeks, 1);
+  if(!j->seek || !j->seek(j, offset)) return 0;
+
+  /* Empty block at 'offset', the next byte comes from a refill. */
+  j->block_offset = offset;
+  j->block_pos = 0;
+  j->block_length = 0;
+  return 1;
+}
+
 static void _ensure_char(JSON_Read_Data * j) {
+  int c;
+
   if(j->read) {
     j->read = 0;
-    j->c = fgetc(j->f);
+    if(j->block_pos < j->block_length || _jsonr_refill(j)) {
+      c = (unsigned char)j->block[j->block_pos];
+      j->block_pos += 1;
+    }
+    else {
+      c = EOF;
+    }
+    j->c = c;
+    j->recent[j->offset & (JSONR_RECENT_SIZE-1)] = c;
+    j->offset += c != EOF;
+    _JSONR_STAT(bytes, c != EOF);
 
+#ifndef JSONREAD_LAZY_POSITION
     if(j->c == '\n') {
       j->line++;
       j->column = 0;
@@ -268,7 +1005,56 @@ static void _ensure_char(JSON_Read_Data * j) {
     else {
       j->column++;
     }
+#endif
+  }
+}
+
+JSONREAD_DEF void jsonr_update_position(JSON_Read_Data *j) {
+#ifdef JSONREAD_LAZY_POSITION
+  unsigned long target = j->offset;
+  unsigned long count;
+  const char *cursor;
+  const char *end;
+  const char *newline;
+
+  if(target == j->line_offset) return;
+
+  if(target < j->line_offset) {
+    j->line = 1;
+    j->column = 0;
+    j->line_offset = 0;
+  }
+
+  /* Go back to where we counted up to and count the newlines from there, block by block. That
+   * leaves the source at 'target', just like it was. */
+  if(!_jsonr_seek(j, j->line_offset)) {
+    _jsonr_seek(j, target);
+    return;
+  }
+
+  while(j->line_offset < target) {
+    if(j->block_pos == j->block_length && !_jsonr_refill(j)) break;
+
+    count = j->block_length - j->block_pos;
+    if(count > target - j->line_offset) count = target - j->line_offset;
+
+    cursor = j->block + j->block_pos;
+    end = cursor + count;
+    while((newline = (const char*)memchr(cursor, '\n', end - cursor))) {
+      j->line += 1;
+      j->column = 0;
+      cursor = newline + 1;
+    }
+    j->column += end - cursor;
+
+    j->block_pos += count;
+    j->line_offset += count;
   }
+
+  if(j->line_offset != target) _jsonr_seek(j, target);
+#else
+  (void)j;
+#endif
 }
 
 static void _advance(JSON_Read_Data * j) {
@@ -319,6 +1105,9 @@ static int _is_unescaped_char(char c) {
 }
 
 JSONREAD_DEF int jsonr_maybe_read_comma(JSON_Read_Data * j) {
+  /* Called right after every value, so this is where it ended. A character that was looked at
+   * but not read (i.e after a number) doesn't count. */
+  j->value_end = j->offset - (!j->read && j->c != EOF);
   _skip_whitespace(j);
 
   if(j->c == ',') {
@@ -329,80 +1118,416 @@ JSONREAD_DEF int jsonr_maybe_read_comma(JSON_Read_Data * j) {
   return 0;
 }
 
-JSONREAD_DEF JSON_Read_Peek jsonr_peek_begin(JSON_Read_Data *j) {
-  JSON_Read_Peek peek;
-  peek.c = j->c;
-  peek.got_comma = j->got_comma;
-  peek.line = j->line;
-  peek.column = j->column;
-  peek.pos = ftell(j->f);
-  peek.read = j->read;
-  if(peek.pos == -1) {
-    jsonr_error(j, "in '%s': ftell failed.", __func__);
-  }
+/* Carry on parsing from 'offset' as if everything before it was consumed. */
+static int _jsonr_jump(JSON_Read_Data *j, unsigned long offset) {
+  if(!_jsonr_seek(j, offset)) return 0;
 
-  return peek;
+  j->offset = offset;
+  j->recent_begin = offset;
+  j->read = 1;
+  return 1;
 }
 
-JSONREAD_DEF void jsonr_peek_end(JSON_Read_Data *j, JSON_Read_Peek peek) {
-  j->c = peek.c;
-  j->line = peek.line;
-  j->column = peek.column;
-  j->read = peek.read;
-  j->got_comma = peek.got_comma;
+#define _JSONR_SKIP_NONE (~0ul)
 
-  if(fseek(j->f, peek.pos, SEEK_SET) != 0) {
-    jsonr_error(j, "in '%s': fseek failed", __func__);
+/* The slot holding (begin, element), or the empty one it would go into. */
+static JSON_Read_Skip * _jsonr_skip_slot(JSON_Read_Skips *s, unsigned long begin, unsigned long element) {
+  unsigned long long hash = (begin + element * 0x9e3779b97f4a7c15ull) * 0xff51afd7ed558ccdull;
+  unsigned long i;
+  JSON_Read_Skip *slot;
+
+  for(i = (unsigned long)(hash ^ (hash >> 29)); ; i++) {
+    slot = &s->slots[i & (s->capacity - 1)];
+    if(slot->begin == 0 || (slot->begin == begin + 1 && slot->element == element)) return slot;
   }
 }
 
-JSONREAD_DEF void jsonr_init(JSON_Read_Data *j, FILE *f) {
-  j->f = f;
-  j->c = 0;
-  j->error = 0;
-  j->read = 1;
-  j->line = 1;
-  j->column = 0;
+static void _jsonr_skip_put(JSON_Read_Skips *s, unsigned long begin, unsigned long element, unsigned long to) {
+  JSON_Read_Skip *slot;
+
+  /* Keep a quarter empty so probing stays short and always ends. */
+  if(s->count * 4 >= s->capacity * 3) {
+    s->dropped += 1;
+    return;
+  }
+
+  slot = _jsonr_skip_slot(s, begin, element);
+  if(slot->begin == 0) {
+    slot->begin = begin + 1;
+    slot->element = element;
+    s->count += 1;
+  }
+  slot->to = to;
 }
 
-JSONREAD_DEF int jsonr_v_table_begin(JSON_Read_Data *j) {
-  if(j->error) return 0;
+static int _jsonr_skip_get(JSON_Read_Skips *s, unsigned long begin, unsigned long element, unsigned long *to) {
+  JSON_Read_Skip *slot;
 
-  _skip_whitespace(j);
+  if(s->count == 0) return 0;
 
-  if(j->c == '{') {
-    j->got_comma = 1;
-    _advance(j);
-    return 1;
+  slot = _jsonr_skip_slot(s, begin, element);
+  *to = slot->to;
+  return slot->begin != 0;
+}
+
+static void _jsonr_skip_record(JSON_Read_Data *j, unsigned long begin, unsigned long end) {
+  if(end - begin >= JSONR_SKIP_MIN_LENGTH) _jsonr_skip_put(j->skips, begin, 0, end);
+}
+
+/* The cursor moved somewhere the open tables and arrays can't be followed to. Forget where the
+ * ones up to 'depth' began so nothing wrong gets recorded when they seem to end. */
+static void _jsonr_skip_restart(JSON_Read_Data *j, int depth) {
+  int i;
+
+  j->skip_depth = depth;
+  for(i = 0; i < depth && i < JSONR_SKIP_DEPTH; i++) {
+    j->skip_frames[i].begin = _JSONR_SKIP_NONE;
   }
-  else if(j->c == EOF) {
-    _jsonr_error_unexpected_str("{", "EOF");
-    return 0;
+}
+
+/* A table or array was begun, j->c is its bracket. */
+static void _jsonr_skip_open(JSON_Read_Data *j, long elements) {
+  if(j->skip_depth < JSONR_SKIP_DEPTH) {
+    j->skip_frames[j->skip_depth].begin = j->offset - 1;
+    j->skip_frames[j->skip_depth].elements = elements;
   }
+  j->skip_depth += 1;
+}
 
-  return 0;
+/* The innermost table or array ended at j->value_end. */
+static void _jsonr_skip_close(JSON_Read_Data *j, int array) {
+  _JSON_Read_Skip_Frame *frame;
+
+  if(j->skip_depth == 0) return;
+  j->skip_depth -= 1;
+  if(j->skip_depth >= JSONR_SKIP_DEPTH) return;
+
+  frame = &j->skip_frames[j->skip_depth];
+  if(frame->begin != _JSONR_SKIP_NONE && (frame->elements >= 0) == array) {
+    _jsonr_skip_record(j, frame->begin, j->value_end);
+  }
 }
 
-JSONREAD_DEF int jsonr_v_table_can_read(JSON_Read_Data *j) {
-  if(j->error) return 0;
+/* The innermost array is on its next element, j->c is the first character of it. */
+static void _jsonr_skip_element(JSON_Read_Data *j) {
+  _JSON_Read_Skip_Frame *frame;
 
-  _skip_whitespace(j);
+  if(j->skip_depth == 0 || j->skip_depth > JSONR_SKIP_DEPTH) return;
 
-  if(j->c == '}') {
-    if(j->got_comma) {
+  frame = &j->skip_frames[j->skip_depth - 1];
+  if(frame->begin == _JSONR_SKIP_NONE || frame->elements < 0) return;
+
+  if(frame->elements > 0 && frame->elements % JSONR_SKIP_STRIDE == 0) {
+    _jsonr_skip_put(j->skips, frame->begin, frame->elements, j->offset - 1);
+  }
+  frame->elements += 1;
+}
+
+/* Jump over the value under the cursor if j->skips knows where it ends. Otherwise returns 0 with
+ * *begin set to where it starts (_JSONR_SKIP_NONE if it's not worth recording), so it can be
+ * recorded once it's been skipped. */
+static int _jsonr_skip_jump(JSON_Read_Data *j, unsigned long *begin) {
+  unsigned long end;
+  int type;
+
+  *begin = _JSONR_SKIP_NONE;
+
+  type = jsonr_v_get_type(j);
+  if(j->error || (type != JSONR_V_TABLE && type != JSONR_V_ARRAY && type != JSONR_V_STRING)) return 0;
+
+  *begin = j->offset - 1;
+  if(!_jsonr_skip_get(j->skips, *begin, 0, &end)) return 0;
+
+  /* Without a seek, a value that ends past the current block has to be scanned after all. */
+  if(!j->seek && end > j->block_offset + j->block_length) return 0;
+
+  if(!_jsonr_jump(j, end)) {
+    _jsonr_fail(j, JSONR_E_SEEK, __func__, 0, 0);
+    return 1;
+  }
+
+  _JSONR_STAT(skips, 1);
+  _JSONR_STAT(jumps, 1);
+  jsonr_maybe_read_comma(j);
+  return 1;
+}
+
+JSONREAD_DEF void jsonr_skips_init(JSON_Read_Skips *skips, JSON_Read_Skip *slots, unsigned long capacity) {
+  memset(slots, 0, capacity * sizeof(*slots));
+  skips->slots = slots;
+  skips->capacity = capacity;
+  skips->count = 0;
+  skips->dropped = 0;
+}
+
+JSONREAD_DEF JSON_Read_Peek jsonr_peek_begin(JSON_Read_Data *j) {
+  JSON_Read_Peek peek;
+  _JSONR_STAT(peeks, 1);
+  peek.c = j->c;
+  peek.got_comma = j->got_comma;
+  peek.line = j->line;
+  peek.column = j->column;
+  peek.offset = j->offset;
+  peek.read = j->read;
+  peek.key_pending = j->key_pending;
+  peek.key = j->key;
+  peek.key_length = j->key_length;
+  peek.skip_depth = j->skip_depth;
+
+  return peek;
+}
+
+JSONREAD_DEF void jsonr_peek_end(JSON_Read_Data *j, JSON_Read_Peek peek) {
+  j->c = peek.c;
+  j->line = peek.line;
+  j->column = peek.column;
+  j->offset = peek.offset;
+  j->read = peek.read;
+  j->got_comma = peek.got_comma;
+  j->key_pending = peek.key_pending;
+  j->key = peek.key;
+  j->key_length = peek.key_length;
+  _jsonr_skip_restart(j, peek.skip_depth);
+
+  if(!_jsonr_seek(j, peek.offset)) {
+    _jsonr_fail(j, JSONR_E_SEEK, __func__, 0, 0);
+  }
+}
+
+#ifdef JSONREAD_PROFILE
+/* Close the frames of the keys read at 'depth' or deeper at the given time and stream offset. */
+static void _jsonr_profile_close(JSON_Read_Data *j, long depth, unsigned long now, unsigned long offset) {
+  JSON_Read_Profile_Entry *entry;
+  _JSON_Read_Profile_Frame *frame;
+  _JSON_Read_Profile_Frame *parent;
+  unsigned long cycles;
+  unsigned long bytes;
+
+  while(j->frame_count > 0 && j->frames[j->frame_count-1].depth >= depth) {
+    j->frame_count -= 1;
+    frame = &j->frames[j->frame_count];
+    parent = j->frame_count > 0 ? &j->frames[j->frame_count-1] : 0;
+
+    cycles = now - frame->cycles;
+    bytes = offset - frame->offset;
+
+    if(frame->slot >= 0) {
+      entry = &j->profile->entries[frame->slot];
+      entry->hits += 1;
+      entry->cycles += cycles;
+      entry->bytes += bytes;
+    }
+    if(parent && parent->slot >= 0) {
+      entry = &j->profile->entries[parent->slot];
+      entry->child_cycles += cycles;
+      entry->child_bytes += bytes;
+    }
+  }
+}
+
+static long _jsonr_profile_slot(JSON_Read_Profile *profile, long parent, const char *key, unsigned long length) {
+  JSON_Read_Profile_Entry *entry;
+  unsigned long long hash = 14695981039346656037ull ^ (unsigned long long)parent;
+  unsigned long i;
+  long slot;
+
+  if(length > JSONR_PROFILE_KEY_LENGTH) length = JSONR_PROFILE_KEY_LENGTH;
+
+  for(i = 0; i < length; i++) {
+    hash = (hash ^ (unsigned char)key[i]) * 1099511628211ull;
+  }
+
+  for(i = 0; i < JSONR_PROFILE_SLOTS; i++) {
+    slot = (hash + i) & (JSONR_PROFILE_SLOTS - 1);
+    entry = &profile->entries[slot];
+
+    if(!entry->used) {
+      entry->used = 1;
+      entry->parent = parent;
+      entry->key_length = length;
+      memcpy(entry->key, key, length);
+      return slot;
+    }
+    if(entry->parent == parent && _str_are_equal(entry->key, entry->key_length, key, length)) {
+      return slot;
+    }
+  }
+
+  profile->dropped += 1;
+  return -1;
+}
+
+/* A key that began at 'offset'/'cycles' was read: it ends the previous key at this level and starts
+ * its own frame. */
+static void _jsonr_profile_key(JSON_Read_Data *j, const char *key, unsigned long length, unsigned long offset, unsigned long cycles) {
+  _JSON_Read_Profile_Frame *frame;
+  long parent;
+
+  _jsonr_profile_close(j, j->depth, cycles, offset);
+  if(j->frame_count == JSONR_PROFILE_DEPTH) return;
+
+  parent = j->frame_count > 0 ? j->frames[j->frame_count-1].slot : -1;
+
+  frame = &j->frames[j->frame_count];
+  frame->slot = (j->frame_count > 0 && parent < 0) ? -1 : _jsonr_profile_slot(j->profile, parent, key, length);
+  frame->depth = j->depth;
+  frame->offset = offset;
+  frame->cycles = cycles;
+  j->frame_count += 1;
+}
+
+JSONREAD_DEF void jsonr_profile_init(JSON_Read_Profile *profile) {
+  memset(profile, 0, sizeof(*profile));
+}
+
+JSONREAD_DEF void jsonr_profile_end(JSON_Read_Data *j) {
+  if(j->profile) _jsonr_profile_close(j, 0, _jsonr_cycles(), j->offset);
+}
+
+JSONREAD_DEF void jsonr_profile_write_folded(const JSON_Read_Profile *profile, FILE *f, int what) {
+  const JSON_Read_Profile_Entry *entry;
+  long path[JSONR_PROFILE_DEPTH];
+  int path_length;
+  unsigned long value;
+  long slot;
+  long i;
+
+  for(slot = 0; slot < JSONR_PROFILE_SLOTS; slot++) {
+    entry = &profile->entries[slot];
+    if(!entry->used || entry->hits == 0) continue;
+
+    if(what == JSONR_PROFILE_BYTES) value = entry->bytes - entry->child_bytes;
+    else value = entry->cycles - entry->child_cycles;
+
+    path_length = 0;
+    for(i = slot; i >= 0 && path_length < JSONR_PROFILE_DEPTH; i = profile->entries[i].parent) {
+      path[path_length] = i;
+      path_length += 1;
+    }
+
+    for(i = path_length - 1; i >= 0; i--) {
+      fprintf(f, "%.*s%s", (int)profile->entries[path[i]].key_length, profile->entries[path[i]].key, i > 0 ? ";" : "");
+    }
+    fprintf(f, " %lu\n", value);
+  }
+}
+#endif
+
+static int _jsonr_file_refill(JSON_Read_Data *j) {
+  j->block = j->file_block;
+  j->block_length = fread(j->file_block, 1, JSONR_FILE_BLOCK_SIZE, j->f);
+  return j->block_length > 0;
+}
+
+static int _jsonr_file_seek(JSON_Read_Data *j, unsigned long offset) {
+  /* The FILE is right behind the current block. */
+  long start = ftell(j->f);
+  if(start == -1) return 0;
+
+  start -= (long)(j->block_offset + j->block_length);
+  return fseek(j->f, start + (long)offset, SEEK_SET) == 0;
+}
+
+JSONREAD_DEF void jsonr_init(JSON_Read_Data *j, FILE *f) {
+  jsonr_init_source(j, _jsonr_file_refill, _jsonr_file_seek, 0);
+  j->f = f;
+}
+
+JSONREAD_DEF void jsonr_init_mem(JSON_Read_Data *j, const char *data, unsigned long length) {
+  jsonr_init_source(j, 0, 0, 0);
+  j->block = data;
+  j->block_length = length;
+}
+
+JSONREAD_DEF void jsonr_init_source(JSON_Read_Data *j, JSON_Read_Refill refill, JSON_Read_Seek seek, void *user) {
+  j->block = 0;
+  j->block_pos = 0;
+  j->block_length = 0;
+  j->block_offset = 0;
+  j->refill = refill;
+  j->seek = seek;
+  j->user = user;
+  j->f = 0;
+  j->c = 0;
+  j->error = 0;
+  j->error_code = JSONR_E_NONE;
+  j->error_where = 0;
+  j->error_offset = 0;
+  j->error_msg = 0;
+  j->error_msg_length = 0;
+  j->read = 1;
+  j->offset = 0;
+  j->value_end = 0;
+  j->recent_begin = 0;
+  j->line = 1;
+  j->column = 0;
+#ifdef JSONREAD_LAZY_POSITION
+  j->line_offset = 0;
+#endif
+  j->key_pending = 0;
+  j->key = 0;
+  j->key_length = 0;
+  j->skips = 0;
+  j->skip_depth = 0;
+#ifdef JSONREAD_STATS
+  memset(&j->stats, 0, sizeof(j->stats));
+#endif
+#ifdef JSONREAD_PROFILE
+  j->profile = 0;
+  j->depth = 0;
+  j->frame_count = 0;
+#endif
+}
+
+JSONREAD_DEF int jsonr_v_table_begin(JSON_Read_Data *j) {
+  if(j->error) return 0;
+
+  _skip_whitespace(j);
+
+  if(j->c == '{') {
+    _JSONR_STAT(tables, 1);
+    _JSONR_PROFILE_DEPTH(1);
+    if(j->skips) _jsonr_skip_open(j, -1);
+    j->got_comma = 1;
+    _advance(j);
+    return 1;
+  }
+  else if(j->c == EOF) {
+    _jsonr_error_unexpected_eof('{');
+    return 0;
+  }
+
+  return 0;
+}
+
+JSONREAD_DEF int jsonr_v_table_can_read(JSON_Read_Data *j) {
+  if(j->error) return 0;
+
+  if(j->key_pending) {
+    jsonr_kv_skip(j);
+    if(j->error) return 0;
+  }
+
+  _skip_whitespace(j);
+
+  if(j->c == '}') {
+    if(j->got_comma) {
       j->got_comma = 0;
-      jsonr_error(j, "in '%s': expected another key in table, but the table ended.", __func__);
+      _jsonr_fail(j, JSONR_E_TABLE_ENDED, __func__, 0, 0);
       return 0;
     }
     else {
       _advance(j);
+      _JSONR_PROFILE_DEPTH(-1);
+      _JSONR_PROFILE_CLOSE();
       jsonr_maybe_read_comma(j);
+      if(j->skips) _jsonr_skip_close(j, 0);
       return 0;
     }
   }
   else {
     if(!j->got_comma) {
-      jsonr_error(j, "in '%s': expected comma.", __func__);
+      _jsonr_fail(j, JSONR_E_EXPECTED_COMMA, __func__, 0, 0);
       return 0;
     }
 
@@ -418,12 +1543,15 @@ JSONREAD_DEF int jsonr_v_array_begin(JSON_Read_Data *j) {
   _skip_whitespace(j);
 
   if(j->c == '[') {
+    _JSONR_STAT(arrays, 1);
+    _JSONR_PROFILE_DEPTH(1);
+    if(j->skips) _jsonr_skip_open(j, 0);
     j->got_comma = 1;
     _advance(j);
     return 1;
   }
   else if(j->c == EOF) {
-    _jsonr_error_unexpected_str("[", "EOF");
+    _jsonr_error_unexpected_eof('[');
     return 0;
   }
 
@@ -438,22 +1566,26 @@ JSONREAD_DEF int jsonr_v_array_can_read(JSON_Read_Data *j) {
   if(j->c == ']') {
     if(j->got_comma) {
       j->got_comma = 0;
-      jsonr_error(j, "in '%s': expected another value in array, but the array ended.", __func__);
+      _jsonr_fail(j, JSONR_E_ARRAY_ENDED, __func__, 0, 0);
       return 0;
     }
     else {
       _advance(j);
+      _JSONR_PROFILE_DEPTH(-1);
+      _JSONR_PROFILE_CLOSE();
       jsonr_maybe_read_comma(j);
+      if(j->skips) _jsonr_skip_close(j, 1);
       return 0;
     }
   }
   else {
     if(!j->got_comma) {
-      jsonr_error(j, "in '%s': expected comma.", __func__);
+      _jsonr_fail(j, JSONR_E_EXPECTED_COMMA, __func__, 0, 0);
       return 0;
     }
 
     j->got_comma = 0;
+    if(j->skips) _jsonr_skip_element(j);
   }
 
   return 1;
@@ -572,8 +1704,9 @@ JSONREAD_DEF void jsonr_skip_remaining_string(JSON_Read_Data *j) {
 }
 
 JSONREAD_DEF void jsonr_read_string_fixed_size(JSON_Read_Data *j, char **val, unsigned long *len) {
-  static char buf[JSONR_STRINGLEN_READ_BUFFER_SIZE];
+  char *buf = j->string_buffer;
   int result;
+  *val = buf;
   *len = 0;
 
   jsonr_begin_read_string(j);
@@ -594,16 +1727,34 @@ JSONREAD_DEF void jsonr_v_string(JSON_Read_Data *j, char **val, unsigned long *l
   jsonr_read_string_fixed_size(j, val, len);
   if(j->error) return;
 
+  _JSONR_STAT(strings, 1);
+
   jsonr_maybe_read_comma(j);
   if(j->error) return;
 }
 
 JSONREAD_DEF void jsonr_k(JSON_Read_Data *j, char **key, unsigned long *len) {
+#ifdef JSONREAD_PROFILE
+  unsigned long key_offset = j->offset;
+  unsigned long key_cycles = j->profile ? _jsonr_cycles() : 0;
+#endif
+
   if(j->error) return;
 
+  if(j->key_pending) {
+    j->key_pending = 0;
+    *key = j->key;
+    *len = j->key_length;
+    return;
+  }
+
   jsonr_read_string_fixed_size(j, key, len);
   if(j->error) return;
 
+  _JSONR_STAT(keys, 1);
+#ifdef JSONREAD_PROFILE
+  if(j->profile) _jsonr_profile_key(j, *key, *len, key_offset, key_cycles);
+#endif
   _skip_whitespace(j);
 
   if(j->c != ':') {
@@ -615,24 +1766,20 @@ JSONREAD_DEF void jsonr_k(JSON_Read_Data *j, char **key, unsigned long *len) {
 }
 
 JSONREAD_DEF int jsonr_k_is_stringlen(JSON_Read_Data *j, const char *wants, unsigned long wants_len) {
-  char * has;
-  unsigned long has_len;
-  int i;
-
-  jsonr_k(j, &has, &has_len);
   if(j->error) return 0;
 
-  return _str_are_equal(has, has_len, wants, wants_len);
-}
+  if(!j->key_pending) {
+    jsonr_k(j, &j->key, &j->key_length);
+    if(j->error) return 0;
 
-JSONREAD_DEF int jsonr_k_is(JSON_Read_Data *j, const char *key) {
-  int ret;
-  JSON_Read_Peek peek = jsonr_peek_begin(j);
+    j->key_pending = 1;
+  }
 
-  ret = jsonr_k_is_stringlen(j, key, strlen(key));
-  jsonr_peek_end(j, peek);
+  return _str_are_equal(j->key, j->key_length, wants, wants_len);
+}
 
-  return ret;
+JSONREAD_DEF int jsonr_k_is(JSON_Read_Data *j, const char *key) {
+  return jsonr_k_is_stringlen(j, key, strlen(key));
 }
 
 JSONREAD_DEF void jsonr_k_eat(JSON_Read_Data *j) {
@@ -643,7 +1790,9 @@ JSONREAD_DEF void jsonr_k_eat(JSON_Read_Data *j) {
 }
 
 JSONREAD_DEF int jsonr_k_case(JSON_Read_Data *j, const char *key) {
+  _JSONR_STAT(keys_compared, 1);
   if(jsonr_k_is(j, key)) {
+    _JSONR_STAT(keys_matched, 1);
     jsonr_k_eat(j);
     return 1;
   }
@@ -689,46 +1838,102 @@ JSONREAD_DEF int jsonr_v_get_type(JSON_Read_Data *j) {
   return JSONR_V_INVALID;
 }
 
+static int _is_number_char(char c) {
+  return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+/* Collect the number's characters into buf (JSONR_NUMBER_MAX_LENGTH+1 bytes) so they can be
+ * handed to strtod in one go. No ungetc/fscanf, so the stream is only ever read forwards. Returns
+ * the length, 0 on error. */
+static unsigned long _jsonr_number_chars(JSON_Read_Data *j, char *buf, const char *where) {
+  unsigned long length = 0;
+
+  _skip_whitespace(j);
+
+  while(_is_number_char(j->c)) {
+    if(length == JSONR_NUMBER_MAX_LENGTH) {
+      _jsonr_fail(j, JSONR_E_NUMBER_TOO_LONG, where, 0, 0);
+      return 0;
+    }
+    buf[length] = j->c;
+    length += 1;
+
+    _advance(j);
+    _ensure_char(j);
+  }
+  buf[length] = 0;
+
+  if(length == 0) {
+    _jsonr_fail(j, JSONR_E_EXPECTED_NUMBER, where, 0, j->c);
+    return 0;
+  }
+  return length;
+}
+
 JSONREAD_DEF double jsonr_v_number(JSON_Read_Data *j) {
+  char buf[JSONR_NUMBER_MAX_LENGTH+1];
+  unsigned long length;
+  char * end;
   double val;
-  int result;
-  long tell_before;
 
   if(j->error) return 0;
 
-  _skip_whitespace(j);
-
-  tell_before = ftell(j->f);
+  length = _jsonr_number_chars(j, buf, __func__);
+  if(length == 0) return 0;
 
-  if(ungetc(j->c, j->f) != j->c) {
-    jsonr_error(j, "in '%s': ungetc failed.", __func__);
+  val = strtod(buf, &end);
+  if(end != buf + length) {
+    _jsonr_fail(j, JSONR_E_MALFORMED_NUMBER, __func__, 0, 0);
     return 0;
   }
 
-  result = fscanf(j->f, "%lf", &val);
+  _JSONR_STAT(numbers, 1);
+  jsonr_maybe_read_comma(j);
+  return val;
+}
 
-  j->column += ftell(j->f) - tell_before;
+JSONREAD_DEF int jsonr_v_number_int(JSON_Read_Data *j, long *i, double *d) {
+  char buf[JSONR_NUMBER_MAX_LENGTH+1];
+  unsigned long length;
+  unsigned long digits;
+  unsigned long val = 0;
+  char * end;
+  int negative;
 
-  if(result == 1) {
-    j->read = 1;
-    jsonr_maybe_read_comma(j);
-    return val;
+  *i = 0;
+  *d = 0;
+  if(j->error) return 0;
+
+  length = _jsonr_number_chars(j, buf, __func__);
+  if(length == 0) return 0;
+
+  /* 18 digits always fit in a long. */
+  negative = buf[0] == '-';
+  for(digits = negative; digits < length && buf[digits] >= '0' && buf[digits] <= '9'; digits++) {
+    val = val * 10 + (buf[digits] - '0');
   }
-  else if(result != 0) {
-    jsonr_error(j, "in '%s': fscanf read 0 numbers.", __func__);
-    return 0;
+
+  if(digits == length && digits > (unsigned long)negative && length - negative <= 18) {
+    *i = negative ? -(long)val : (long)val;
+    _JSONR_STAT(numbers, 1);
+    jsonr_maybe_read_comma(j);
+    return 1;
   }
-  else if(result == EOF) {
-    jsonr_error(j, "in '%s': fscanf encountered EOF while reading number.", __func__);
+
+  *d = strtod(buf, &end);
+  if(end != buf + length) {
+    _jsonr_fail(j, JSONR_E_MALFORMED_NUMBER, __func__, 0, 0);
+    *d = 0;
     return 0;
   }
 
-  jsonr_error(j, "in '%s': fscanf failure.", __func__);
+  _JSONR_STAT(numbers, 1);
+  jsonr_maybe_read_comma(j);
   return 0;
 }
 
 #define MATCH_CHAR(ch) \
-  _advance(j); if(j->c != ch) { _jsonr_error_unexpected_char(ch, j->c); return 0; }
+  _advance(j); _ensure_char(j); if(j->c != ch) { _jsonr_error_unexpected_char(ch, j->c); return 0; }
 
 JSONREAD_DEF int jsonr_v_bool(JSON_Read_Data *j) {
   if(j->error) return 0;
@@ -738,6 +1943,8 @@ JSONREAD_DEF int jsonr_v_bool(JSON_Read_Data *j) {
     MATCH_CHAR('r');
     MATCH_CHAR('u');
     MATCH_CHAR('e');
+    _advance(j);
+    _JSONR_STAT(bools, 1);
     jsonr_maybe_read_comma(j);
     return 1;
   }
@@ -746,11 +1953,13 @@ JSONREAD_DEF int jsonr_v_bool(JSON_Read_Data *j) {
     MATCH_CHAR('l');
     MATCH_CHAR('s');
     MATCH_CHAR('e');
+    _advance(j);
+    _JSONR_STAT(bools, 1);
     jsonr_maybe_read_comma(j);
     return 0;
   }
 
-  j->error = 1;
+  _jsonr_fail(j, JSONR_E_EXPECTED_BOOL, __func__, 0, j->c);
   return 0;
 }
 
@@ -762,6 +1971,8 @@ JSONREAD_DEF int jsonr_v_null(JSON_Read_Data *j) {
     MATCH_CHAR('u');
     MATCH_CHAR('l');
     MATCH_CHAR('l');
+    _advance(j);
+    _JSONR_STAT(nulls, 1);
     jsonr_maybe_read_comma(j);
     return 1;
   }
@@ -772,7 +1983,7 @@ JSONREAD_DEF int jsonr_v_null(JSON_Read_Data *j) {
 
 #undef MATCH_CHAR
 
-JSONREAD_DEF void jsonr_v_skip(JSON_Read_Data *j) {
+static void _jsonr_v_skip(JSON_Read_Data *j) {
   int type;
   char * key;
   unsigned long len;
@@ -784,20 +1995,20 @@ JSONREAD_DEF void jsonr_v_skip(JSON_Read_Data *j) {
 
   switch(type) {
     case JSONR_V_INVALID: {
-      jsonr_error(j, "in '%s': encountered a 'JSONR_V_INVALID' type.", __func__);
+      _jsonr_fail(j, JSONR_E_INVALID_VALUE, __func__, 0, j->c);
       break;
     }
     case JSONR_V_NUMBER: jsonr_v_number(j); break;
     case JSONR_V_ARRAY: {
       jsonr_v_array(j) {
-        jsonr_v_skip(j);
+        _jsonr_v_skip(j);
       }
       break;
     }
     case JSONR_V_TABLE: {
       jsonr_v_table(j) {
         jsonr_k_eat(j);
-        jsonr_v_skip(j);
+        _jsonr_v_skip(j);
       }
       break;
     }
@@ -810,6 +2021,25 @@ JSONREAD_DEF void jsonr_v_skip(JSON_Read_Data *j) {
   }
 }
 
+JSONREAD_DEF void jsonr_v_skip(JSON_Read_Data *j) {
+  unsigned long begin = _JSONR_SKIP_NONE;
+#ifdef JSONREAD_STATS
+  unsigned long bytes_before = j->stats.bytes;
+#endif
+
+  if(j->skips && _jsonr_skip_jump(j, &begin)) return;
+
+#ifdef JSONREAD_STATS
+  _jsonr_v_skip(j);
+  j->stats.skips += 1;
+  j->stats.skipped_bytes += j->stats.bytes - bytes_before;
+#else
+  _jsonr_v_skip(j);
+#endif
+
+  if(begin != _JSONR_SKIP_NONE && !j->error) _jsonr_skip_record(j, begin, j->value_end);
+}
+
 
 JSONREAD_DEF void jsonr_kv_skip(JSON_Read_Data *j) {
   jsonr_k_eat(j);
@@ -818,6 +2048,1705 @@ JSONREAD_DEF void jsonr_kv_skip(JSON_Read_Data *j) {
   jsonr_v_skip(j);
   if(j->error) return;
 }
+
+/* 'length' bytes of the current block were consumed without going through _ensure_char. Keep
+ * the bookkeeping it does up to date. */
+static void _jsonr_consumed(JSON_Read_Data *j, const char *data, unsigned long length) {
+  unsigned long i = length > JSONR_RECENT_SIZE ? length - JSONR_RECENT_SIZE : 0;
+#ifndef JSONREAD_LAZY_POSITION
+  const char *cursor = data;
+  const char *end = data + length;
+  const char *newline;
+#endif
+
+  for(; i < length; i++) {
+    j->recent[(j->offset + i) & (JSONR_RECENT_SIZE-1)] = data[i];
+  }
+
+#ifndef JSONREAD_LAZY_POSITION
+  while((newline = (const char*)memchr(cursor, '\n', end - cursor))) {
+    j->line += 1;
+    j->column = 0;
+    cursor = newline + 1;
+  }
+  j->column += end - cursor;
+#endif
+
+  j->offset += length;
+  _JSONR_STAT(bytes, length);
+}
+
+JSONREAD_DEF void jsonr_v_skip_fast(JSON_Read_Data *j) {
+  const char *start;
+  const char *cursor;
+  const char *end;
+  long depth;
+  int in_string;
+  int escaped = 0;
+  int done = 0;
+  int type;
+  char c;
+  unsigned long begin = _JSONR_SKIP_NONE;
+#ifdef JSONREAD_STATS
+  unsigned long bytes_before;
+#endif
+
+  if(j->error) return;
+
+  type = jsonr_v_get_type(j);
+  if(j->error) return;
+
+  /* Scalars are short, the regular path is as good as it gets. */
+  if(type != JSONR_V_TABLE && type != JSONR_V_ARRAY && type != JSONR_V_STRING) {
+    jsonr_v_skip(j);
+    return;
+  }
+
+  if(j->skips && _jsonr_skip_jump(j, &begin)) return;
+
+  /* j->c is the opening quote/bracket, it's been consumed from the block already. */
+  in_string = type == JSONR_V_STRING;
+  depth = in_string ? 0 : 1;
+#ifdef JSONREAD_STATS
+  bytes_before = j->stats.bytes - 1;
+#endif
+
+  while(!done) {
+    if(j->block_pos == j->block_length && !_jsonr_refill(j)) {
+      if(in_string) {
+        _jsonr_error_string_eof();
+      }
+      else {
+        _jsonr_error_unexpected_eof(type == JSONR_V_TABLE ? '}' : ']');
+      }
+      return;
+    }
+
+    start = j->block + j->block_pos;
+    end = j->block + j->block_length;
+
+    for(cursor = start; cursor != end && !done; ) {
+      c = *cursor++;
+
+      if(in_string) {
+        if(escaped) escaped = 0;
+        else if(c == '\\') escaped = 1;
+        else if(c == '\"') {
+          in_string = 0;
+          done = depth == 0;
+        }
+      }
+      else if(c == '\"') in_string = 1;
+      else if(c == '{' || c == '[') depth += 1;
+      else if(c == '}' || c == ']') {
+        depth -= 1;
+        done = depth == 0;
+      }
+    }
+
+    _jsonr_consumed(j, start, cursor - start);
+    j->block_pos += cursor - start;
+    j->c = cursor[-1];
+  }
+
+  _JSONR_STAT(skips, 1);
+  _JSONR_STAT(skipped_bytes, j->stats.bytes - bytes_before);
+  j->read = 1;
+  jsonr_maybe_read_comma(j);
+  if(begin != _JSONR_SKIP_NONE) _jsonr_skip_record(j, begin, j->value_end);
+}
+
+/* Compare a key against a JSON Pointer reference token, where "~1" stands for '/' and "~0" for '~'. */
+static int _jsonr_pointer_token_is(const char *key, unsigned long key_length, const char *token, unsigned long token_length) {
+  unsigned long k = 0;
+  unsigned long t = 0;
+  char c;
+
+  while(t < token_length) {
+    c = token[t];
+    if(c == '~' && t + 1 < token_length && (token[t+1] == '0' || token[t+1] == '1')) {
+      c = token[t+1] == '0' ? '~' : '/';
+      t += 1;
+    }
+    t += 1;
+
+    if(k == key_length || key[k] != c) return 0;
+    k += 1;
+  }
+  return k == key_length;
+}
+
+/* Array index reference token: digits without leading zeros. -1 if it isn't one. */
+static long _jsonr_pointer_index(const char *token, unsigned long token_length) {
+  unsigned long i;
+  long index = 0;
+
+  if(token_length == 0 || (token[0] == '0' && token_length > 1)) return -1;
+
+  for(i = 0; i < token_length; i++) {
+    if(token[i] < '0' || token[i] > '9') return -1;
+    index = index * 10 + (token[i] - '0');
+  }
+  return index;
+}
+
+JSONREAD_DEF int jsonr_extract(JSON_Read_Data *j, const char *pointer) {
+  const char *token;
+  unsigned long token_length;
+  char *key;
+  unsigned long key_length;
+  long index;
+  int found;
+
+  while(*pointer && !j->error) {
+    if(*pointer != '/') return 0;
+
+    token = pointer + 1;
+    for(pointer = token; *pointer && *pointer != '/'; pointer++);
+    token_length = pointer - token;
+
+    found = 0;
+    switch(jsonr_v_get_type(j)) {
+      case JSONR_V_TABLE: {
+        jsonr_v_table(j) {
+          jsonr_k(j, &key, &key_length);
+          if(j->error) break;
+
+          if(_jsonr_pointer_token_is(key, key_length, token, token_length)) {
+            found = 1;
+            break;
+          }
+          jsonr_v_skip_fast(j);
+        }
+        break;
+      }
+      case JSONR_V_ARRAY: {
+        index = _jsonr_pointer_index(token, token_length);
+        if(index < 0) return 0;
+
+        found = jsonr_v_array_at(j, index);
+        break;
+      }
+    }
+
+    if(!found) return 0;
+  }
+
+  return !j->error;
+}
+
+JSONREAD_DEF int jsonr_v_array_at(JSON_Read_Data *j, long index) {
+  unsigned long begin;
+  unsigned long to = 0;
+  long element = 0;
+  long i = 0;
+
+  if(!jsonr_v_array_begin(j)) return 0;
+  begin = j->offset - 1;
+
+  /* Start from the closest element before it that we know the start of. */
+  if(j->skips && index >= JSONR_SKIP_STRIDE) {
+    for(element = index - index % JSONR_SKIP_STRIDE; element > 0; element -= JSONR_SKIP_STRIDE) {
+      if(_jsonr_skip_get(j->skips, begin, element, &to)) break;
+    }
+  }
+
+  if(element > 0 && (j->seek || to <= j->block_offset + j->block_length)) {
+    if(!_jsonr_jump(j, to)) {
+      _jsonr_fail(j, JSONR_E_SEEK, __func__, 0, 0);
+      return 0;
+    }
+    j->got_comma = 1;
+    if(j->skip_depth <= JSONR_SKIP_DEPTH) j->skip_frames[j->skip_depth - 1].elements = element;
+    _JSONR_STAT(jumps, 1);
+    i = element;
+  }
+
+  while(jsonr_v_array_can_read(j)) {
+    if(i == index) return 1;
+    jsonr_v_skip_fast(j);
+    i += 1;
+  }
+  return 0;
+}
+
+JSONREAD_DEF void jsonr_projection_init(JSON_Read_Projection *p) {
+  p->nodes[0].token = 0;
+  p->nodes[0].token_length = 0;
+  p->nodes[0].index = -1;
+  p->nodes[0].wildcard = 0;
+  p->nodes[0].path = -1;
+  p->nodes[0].first_child = -1;
+  p->nodes[0].next_sibling = -1;
+  p->node_count = 1;
+  p->path_count = 0;
+  p->has_wildcards = 0;
+}
+
+JSONREAD_DEF int jsonr_projection_add(JSON_Read_Projection *p, const char *pointer, int id) {
+  _JSON_Read_Projection_Node *node;
+  const char *token;
+  unsigned long token_length;
+  int parent = 0;
+  int child;
+
+  while(*pointer) {
+    if(*pointer != '/') return 0;
+
+    token = pointer + 1;
+    for(pointer = token; *pointer && *pointer != '/'; pointer++);
+    token_length = pointer - token;
+
+    for(child = p->nodes[parent].first_child; child >= 0; child = p->nodes[child].next_sibling) {
+      node = &p->nodes[child];
+      if(node->token_length == token_length && memcmp(node->token, token, token_length) == 0) break;
+    }
+
+    if(child < 0) {
+      if(p->node_count == JSONR_PROJECTION_NODES) return 0;
+
+      child = p->node_count;
+      p->node_count += 1;
+
+      node = &p->nodes[child];
+      node->token = token;
+      node->token_length = token_length;
+      node->index = _jsonr_pointer_index(token, token_length);
+      node->wildcard = token_length == 1 && token[0] == '*';
+      node->path = -1;
+      node->first_child = -1;
+      node->next_sibling = p->nodes[parent].first_child;
+      p->nodes[parent].first_child = child;
+
+      if(node->wildcard) p->has_wildcards = 1;
+    }
+    parent = child;
+  }
+
+  if(p->nodes[parent].path >= 0) return 0;
+
+  p->nodes[parent].path = id;
+  p->path_count += 1;
+  return 1;
+}
+
+typedef struct {
+  const JSON_Read_Projection *p;
+  JSON_Read_Project_Hit hit;
+  void *user;
+  int remaining; /* paths left to hit before we can stop, -1 to never stop early. */
+  char seen[JSONR_PROJECTION_NODES]; /* path nodes hit so far, when 'remaining' counts. */
+} _JSON_Read_Project;
+
+/* Collect the children of the 'active' nodes matching a key (or an array index if 'key' is 0)
+ * into 'next'. More than one can match when wildcards are involved. */
+static int _jsonr_project_match(const JSON_Read_Projection *p, const int *active, int active_count, const char *key, unsigned long key_length, long index, int *next) {
+  const _JSON_Read_Projection_Node *n;
+  int next_count = 0;
+  int child;
+  int i;
+
+  for(i = 0; i < active_count; i++) {
+    for(child = p->nodes[active[i]].first_child; child >= 0; child = n->next_sibling) {
+      n = &p->nodes[child];
+      if(n->wildcard || (key ? _jsonr_pointer_token_is(key, key_length, n->token, n->token_length) : n->index == index)) {
+        if(next_count < JSONR_PROJECTION_ACTIVE) {
+          next[next_count] = child;
+          next_count += 1;
+        }
+      }
+    }
+  }
+  return next_count;
+}
+
+/* Hand the value under the cursor to the paths of every node in 'nodes'. A number, string, bool
+ * or null is read once and re-encoded, each hit reads the copy through its own jsonr_init_mem
+ * context. A table or array is read again from where it began with jsonr_peek_end. */
+static int _jsonr_project_hits(JSON_Read_Data *j, _JSON_Read_Project *walk, const int *nodes, int count) {
+  const JSON_Read_Projection *p = walk->p;
+  char text[JSONR_STRINGLEN_READ_BUFFER_SIZE*2 + 3];
+  unsigned long length = 0;
+  JSON_Read_Data copy;
+  JSON_Read_Peek peek;
+  char *str;
+  unsigned long len;
+  unsigned long k;
+  int type;
+  int i;
+
+  type = jsonr_v_get_type(j);
+  if(j->error) return 0;
+
+  if(type == JSONR_V_TABLE || type == JSONR_V_ARRAY) {
+    peek = jsonr_peek_begin(j);
+    for(i = 0; i < count; i++) {
+      if(i > 0) jsonr_peek_end(j, peek);
+      if(j->error) return 0;
+      if(!walk->hit(j, p->nodes[nodes[i]].path, walk->user)) return 0;
+    }
+    return !j->error;
+  }
+
+  switch(type) {
+    case JSONR_V_NUMBER: {
+      length = _jsonr_number_chars(j, text, __func__);
+      if(length == 0) return 0;
+      _JSONR_STAT(numbers, 1);
+      jsonr_maybe_read_comma(j);
+      break;
+    }
+    case JSONR_V_STRING: {
+      jsonr_v_string(j, &str, &len);
+      text[length++] = '\"';
+      for(k = 0; k < len; k++) {
+        switch(str[k]) {
+          case '\"': text[length++] = '\\'; text[length++] = '\"'; break;
+          case '\\': text[length++] = '\\'; text[length++] = '\\'; break;
+          case '\b': text[length++] = '\\'; text[length++] = 'b'; break;
+          case '\f': text[length++] = '\\'; text[length++] = 'f'; break;
+          case '\n': text[length++] = '\\'; text[length++] = 'n'; break;
+          case '\r': text[length++] = '\\'; text[length++] = 'r'; break;
+          case '\t': text[length++] = '\\'; text[length++] = 't'; break;
+          default: text[length++] = str[k]; break;
+        }
+      }
+      text[length++] = '\"';
+      break;
+    }
+    case JSONR_V_BOOL: length = snprintf(text, sizeof(text), "%s", jsonr_v_bool(j) ? "true" : "false"); break;
+    case JSONR_V_NULL: jsonr_v_null(j); length = snprintf(text, sizeof(text), "null"); break;
+    /* Not a value, let the first hit run into the error. */
+    default: return walk->hit(j, p->nodes[nodes[0]].path, walk->user) && !j->error;
+  }
+  if(j->error) return 0;
+
+  for(i = 0; i < count; i++) {
+    jsonr_init_mem(&copy, text, length);
+    if(!walk->hit(&copy, p->nodes[nodes[i]].path, walk->user)) return 0;
+
+    if(copy.error) {
+      if(copy.error_code == JSONR_E_CUSTOM) memcpy(j->error_custom, copy.error_custom, sizeof(j->error_custom));
+      _jsonr_fail(j, copy.error_code, copy.error_where, copy.error_expected, copy.error_got);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* Walk the value under the cursor, which is at every trie node in 'active'. Returns 0 once we
+ * can stop. */
+static int _jsonr_project_value(JSON_Read_Data *j, _JSON_Read_Project *walk, const int *active, int active_count) {
+  const JSON_Read_Projection *p = walk->p;
+  int next[JSONR_PROJECTION_ACTIVE];
+  int next_count;
+  int hits[JSONR_PROJECTION_ACTIVE];
+  int hit_count = 0;
+  char *key;
+  unsigned long key_length;
+  long index;
+  int i;
+
+  if(active_count == 0) {
+    jsonr_v_skip_fast(j);
+    return !j->error;
+  }
+
+  for(i = 0; i < active_count; i++) {
+    if(p->nodes[active[i]].path >= 0) {
+      hits[hit_count] = active[i];
+      hit_count += 1;
+    }
+  }
+
+  if(hit_count > 0) {
+    if(hit_count == 1) {
+      if(!walk->hit(j, p->nodes[hits[0]].path, walk->user)) return 0;
+    }
+    else if(!_jsonr_project_hits(j, walk, hits, hit_count)) return 0;
+
+    /* A repeated key hits the same path again, that doesn't bring us closer to stopping. */
+    for(i = 0; i < hit_count && walk->remaining > 0; i++) {
+      if(walk->seen[hits[i]]) continue;
+      walk->seen[hits[i]] = 1;
+      walk->remaining -= 1;
+    }
+    return walk->remaining != 0 && !j->error;
+  }
+
+  switch(jsonr_v_get_type(j)) {
+    case JSONR_V_TABLE: {
+      jsonr_v_table(j) {
+        jsonr_k(j, &key, &key_length);
+        if(j->error) return 0;
+
+        next_count = _jsonr_project_match(p, active, active_count, key, key_length, -1, next);
+        if(!_jsonr_project_value(j, walk, next, next_count)) return 0;
+      }
+      break;
+    }
+    case JSONR_V_ARRAY: {
+      index = 0;
+      jsonr_v_array(j) {
+        next_count = _jsonr_project_match(p, active, active_count, 0, 0, index, next);
+        if(!_jsonr_project_value(j, walk, next, next_count)) return 0;
+        index += 1;
+      }
+      break;
+    }
+    default: jsonr_v_skip_fast(j); break;
+  }
+
+  return !j->error;
+}
+
+JSONREAD_DEF int jsonr_project(JSON_Read_Data *j, const JSON_Read_Projection *p, JSON_Read_Project_Hit hit, void *user) {
+  _JSON_Read_Project walk;
+  int root = 0;
+
+  if(j->error) return 0;
+
+  walk.p = p;
+  walk.hit = hit;
+  walk.user = user;
+  walk.remaining = p->has_wildcards ? -1 : p->path_count;
+  memset(walk.seen, 0, sizeof(walk.seen));
+
+  if(walk.remaining == 0) {
+    jsonr_v_skip_fast(j);
+    return !j->error;
+  }
+  return _jsonr_project_value(j, &walk, &root, 1);
+}
+
+JSONREAD_DEF void jsonr_skip_line(JSON_Read_Data *j) {
+  const char *start;
+  const char *newline;
+  unsigned long length;
+
+  if(j->error) return;
+
+  j->got_comma = 0;
+  j->key_pending = 0;
+  j->skip_depth = 0;
+#ifdef JSONREAD_PROFILE
+  if(j->profile) _jsonr_profile_close(j, 0, _jsonr_cycles(), j->offset);
+  j->depth = 0;
+#endif
+
+  if(!j->read && j->c == '\n') {
+    _advance(j);
+    return;
+  }
+
+  for(;;) {
+    if(j->block_pos == j->block_length && !_jsonr_refill(j)) {
+      j->c = EOF;
+      j->read = 0;
+      return;
+    }
+
+    start = j->block + j->block_pos;
+    length = j->block_length - j->block_pos;
+    newline = (const char*)memchr(start, '\n', length);
+    if(newline) length = newline - start + 1;
+
+    _jsonr_consumed(j, start, length);
+    j->block_pos += length;
+
+    if(newline) {
+      j->c = '\n';
+      _advance(j);
+      return;
+    }
+  }
+}
+
+JSONREAD_DEF void jsonr_prefilter_init(JSON_Read_Prefilter *p) {
+  p->count = 0;
+}
+
+JSONREAD_DEF int jsonr_prefilter_add(JSON_Read_Prefilter *p, const char *needle) {
+  if(!*needle || p->count == JSONR_PREFILTER_NEEDLES) return 0;
+
+  p->needles[p->count] = needle;
+  p->lengths[p->count] = strlen(needle);
+  p->count += 1;
+  return 1;
+}
+
+static int _jsonr_contains(const char *hay, unsigned long length, const char *needle, unsigned long needle_length) {
+  unsigned long i = 0;
+  const char *c;
+#ifdef __SSE2__
+  __m128i first;
+  __m128i last;
+  __m128i a;
+  __m128i b;
+  unsigned int mask;
+#endif
+
+  if(needle_length > length) return 0;
+
+#ifdef __SSE2__
+  /* Compare 16 candidate positions at once on the needle's first and last byte, only the ones
+   * where both match get a memcmp. */
+  first = _mm_set1_epi8(needle[0]);
+  last = _mm_set1_epi8(needle[needle_length-1]);
+
+  for(; i + needle_length - 1 + 16 <= length; i += 16) {
+    a = _mm_loadu_si128((const __m128i*)(hay + i));
+    b = _mm_loadu_si128((const __m128i*)(hay + i + needle_length - 1));
+    mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+
+    while(mask) {
+      if(memcmp(hay + i + __builtin_ctz(mask), needle, needle_length) == 0) return 1;
+      mask &= mask - 1;
+    }
+  }
+#endif
+
+  for(;;) {
+    c = (const char*)memchr(hay + i, needle[0], length - needle_length + 1 - i);
+    if(!c) return 0;
+    if(memcmp(c, needle, needle_length) == 0) return 1;
+    i = c - hay + 1;
+  }
+}
+
+JSONREAD_DEF int jsonr_prefilter_match(const JSON_Read_Prefilter *p, const char *line, unsigned long length) {
+  int i;
+
+  for(i = 0; i < p->count; i++) {
+    if(!_jsonr_contains(line, length, p->needles[i], p->lengths[i])) return 0;
+  }
+  return 1;
+}
+
+JSONREAD_DEF int jsonr_prefilter_skip(JSON_Read_Data *j, const JSON_Read_Prefilter *p) {
+  const char *start;
+  const char *newline;
+  unsigned long length;
+
+  if(j->error) return 0;
+
+  /* The line's first byte may already be in j->c (i.e after jsonr_filter_record). */
+  if(!j->read) {
+    if(j->c == EOF) return 0;
+    /* Nothing of the line left in this block to look at, and j->c can't be put back. */
+    if(j->block_pos == 0 || j->block_pos == j->block_length) return 1;
+  }
+
+  for(;;) {
+    if(j->block_pos == j->block_length && !_jsonr_refill(j)) {
+      j->c = EOF;
+      j->read = 0;
+      return 0;
+    }
+
+    start = j->block + j->block_pos - !j->read;
+    length = j->block_length - (start - j->block);
+    newline = (const char*)memchr(start, '\n', length);
+
+    if(!newline || jsonr_prefilter_match(p, start, newline - start)) return 1;
+
+    /* Rejected, same as jsonr_skip_line. */
+    start = j->block + j->block_pos;
+    length = newline - start + 1;
+    _jsonr_consumed(j, start, length);
+    j->block_pos += length;
+    j->c = '\n';
+    _advance(j);
+  }
+}
+
+enum {
+  _JSONR_FILTER_COMPARE,
+  _JSONR_FILTER_AND,
+  _JSONR_FILTER_OR,
+  _JSONR_FILTER_NOT,
+};
+
+enum {
+  _JSONR_FILTER_EQ,
+  _JSONR_FILTER_NE,
+  _JSONR_FILTER_LT,
+  _JSONR_FILTER_LE,
+  _JSONR_FILTER_GT,
+  _JSONR_FILTER_GE,
+};
+
+/* Results are three-valued while a record is being walked. */
+enum {
+  _JSONR_FILTER_FALSE,
+  _JSONR_FILTER_TRUE,
+  _JSONR_FILTER_UNKNOWN,
+};
+
+static int _jsonr_filter_or(JSON_Read_Filter *f, const char **cursor);
+
+static void _jsonr_filter_space(const char **cursor) {
+  while(isspace((unsigned char)**cursor)) *cursor += 1;
+}
+
+static int _jsonr_filter_node(JSON_Read_Filter *f, int type, int a, int b) {
+  _JSON_Read_Filter_Node *node;
+
+  if(f->node_count == JSONR_FILTER_NODES) return -1;
+
+  node = &f->nodes[f->node_count];
+  memset(node, 0, sizeof(*node));
+  node->type = type;
+  node->a = a;
+  node->b = b;
+  node->path = -1;
+  return f->node_count++;
+}
+
+/* A null terminated copy of 'length' bytes of 'str' in f->text. */
+static char * _jsonr_filter_text(JSON_Read_Filter *f, const char *str, unsigned long length) {
+  char *text;
+
+  if(f->text_used + length + 1 > JSONR_FILTER_TEXT) return 0;
+
+  text = f->text + f->text_used;
+  memcpy(text, str, length);
+  text[length] = 0;
+  f->text_used += length + 1;
+  return text;
+}
+
+/* Path id of 'pointer', adding it to the projection the first time around. */
+static int _jsonr_filter_path(JSON_Read_Filter *f, const char *pointer, unsigned long length) {
+  char *copy;
+  int path;
+
+  for(path = 0; path < f->path_count; path++) {
+    if(strlen(f->paths[path]) == length && memcmp(f->paths[path], pointer, length) == 0) return path;
+  }
+
+  copy = _jsonr_filter_text(f, pointer, length);
+  if(!copy || !jsonr_projection_add(&f->projection, copy, f->path_count)) return -1;
+
+  f->paths[f->path_count] = copy;
+  return f->path_count++;
+}
+
+static int _jsonr_filter_is_operator_char(char c) {
+  return c == '=' || c == '!' || c == '<' || c == '>' || c == '(' || c == ')' || c == '&' || c == '|';
+}
+
+/* pointer op literal */
+static int _jsonr_filter_compare(JSON_Read_Filter *f, const char **cursor) {
+  _JSON_Read_Filter_Node *node;
+  const char *pointer = *cursor;
+  const char *c;
+  char *end;
+  char *text;
+  int index;
+
+  while(**cursor && !isspace((unsigned char)**cursor) && !_jsonr_filter_is_operator_char(**cursor)) *cursor += 1;
+  if(*cursor == pointer) return -1;
+
+  index = _jsonr_filter_node(f, _JSONR_FILTER_COMPARE, -1, -1);
+  if(index < 0) return -1;
+  node = &f->nodes[index];
+
+  node->path = _jsonr_filter_path(f, pointer, *cursor - pointer);
+  if(node->path < 0) return -1;
+
+  for(c = pointer; c < *cursor; c++) {
+    if(c[0] == '/' && c[1] == '*' && (c + 2 == *cursor || c[2] == '/')) node->any = 1;
+  }
+
+  _jsonr_filter_space(cursor);
+  c = *cursor;
+  if(c[0] == '=' && c[1] == '=') { node->op = _JSONR_FILTER_EQ; *cursor += 2; }
+  else if(c[0] == '!' && c[1] == '=') { node->op = _JSONR_FILTER_NE; *cursor += 2; }
+  else if(c[0] == '<' && c[1] == '=') { node->op = _JSONR_FILTER_LE; *cursor += 2; }
+  else if(c[0] == '>' && c[1] == '=') { node->op = _JSONR_FILTER_GE; *cursor += 2; }
+  else if(c[0] == '<') { node->op = _JSONR_FILTER_LT; *cursor += 1; }
+  else if(c[0] == '>') { node->op = _JSONR_FILTER_GT; *cursor += 1; }
+  else return -1;
+
+  _jsonr_filter_space(cursor);
+  c = *cursor;
+
+  if(*c == '\"') {
+    /* Unescape into f->text. The result is never longer than the literal. */
+    for(c += 1; *c && *c != '\"'; c += 1 + (*c == '\\' && c[1]));
+    if(*c != '\"') return -1;
+
+    text = _jsonr_filter_text(f, *cursor + 1, c - (*cursor + 1));
+    if(!text) return -1;
+
+    node->literal_type = JSONR_V_STRING;
+    node->string = text;
+    for(c = *cursor + 1; *c != '\"'; c++) {
+      if(*c == '\\') c++;
+      *text++ = *c;
+    }
+    *text = 0;
+    node->string_length = text - node->string;
+    *cursor = c + 1;
+  }
+  else if(strncmp(c, "true", 4) == 0 || strncmp(c, "false", 5) == 0) {
+    node->literal_type = JSONR_V_BOOL;
+    node->number = *c == 't';
+    *cursor += *c == 't' ? 4 : 5;
+  }
+  else if(strncmp(c, "null", 4) == 0) {
+    node->literal_type = JSONR_V_NULL;
+    *cursor += 4;
+  }
+  else {
+    node->literal_type = JSONR_V_NUMBER;
+    node->number = strtod(c, &end);
+    if(end == c) return -1;
+    *cursor = end;
+  }
+
+  return index;
+}
+
+/* !unary | ( or ) | compare */
+static int _jsonr_filter_unary(JSON_Read_Filter *f, const char **cursor) {
+  int operand;
+
+  _jsonr_filter_space(cursor);
+
+  if(**cursor == '!') {
+    *cursor += 1;
+    operand = _jsonr_filter_unary(f, cursor);
+    if(operand < 0) return -1;
+    return _jsonr_filter_node(f, _JSONR_FILTER_NOT, operand, -1);
+  }
+
+  if(**cursor == '(') {
+    *cursor += 1;
+    operand = _jsonr_filter_or(f, cursor);
+    if(operand < 0) return -1;
+
+    _jsonr_filter_space(cursor);
+    if(**cursor != ')') return -1;
+    *cursor += 1;
+    return operand;
+  }
+
+  return _jsonr_filter_compare(f, cursor);
+}
+
+/* unary (&& unary)* */
+static int _jsonr_filter_and(JSON_Read_Filter *f, const char **cursor) {
+  int left = _jsonr_filter_unary(f, cursor);
+  int right;
+
+  for(;;) {
+    if(left < 0) return -1;
+
+    _jsonr_filter_space(cursor);
+    if((*cursor)[0] != '&' || (*cursor)[1] != '&') return left;
+    *cursor += 2;
+
+    right = _jsonr_filter_unary(f, cursor);
+    if(right < 0) return -1;
+    left = _jsonr_filter_node(f, _JSONR_FILTER_AND, left, right);
+  }
+}
+
+/* and (|| and)* */
+static int _jsonr_filter_or(JSON_Read_Filter *f, const char **cursor) {
+  int left = _jsonr_filter_and(f, cursor);
+  int right;
+
+  for(;;) {
+    if(left < 0) return -1;
+
+    _jsonr_filter_space(cursor);
+    if((*cursor)[0] != '|' || (*cursor)[1] != '|') return left;
+    *cursor += 2;
+
+    right = _jsonr_filter_and(f, cursor);
+    if(right < 0) return -1;
+    left = _jsonr_filter_node(f, _JSONR_FILTER_OR, left, right);
+  }
+}
+
+JSONREAD_DEF int jsonr_filter_compile(JSON_Read_Filter *f, const char *expr) {
+  const char *cursor = expr;
+
+  f->node_count = 0;
+  f->path_count = 0;
+  f->text_used = 0;
+  f->error_offset = 0;
+  jsonr_projection_init(&f->projection);
+
+  f->root = _jsonr_filter_or(f, &cursor);
+  _jsonr_filter_space(&cursor);
+
+  if(f->root < 0 || *cursor) {
+    f->error_offset = cursor - expr;
+    return 0;
+  }
+  return 1;
+}
+
+/* The value at a path, read once for every comparison against it. */
+typedef struct {
+  int type;
+  double number; /* also the bool. */
+  char * string;
+  unsigned long string_length;
+} _JSON_Read_Filter_Value;
+
+static int _jsonr_filter_compare_value(const _JSON_Read_Filter_Node *node, const _JSON_Read_Filter_Value *value) {
+  unsigned long length;
+  int cmp;
+
+  /* Different types compare false, whatever the operator (!= too), like a missing path does. */
+  if(node->literal_type != value->type) return 0;
+
+  switch(value->type) {
+    case JSONR_V_STRING: {
+      length = value->string_length < node->string_length ? value->string_length : node->string_length;
+      cmp = memcmp(value->string, node->string, length);
+      if(cmp == 0) cmp = (value->string_length > node->string_length) - (value->string_length < node->string_length);
+      break;
+    }
+    case JSONR_V_NULL: cmp = 0; break;
+    default: cmp = (value->number > node->number) - (value->number < node->number); break;
+  }
+
+  switch(node->op) {
+    case _JSONR_FILTER_EQ: return cmp == 0;
+    case _JSONR_FILTER_NE: return cmp != 0;
+    case _JSONR_FILTER_LT: return cmp < 0;
+    case _JSONR_FILTER_LE: return cmp <= 0;
+    case _JSONR_FILTER_GT: return cmp > 0;
+    case _JSONR_FILTER_GE: return cmp >= 0;
+  }
+  return 0;
+}
+
+/* Comparisons that are still unknown count as false once 'final'. */
+static int _jsonr_filter_eval(const JSON_Read_Filter *f, int index, int final) {
+  const _JSON_Read_Filter_Node *node = &f->nodes[index];
+  int a, b;
+
+  switch(node->type) {
+    case _JSONR_FILTER_COMPARE: {
+      if(final && f->state[index] == _JSONR_FILTER_UNKNOWN) return _JSONR_FILTER_FALSE;
+      return f->state[index];
+    }
+    case _JSONR_FILTER_NOT: {
+      a = _jsonr_filter_eval(f, node->a, final);
+      return a == _JSONR_FILTER_UNKNOWN ? a : !a;
+    }
+    case _JSONR_FILTER_AND: {
+      a = _jsonr_filter_eval(f, node->a, final);
+      if(a == _JSONR_FILTER_FALSE) return a;
+      b = _jsonr_filter_eval(f, node->b, final);
+      if(b == _JSONR_FILTER_FALSE) return b;
+      return a == _JSONR_FILTER_TRUE && b == _JSONR_FILTER_TRUE ? _JSONR_FILTER_TRUE : _JSONR_FILTER_UNKNOWN;
+    }
+    case _JSONR_FILTER_OR: {
+      a = _jsonr_filter_eval(f, node->a, final);
+      if(a == _JSONR_FILTER_TRUE) return a;
+      b = _jsonr_filter_eval(f, node->b, final);
+      if(b == _JSONR_FILTER_TRUE) return b;
+      return a == _JSONR_FILTER_FALSE && b == _JSONR_FILTER_FALSE ? _JSONR_FILTER_FALSE : _JSONR_FILTER_UNKNOWN;
+    }
+  }
+  return _JSONR_FILTER_FALSE;
+}
+
+/* JSON_Read_Project_Hit: settle the comparisons on 'path', stop once the filter is decided. */
+static int _jsonr_filter_hit(JSON_Read_Data *j, int path, void *user) {
+  JSON_Read_Filter *f = (JSON_Read_Filter*)user;
+  _JSON_Read_Filter_Value value;
+  const _JSON_Read_Filter_Node *node;
+  int i;
+
+  value.type = jsonr_v_get_type(j);
+  switch(value.type) {
+    case JSONR_V_NUMBER: value.number = jsonr_v_number(j); break;
+    case JSONR_V_STRING: jsonr_v_string(j, &value.string, &value.string_length); break;
+    case JSONR_V_BOOL: value.number = jsonr_v_bool(j); break;
+    case JSONR_V_NULL: jsonr_v_null(j); break;
+    default: jsonr_v_skip_fast(j); break;
+  }
+  if(j->error) return 0;
+
+  for(i = 0; i < f->node_count; i++) {
+    node = &f->nodes[i];
+    if(node->path != path || f->state[i] == _JSONR_FILTER_TRUE) continue;
+
+    if(_jsonr_filter_compare_value(node, &value)) f->state[i] = _JSONR_FILTER_TRUE;
+    else if(!node->any) f->state[i] = _JSONR_FILTER_FALSE;
+  }
+
+  return _jsonr_filter_eval(f, f->root, 0) == _JSONR_FILTER_UNKNOWN;
+}
+
+JSONREAD_DEF int jsonr_filter_record(JSON_Read_Data *j, JSON_Read_Filter *f, unsigned long *begin, unsigned long *end) {
+  _JSON_Read_Project walk;
+  int root = 0;
+  int result;
+
+  if(j->error) return JSONR_FILTER_END;
+
+  _skip_whitespace(j);
+  if(j->c == EOF) return JSONR_FILTER_END;
+
+  *begin = j->offset - 1;
+  memset(f->state, _JSONR_FILTER_UNKNOWN, sizeof(f->state));
+
+  walk.p = &f->projection;
+  walk.hit = _jsonr_filter_hit;
+  walk.user = f;
+  walk.remaining = -1;
+
+  /* Stopped early: the rest of the record doesn't matter. */
+  if(!_jsonr_project_value(j, &walk, &root, 1)) {
+    if(j->error) return JSONR_FILTER_END;
+    jsonr_skip_line(j);
+  }
+
+  _skip_whitespace(j);
+  *end = j->offset - (j->c != EOF);
+
+  result = _jsonr_filter_eval(f, f->root, 1);
+  return result == _JSONR_FILTER_TRUE ? JSONR_FILTER_MATCH : JSONR_FILTER_REJECT;
+}
+
+typedef struct {
+  JSON_Read_Index_Hit hit;
+  void *user;
+  int depth;
+  char path[JSONR_INDEX_PATH_LENGTH];
+} _JSON_Read_Index_Walk;
+
+/* Append "/token" to the first 'length' bytes of 'path', escaping '~' and '/'. Returns the new
+ * length, 0 if it doesn't fit. */
+static unsigned long _jsonr_index_push(char *path, unsigned long length, const char *token, unsigned long token_length) {
+  unsigned long i;
+
+  if(length == JSONR_INDEX_PATH_LENGTH) return 0;
+  path[length++] = '/';
+
+  for(i = 0; i < token_length; i++) {
+    if(token[i] == '~' || token[i] == '/') {
+      if(length + 2 > JSONR_INDEX_PATH_LENGTH) return 0;
+      path[length++] = '~';
+      path[length++] = token[i] == '~' ? '0' : '1';
+    }
+    else {
+      if(length == JSONR_INDEX_PATH_LENGTH) return 0;
+      path[length++] = token[i];
+    }
+  }
+  return length;
+}
+
+static int _jsonr_index_value(JSON_Read_Data *j, _JSON_Read_Index_Walk *walk, unsigned long length, int depth) {
+  char index_token[24];
+  unsigned long begin;
+  unsigned long child;
+  char *key;
+  unsigned long key_length;
+  long index = 0;
+  int type;
+
+  type = jsonr_v_get_type(j);
+  if(j->error) return 0;
+  begin = j->offset - 1;
+
+  if(depth < walk->depth && type == JSONR_V_TABLE) {
+    jsonr_v_table(j) {
+      jsonr_k(j, &key, &key_length);
+      if(j->error) return 0;
+
+      child = _jsonr_index_push(walk->path, length, key, key_length);
+      if(!child) jsonr_v_skip_fast(j);
+      else if(!_jsonr_index_value(j, walk, child, depth + 1)) return 0;
+    }
+  }
+  else if(depth < walk->depth && type == JSONR_V_ARRAY) {
+    jsonr_v_array(j) {
+      child = _jsonr_index_push(walk->path, length, index_token, snprintf(index_token, sizeof(index_token), "%ld", index));
+      if(!child) jsonr_v_skip_fast(j);
+      else if(!_jsonr_index_value(j, walk, child, depth + 1)) return 0;
+      index += 1;
+    }
+  }
+  else {
+    jsonr_v_skip_fast(j);
+  }
+
+  if(j->error) return 0;
+  return walk->hit(walk->path, length, begin, j->value_end, walk->user);
+}
+
+JSONREAD_DEF int jsonr_index_walk(JSON_Read_Data *j, int depth, JSON_Read_Index_Hit hit, void *user) {
+  _JSON_Read_Index_Walk walk;
+
+  if(j->error) return 0;
+
+  walk.hit = hit;
+  walk.user = user;
+  walk.depth = depth;
+  return _jsonr_index_value(j, &walk, 0, 0);
+}
+
+JSONREAD_DEF int jsonr_index_open(JSON_Read_Index *index, FILE *f) {
+  index->f = f;
+  if(fseek(f, 0, SEEK_SET) != 0 || fread(&index->header, sizeof(index->header), 1, f) != 1) return 0;
+  return memcmp(index->header.magic, "JSONRIDX", 8) == 0 && index->header.version == 1;
+}
+
+JSONREAD_DEF int jsonr_index_find(const JSON_Read_Index *index, const char *path, unsigned long path_length, JSON_Read_Index_Entry *entry) {
+  char buf[JSONR_INDEX_PATH_LENGTH];
+  unsigned long long low = 0;
+  unsigned long long high = index->header.count;
+  unsigned long long middle;
+  unsigned long length;
+  int cmp;
+
+  while(low < high) {
+    middle = low + (high - low) / 2;
+
+    if(fseek(index->f, (long)(sizeof(index->header) + middle * sizeof(*entry)), SEEK_SET) != 0) return 0;
+    if(fread(entry, sizeof(*entry), 1, index->f) != 1 || entry->path_length > sizeof(buf)) return 0;
+
+    length = (unsigned long)entry->path_length;
+    if(fseek(index->f, (long)(index->header.paths_offset + entry->path), SEEK_SET) != 0) return 0;
+    if(fread(buf, 1, length, index->f) != length) return 0;
+
+    /* Bytewise, then shorter first. json-index.h sorts the same way. */
+    cmp = memcmp(buf, path, length < path_length ? length : path_length);
+    if(cmp == 0) cmp = (length > path_length) - (length < path_length);
+
+    if(cmp == 0) return 1;
+    if(cmp < 0) low = middle + 1;
+    else high = middle;
+  }
+  return 0;
+}
+
+/* Carry on from 'offset' with nothing begun, as if a new document started there. */
+static int _jsonr_restart_at(JSON_Read_Data *j, unsigned long offset) {
+  if(!_jsonr_jump(j, offset)) return 0;
+
+  j->got_comma = 0;
+  j->key_pending = 0;
+  j->skip_depth = 0;
+#ifdef JSONREAD_PROFILE
+  if(j->profile) _jsonr_profile_close(j, 0, _jsonr_cycles(), j->offset);
+  j->depth = 0;
+#endif
+  return 1;
+}
+
+JSONREAD_DEF int jsonr_seek_path(JSON_Read_Data *j, const JSON_Read_Index *index, const char *path) {
+  JSON_Read_Index_Entry entry;
+  unsigned long length = strlen(path);
+
+  if(j->error) return 0;
+
+  /* The longest indexed prefix: drop a token at a time. */
+  while(!jsonr_index_find(index, path, length, &entry)) {
+    if(length == 0) return 0;
+    while(length > 0 && path[length - 1] != '/') length -= 1;
+    if(length > 0) length -= 1;
+  }
+
+  if(!_jsonr_restart_at(j, (unsigned long)entry.begin)) {
+    _jsonr_fail(j, JSONR_E_SEEK, __func__, 0, 0);
+    return 0;
+  }
+
+  return jsonr_extract(j, path + length);
+}
+
+JSONREAD_DEF JSON_Read_Deferred jsonr_v_defer(JSON_Read_Data *j) {
+  JSON_Read_Deferred d;
+
+  d.type = jsonr_v_get_type(j);
+  d.begin = j->offset - 1;
+  /* Where the cursor was before the first character of the value was consumed. */
+  d.line = j->line;
+  d.column = j->column - 1;
+
+  jsonr_v_skip_fast(j);
+  d.end = j->value_end;
+  if(j->error) d.type = JSONR_V_INVALID;
+  return d;
+}
+
+JSONREAD_DEF int jsonr_defer_open(JSON_Read_Data *j, JSON_Read_Deferred d) {
+  if(j->error || d.type == JSONR_V_INVALID) return 0;
+
+  if(!_jsonr_restart_at(j, d.begin)) {
+    _jsonr_fail(j, JSONR_E_SEEK, __func__, 0, 0);
+    return 0;
+  }
+
+#ifndef JSONREAD_LAZY_POSITION
+  j->line = d.line;
+  j->column = d.column;
+#endif
+  return 1;
+}
+
+#ifdef JSONREAD_POSIX
+typedef struct {
+  unsigned long key; /* offset of the key's opening quote. */
+  unsigned long size; /* of the key and its value. */
+  unsigned long line;
+  unsigned long column;
+} _JSON_Read_Section;
+
+typedef struct {
+  JSON_Read_Data *j;
+  JSON_Read_Section read_section;
+  void *user;
+  pthread_mutex_t mutex; /* guards 'next' and the error in 'j'. */
+  int next;
+  int count;
+  unsigned long error_key; /* the section the error in 'j' came from. */
+  _JSON_Read_Section sections[JSONR_PARALLEL_SECTIONS];
+} _JSON_Read_Parallel;
+
+/* So that jsonr_error_message on 'to' says what it would have said on 'from'. */
+static void _jsonr_copy_error(JSON_Read_Data *to, const JSON_Read_Data *from) {
+  to->error = from->error;
+  to->error_code = from->error_code;
+  to->error_where = from->error_where;
+  to->error_offset = from->error_offset;
+  to->error_expected = from->error_expected;
+  to->error_got = from->error_got;
+  to->error_msg = 0;
+  to->error_msg_length = 0;
+  memcpy(to->error_custom, from->error_custom, sizeof(to->error_custom));
+  memcpy(to->recent, from->recent, sizeof(to->recent));
+  to->recent_begin = from->recent_begin;
+  to->offset = from->offset;
+  to->line = from->line;
+  to->column = from->column;
+#ifdef JSONREAD_LAZY_POSITION
+  to->line_offset = from->line_offset;
+#endif
+}
+
+/* Biggest first, so one big section doesn't start last. */
+static int _jsonr_section_compare(const void *a, const void *b) {
+  const _JSON_Read_Section *sa = (const _JSON_Read_Section*)a;
+  const _JSON_Read_Section *sb = (const _JSON_Read_Section*)b;
+  return (sa->size < sb->size) - (sa->size > sb->size);
+}
+
+static void *_jsonr_parallel_thread(void *arg) {
+  _JSON_Read_Parallel *p = (_JSON_Read_Parallel*)arg;
+  _JSON_Read_Section *section;
+  JSON_Read_Data j;
+  char *key;
+  unsigned long key_length;
+
+  jsonr_init_mem(&j, p->j->block, p->j->block_length);
+
+  for(;;) {
+    pthread_mutex_lock(&p->mutex);
+    section = p->next < p->count && !p->j->error ? &p->sections[p->next++] : 0;
+    pthread_mutex_unlock(&p->mutex);
+    if(!section) break;
+
+    _jsonr_restart_at(&j, section->key);
+#ifndef JSONREAD_LAZY_POSITION
+    j.line = section->line;
+    j.column = section->column;
+#endif
+    jsonr_k(&j, &key, &key_length);
+    if(!j.error) p->read_section(&j, key, key_length, p->user);
+
+    if(j.error) {
+      pthread_mutex_lock(&p->mutex);
+      if(!p->j->error || section->key < p->error_key) {
+        _jsonr_copy_error(p->j, &j);
+        p->error_key = section->key;
+      }
+      pthread_mutex_unlock(&p->mutex);
+      break;
+    }
+  }
+  return 0;
+}
+
+JSONREAD_DEF int jsonr_v_table_parallel(JSON_Read_Data *j, int thread_count, JSON_Read_Section read_section, void *user) {
+  _JSON_Read_Parallel p;
+  _JSON_Read_Section *section;
+  pthread_t threads[JSONR_THREADS];
+  char *key;
+  unsigned long key_length;
+  int more;
+  int started;
+  int i;
+
+  if(j->error) return 0;
+  if(thread_count > JSONR_THREADS) thread_count = JSONR_THREADS;
+
+  /* Nothing to share between threads. */
+  if(j->refill || thread_count <= 1) {
+    jsonr_v_table(j) {
+      jsonr_k(j, &key, &key_length);
+      if(j->error) break;
+      read_section(j, key, key_length, user);
+    }
+    return !j->error;
+  }
+
+  p.j = j;
+  p.read_section = read_section;
+  p.user = user;
+  p.error_key = 0;
+  pthread_mutex_init(&p.mutex, 0);
+
+  more = jsonr_v_table_begin(j);
+  while(more) {
+    /* The next sections: where each key starts and how far its value goes. */
+    p.next = 0;
+    p.count = 0;
+    while(p.count < JSONR_PARALLEL_SECTIONS && (more = jsonr_v_table_can_read(j))) {
+      section = &p.sections[p.count++];
+      section->key = j->offset - 1;
+      section->line = j->line;
+      section->column = j->column - 1;
+      jsonr_k_eat(j);
+      jsonr_v_skip_fast(j);
+      section->size = j->value_end - section->key;
+    }
+    if(j->error) break;
+
+    qsort(p.sections, p.count, sizeof(p.sections[0]), _jsonr_section_compare);
+
+    /* The calling thread reads too. If a thread can't be started the others take its share. */
+    for(started = 1; started < thread_count && started < p.count; started++) {
+      if(pthread_create(&threads[started], 0, _jsonr_parallel_thread, &p) != 0) {
+        break;
+      }
+    }
+    _jsonr_parallel_thread(&p);
+    for(i = 1; i < started; i++) {
+      pthread_join(threads[i], 0);
+    }
+    if(j->error) break;
+  }
+
+  pthread_mutex_destroy(&p.mutex);
+  return !j->error;
+}
+
+/* What a run of bytes does, given whether it starts in a string. */
+typedef struct {
+  int in_string; /* at the end. */
+  long depth; /* at the end, relative to the start. */
+  long lowest; /* the lowest it goes. */
+} _JSON_Read_Scan;
+
+/* An offset whose state is known: in a string or not, how deep in the array, which line. */
+typedef struct {
+  unsigned long offset;
+  int in_string;
+  long depth;
+  unsigned long line;
+  unsigned long column;
+} _JSON_Read_Mark;
+
+typedef struct _JSON_Read_Array _JSON_Read_Array;
+
+typedef struct {
+  _JSON_Read_Array *p;
+  int index;
+  unsigned long begin;
+  unsigned long end;
+
+  /* Scanned on its own: the two guesses and the newlines. */
+  _JSON_Read_Scan scans[2];
+  unsigned long newlines;
+  unsigned long line_begin; /* offset after the last newline, 0 if there's none. */
+
+  /* Read: the elements from the first comma at or after 'begin' (found from the state at 'from')
+   * up to the first comma at or after the next chunk's begin, or up to the ']' of the array. */
+  int active;
+  _JSON_Read_Mark from;
+  unsigned long first;
+  unsigned long stop;
+  unsigned long close;
+  unsigned long close_line;
+  unsigned long close_column;
+} _JSON_Read_Chunk;
+
+struct _JSON_Read_Array {
+  JSON_Read_Data *j;
+  JSON_Read_Element read_element;
+  void *user;
+  int phase; /* 0: scan, 1: read. */
+  int count;
+  pthread_mutex_t mutex; /* guards the error in 'j'. */
+  int error_chunk;
+  _JSON_Read_Chunk chunks[JSONR_THREADS];
+  /* Where the scanned chunks begin, in order. Thinned out when full. */
+  int mark_count;
+  _JSON_Read_Mark marks[JSONR_THREADS*8];
+};
+
+static void _jsonr_scan(const char *data, unsigned long begin, unsigned long end, int in_string, _JSON_Read_Scan *scan) {
+  unsigned long i;
+  long depth = 0;
+  long lowest = 0;
+  int escape = 0;
+  char c;
+
+  for(i = begin; i < end; i++) {
+    c = data[i];
+    if(in_string) {
+      if(escape) escape = 0;
+      else if(c == '\\') escape = 1;
+      else if(c == '"') in_string = 0;
+    }
+    else if(c == '"') in_string = 1;
+    else if(c == '[' || c == '{') depth += 1;
+    else if(c == ']' || c == '}') {
+      depth -= 1;
+      if(depth < lowest) lowest = depth;
+    }
+  }
+
+  scan->in_string = in_string;
+  scan->depth = depth;
+  scan->lowest = lowest;
+}
+
+/* Going from 'from', the first comma between elements of the array at or after 'target', or
+ * _JSONR_SKIP_NONE if there's none before 'end' or the array ends first ('close' is set then).
+ * Counts the lines on the way. */
+static unsigned long _jsonr_resync(const char *data, const _JSON_Read_Mark *from, unsigned long target, unsigned long end,
+                                   unsigned long *line, unsigned long *line_begin, unsigned long *close) {
+  unsigned long i;
+  long depth = from->depth;
+  int in_string = from->in_string;
+  int escape = 0;
+  char c;
+
+  *line = from->line;
+  *line_begin = from->offset - from->column;
+  for(i = from->offset; i < end; i++) {
+    c = data[i];
+    if(c == '\n') {
+      *line += 1;
+      *line_begin = i + 1;
+    }
+    if(in_string) {
+      if(escape) escape = 0;
+      else if(c == '\\') escape = 1;
+      else if(c == '"') in_string = 0;
+    }
+    else if(c == '"') in_string = 1;
+    else if(c == '[' || c == '{') depth += 1;
+    else if(c == ']' || c == '}') {
+      depth -= 1;
+      if(depth == 0) {
+        *close = i;
+        break;
+      }
+    }
+    else if(c == ',' && depth == 1 && i >= target) return i;
+  }
+  return _JSONR_SKIP_NONE;
+}
+
+static void _jsonr_add_mark(_JSON_Read_Array *p, const _JSON_Read_Mark *mark) {
+  int i;
+
+  /* Every other one is still close enough: the windows keep getting bigger. */
+  if(p->mark_count == (int)(sizeof(p->marks)/sizeof(p->marks[0]))) {
+    for(i = 0; i * 2 < p->mark_count; i++) p->marks[i] = p->marks[i * 2];
+    p->mark_count = i;
+  }
+  p->marks[p->mark_count++] = *mark;
+}
+
+static void _jsonr_read_chunk(_JSON_Read_Chunk *chunk) {
+  _JSON_Read_Array *p = chunk->p;
+  const char *data = p->j->block;
+  unsigned long stop = chunk->index + 1 < p->count ? p->chunks[chunk->index + 1].begin : _JSONR_SKIP_NONE;
+  unsigned long line = chunk->from.line;
+  unsigned long line_begin = chunk->from.offset - chunk->from.column;
+  unsigned long start = chunk->begin;
+  unsigned long close;
+  JSON_Read_Data j;
+
+  if(chunk->index > 0) {
+    chunk->first = _jsonr_resync(data, &chunk->from, chunk->begin, chunk->end, &line, &line_begin, &close);
+    if(chunk->first == _JSONR_SKIP_NONE) {
+      chunk->active = 0;
+      return;
+    }
+    start = chunk->first + 1;
+  }
+
+  jsonr_init_mem(&j, data, p->j->block_length);
+  _jsonr_restart_at(&j, start);
+#ifndef JSONREAD_LAZY_POSITION
+  j.line = line;
+  j.column = start - line_begin;
+#endif
+  j.got_comma = 1;
+
+  for(;;) {
+    _skip_whitespace(&j);
+    if(j.error) break;
+
+    /* The end of the array. */
+    if(j.c == ']' && !j.got_comma) {
+      chunk->close = j.offset - 1;
+      chunk->close_line = j.line;
+      chunk->close_column = j.column - 1;
+      break;
+    }
+    if(!jsonr_v_array_can_read(&j)) break;
+
+    p->read_element(&j, chunk->index, p->user);
+    if(j.error) break;
+
+    /* The next thread starts after this comma. */
+    if(j.got_comma && j.offset - 1 >= stop) {
+      chunk->stop = j.offset - 1;
+      break;
+    }
+  }
+
+  if(j.error) {
+    pthread_mutex_lock(&p->mutex);
+    if(!p->j->error || chunk->index < p->error_chunk) {
+      _jsonr_copy_error(p->j, &j);
+      p->error_chunk = chunk->index;
+    }
+    pthread_mutex_unlock(&p->mutex);
+  }
+}
+
+static void *_jsonr_chunk_thread(void *arg) {
+  _JSON_Read_Chunk *chunk = (_JSON_Read_Chunk*)arg;
+  const char *data = chunk->p->j->block;
+  const char *cursor = data + chunk->begin;
+  const char *end = data + chunk->end;
+  const char *newline;
+
+  if(chunk->p->phase == 1) {
+    if(chunk->active) _jsonr_read_chunk(chunk);
+    return 0;
+  }
+
+  _jsonr_scan(data, chunk->begin, chunk->end, 0, &chunk->scans[0]);
+  _jsonr_scan(data, chunk->begin, chunk->end, 1, &chunk->scans[1]);
+
+  chunk->newlines = 0;
+  chunk->line_begin = 0;
+  while((newline = (const char*)memchr(cursor, '\n', end - cursor))) {
+    chunk->newlines += 1;
+    cursor = newline + 1;
+    chunk->line_begin = cursor - data;
+  }
+  return 0;
+}
+
+/* Every chunk on its own thread. Chunk 0 runs on the calling thread. */
+static void _jsonr_run_chunks(_JSON_Read_Array *p) {
+  pthread_t threads[JSONR_THREADS];
+  int started;
+  int i;
+
+  for(started = 1; started < p->count; started++) {
+    if(pthread_create(&threads[started], 0, _jsonr_chunk_thread, &p->chunks[started]) != 0) {
+      break;
+    }
+  }
+  _jsonr_chunk_thread(&p->chunks[0]);
+  for(i = started; i < p->count; i++) {
+    _jsonr_chunk_thread(&p->chunks[i]);
+  }
+  for(i = 1; i < started; i++) {
+    pthread_join(threads[i], 0);
+  }
+}
+
+JSONREAD_DEF int jsonr_v_array_parallel(JSON_Read_Data *j, int thread_count, JSON_Read_Element read_element, void *user) {
+  _JSON_Read_Array p;
+  _JSON_Read_Chunk *chunk;
+  _JSON_Read_Chunk *previous;
+  _JSON_Read_Scan *scan;
+  _JSON_Read_Mark mark;
+  unsigned long begin;
+  unsigned long scanned;
+  unsigned long window;
+  unsigned long close;
+  unsigned long length;
+  unsigned long line;
+  unsigned long line_begin;
+  int m;
+  int i;
+
+  if(!jsonr_v_array_begin(j)) return 0;
+  if(thread_count > JSONR_THREADS) thread_count = JSONR_THREADS;
+
+  if(j->refill || thread_count <= 1) {
+    while(jsonr_v_array_can_read(j)) read_element(j, 0, user);
+    return !j->error;
+  }
+
+  p.j = j;
+  p.read_element = read_element;
+  p.user = user;
+  p.error_chunk = 0;
+  for(i = 0; i < thread_count; i++) {
+    p.chunks[i].p = &p;
+    p.chunks[i].index = i;
+  }
+
+  /* Right after the '['. */
+  begin = j->offset;
+  mark.offset = begin;
+  mark.in_string = 0;
+  mark.depth = 1;
+  mark.line = j->line;
+  mark.column = j->column;
+  p.marks[0] = mark;
+  p.mark_count = 1;
+
+  /* Guess on bigger and bigger windows until the array ends in one. Each window is split evenly,
+   * never right after a backslash: nothing is escaped across a split. */
+  close = _JSONR_SKIP_NONE;
+  p.phase = 0;
+  p.count = thread_count;
+  window = (unsigned long)thread_count * JSONR_PARALLEL_MIN_BYTES;
+  for(scanned = begin; close == _JSONR_SKIP_NONE && scanned < j->block_length; window *= 2) {
+    for(i = 0; i < p.count; i++) {
+      chunk = &p.chunks[i];
+      chunk->begin = i == 0 ? scanned : p.chunks[i - 1].end;
+      chunk->end = scanned + (i == p.count - 1 ? window : window / p.count * (i + 1));
+      if(chunk->end > j->block_length) chunk->end = j->block_length;
+      if(chunk->end < chunk->begin) chunk->end = chunk->begin;
+      while(chunk->end < j->block_length && j->block[chunk->end - 1] == '\\') chunk->end += 1;
+    }
+    _jsonr_run_chunks(&p);
+
+    /* Each chunk starts the way the one before it ended. */
+    for(i = 0; i < p.count; i++) {
+      chunk = &p.chunks[i];
+      scan = &chunk->scans[mark.in_string];
+      if(mark.depth + scan->lowest <= 0) {
+        _jsonr_resync(j->block, &mark, chunk->end, chunk->end, &line, &line_begin, &close);
+        break;
+      }
+      mark.offset = chunk->end;
+      mark.in_string = scan->in_string;
+      mark.depth += scan->depth;
+      mark.column = chunk->newlines ? chunk->end - chunk->line_begin : mark.column + (chunk->end - chunk->begin);
+      mark.line += chunk->newlines;
+      _jsonr_add_mark(&p, &mark);
+    }
+    scanned = p.chunks[p.count - 1].end;
+  }
+
+  /* The guesses don't add up (the array doesn't end) or it's too small to split: read it here. */
+  length = close != _JSONR_SKIP_NONE ? close - begin : 0;
+  if(length / JSONR_PARALLEL_MIN_BYTES < (unsigned long)thread_count) {
+    thread_count = (int)(length / JSONR_PARALLEL_MIN_BYTES);
+  }
+  if(thread_count <= 1) {
+    while(jsonr_v_array_can_read(j)) read_element(j, 0, user);
+    return !j->error;
+  }
+
+  /* Even splits of the array, each read from the closest mark before it. */
+  p.count = thread_count;
+  m = 0;
+  for(i = 0; i < p.count; i++) {
+    chunk = &p.chunks[i];
+    chunk->begin = begin + length / p.count * i;
+    chunk->end = i == p.count - 1 ? close + 1 : begin + length / p.count * (i + 1);
+    while(m + 1 < p.mark_count && p.marks[m + 1].offset <= chunk->begin) m += 1;
+    chunk->from = p.marks[m];
+    chunk->active = 1;
+    chunk->first = _JSONR_SKIP_NONE;
+    chunk->stop = _JSONR_SKIP_NONE;
+    chunk->close = _JSONR_SKIP_NONE;
+  }
+
+  pthread_mutex_init(&p.mutex, 0);
+  p.phase = 1;
+  _jsonr_run_chunks(&p);
+  pthread_mutex_destroy(&p.mutex);
+  if(j->error) return 0;
+
+  /* Every thread has to have stopped where the next one started, and the last one at the end. */
+  previous = &p.chunks[0];
+  for(i = 1; i < p.count; i++) {
+    chunk = &p.chunks[i];
+    if(!chunk->active) continue;
+    if(previous->stop != chunk->first) break;
+    previous = chunk;
+  }
+  if(i < p.count || previous->close != close) {
+    jsonr_error(j, "the elements of the array don't line up after offset %lu.", previous->first == _JSONR_SKIP_NONE ? begin : previous->first);
+    return 0;
+  }
+
+  if(!_jsonr_jump(j, close)) {
+    _jsonr_fail(j, JSONR_E_SEEK, __func__, 0, 0);
+    return 0;
+  }
+#ifndef JSONREAD_LAZY_POSITION
+  j->line = previous->close_line;
+  j->column = previous->close_column;
+#endif
+  j->got_comma = 0;
+  jsonr_v_array_can_read(j);
+  return !j->error;
+}
+#endif
+
+/* JSONWRITE_DEF tells us json-write.h was included. Without it there's nothing to dump with. */
+#if defined(JSONREAD_STATS) && defined(JSONWRITE_DEF)
+JSONREAD_DEF void jsonr_stats_write(struct JSON_Write_Data *out, const JSON_Read_Stats *stats) {
+  JSON_Read_Stats s = *stats;
+
+  jsonw_v_table_begin(out);
+    jsonw_kv_uint(out, "bytes", s.bytes);
+    jsonw_kv_uint(out, "tables", s.tables);
+    jsonw_kv_uint(out, "arrays", s.arrays);
+    jsonw_kv_uint(out, "strings", s.strings);
+    jsonw_kv_uint(out, "numbers", s.numbers);
+    jsonw_kv_uint(out, "bools", s.bools);
+    jsonw_kv_uint(out, "nulls", s.nulls);
+    jsonw_kv_uint(out, "keys", s.keys);
+    jsonw_kv_uint(out, "keys_compared", s.keys_compared);
+    jsonw_kv_uint(out, "keys_matched", s.keys_matched);
+    jsonw_kv_uint(out, "skips", s.skips);
+    jsonw_kv_uint(out, "skipped_bytes", s.skipped_bytes);
+    jsonw_kv_uint(out, "jumps", s.jumps);
+    jsonw_kv_uint(out, "peeks", s.peeks);
+    jsonw_kv_uint(out, "seeks", s.seeks);
+    jsonw_kv_uint(out, "refills", s.refills);
+    jsonw_kv_uint(out, "errors", s.errors);
+  jsonw_v_table_end(out);
+}
+#endif
+
+#undef _JSONR_STAT
+#undef _JSONR_PROFILE_DEPTH
+#undef _JSONR_PROFILE_CLOSE
+#undef _JSONR_SKIP_NONE
 #endif
 
 #ifdef __cplusplus
@@ -1,9 +1,12 @@
 /*
   * json-write.h - public domain - encode json - Justas Dabrila 2021
  
-  * Just write json data to a file stream.
+  * Just write json data to a file stream or a user supplied buffer.
   * Strings are escaped (decoded as ascii. no utf8 decode).
-  * fprintf, fputc, assert are used. 
+  * fputc, fwrite, snprintf, assert are used. 
+  * Define JSONWRITE_POSIX to get the async, parallel, file descriptor and mmap writers. They use
+    pthreads, writev and mmap.
+  * jsonw_init_mem and jsonw_v_array_parallel allocate with realloc. Nothing else does.
   * No explicit allocations (unless the aformentioned cstdlib funcs decide to allocate.)
   * No formatting or indentation.
 
@@ -21,6 +24,9 @@
 
     3. Use the API.
        See either the 'High-level API', 'Low-level API' sections or example files.
+
+  * Define JSONWRITE_STATS to have every JSON_Write_Data count what it writes in json->stats.
+    Dump them with jsonw_stats_write. Compiled out when not defined.
 */
 
 #ifdef __cplusplus
@@ -29,18 +35,174 @@ extern "C" {
 
 #include <stdio.h>
 
+#ifdef JSONWRITE_POSIX
+  #include <pthread.h>
+  #include <sys/uio.h>
+#endif
+
 #define JSONWRITE_DEF extern
 
+#ifndef JSONW_REF_THRESHOLD
+  #define JSONW_REF_THRESHOLD (1024*4)
+#endif
+
+#ifndef JSONW_IOV_COUNT
+  #define JSONW_IOV_COUNT 64
+#endif
+
+#ifndef JSONW_ARRAY_CHUNK_SIZE
+  #define JSONW_ARRAY_CHUNK_SIZE (1024*8)
+#endif
+
+typedef struct JSON_Write_Data JSON_Write_Data;
+
+/* Called when the staging buffer fills up and by jsonw_flush/jsonw_finish. Has to consume
+ * buf[0..buf_used) and reset buf_used (and may point buf at a different block of memory). 'finish'
+ * is set on the last call. Return 0 if the output could not be written. */
+typedef int (*JSON_Write_Flush)(JSON_Write_Data *json, int finish);
+
+/* Optional. Queues 'length' bytes of caller owned memory after what's currently staged in buf,
+ * without copying them. Return 0 if the output could not be written. */
+typedef int (*JSON_Write_Ref)(JSON_Write_Data *json, const char *data, unsigned long length);
+
+#ifdef JSONWRITE_STATS
 typedef struct {
+  unsigned long bytes; /* bytes handed to the FILE/staging buffer/sink. jsonw_init_count writers only have json->counted. */
+  unsigned long keys;
+  unsigned long tables;
+  unsigned long arrays;
+  unsigned long strings;
+  unsigned long numbers;
+  unsigned long bools;
+  unsigned long raws;
+  unsigned long refs; /* values handed to the sink by reference. */
+  unsigned long flushes; /* calls into the sink's flush (or fflush). */
+} JSON_Write_Stats;
+#endif
+
+struct JSON_Write_Data {
   FILE *f;
   long table_stack;
   long array_stack;
   int do_comma;
-} JSON_Write_Data;
+
+  /* Staging buffer. If set, output is collected here and handed off to 'flush' in big blocks
+   * instead of going to 'f' call by call. */
+  char *buf;
+  unsigned long buf_used;
+  unsigned long buf_size;
+  JSON_Write_Flush flush;
+  JSON_Write_Ref ref;
+  void *user;
+
+  int error; /* if set to 1: a flush failed. */
+
+  unsigned long counted; /* bytes measured by a jsonw_init_count writer. */
+
+#ifdef JSONWRITE_STATS
+  JSON_Write_Stats stats;
+#endif
+};
 
 /* Initialize the JSON_Write_Data structure. */
 JSONWRITE_DEF void jsonw_init(JSON_Write_Data *json, FILE *f);
 
+/* Initialize the JSON_Write_Data structure to stage output in 'buf' and hand it to 'flush'
+ * whenever it fills up. 'user' is stored in json->user for the flush function to use. */
+JSONWRITE_DEF void jsonw_init_sink(JSON_Write_Data *json, char *buf, unsigned long buf_size, JSON_Write_Flush flush, void *user);
+
+/* Initialize the JSON_Write_Data structure to write into a realloc'd buffer that doubles in size
+ * when it fills up. The output is in json->buf[0..json->buf_used). free(json->buf) when done.
+ * Returns 0 if the initial allocation failed. */
+JSONWRITE_DEF int jsonw_init_mem(JSON_Write_Data *json, unsigned long initial_size);
+
+/* Initialize the JSON_Write_Data structure to not write anything, only measure how many bytes the
+ * output would take. Numbers and strings are measured without being formatted. The result is in
+ * json->counted. */
+JSONWRITE_DEF void jsonw_init_count(JSON_Write_Data *json);
+
+/* Hand everything written so far to the sink (or fflush the FILE). */
+JSONWRITE_DEF void jsonw_flush(JSON_Write_Data *json);
+
+/* Flush and shut the sink down. Returns 1 if all of the output was written, 0 on error. */
+JSONWRITE_DEF int jsonw_finish(JSON_Write_Data *json);
+
+#ifdef JSONWRITE_POSIX
+typedef struct {
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+
+  FILE *f;
+  char *halves[2];
+  unsigned long half_size;
+
+  /* Block the I/O thread is writing out. Set by the producer, cleared by the I/O thread once
+   * the write is done. */
+  const char *pending;
+  unsigned long pending_length;
+  int quit;
+  int error;
+} JSON_Write_Async;
+
+/* Initialize the JSON_Write_Data structure to write to 'f' from a dedicated I/O thread.
+ * 'mem' is split in two: one half is filled while the other one is being written out. If both
+ * halves are full, the writing thread waits for the I/O thread to catch up, so memory use stays
+ * at mem_size, which has to be at least 2. 'async' has to outlive the writer. Call jsonw_finish to
+ * wait for the I/O thread and get the result. Returns 0 if the thread could not be started. */
+JSONWRITE_DEF int jsonw_init_async(JSON_Write_Data *json, JSON_Write_Async *async, FILE *f, char *mem, unsigned long mem_size);
+
+typedef struct {
+  int fd;
+  /* Staged ranges of buf and referenced caller memory, in output order. */
+  struct iovec iov[JSONW_IOV_COUNT];
+  int iov_count;
+  unsigned long staged_from; /* buf[staged_from..buf_used) isn't in iov yet. */
+} JSON_Write_Fd;
+
+/* Initialize the JSON_Write_Data structure to write to file descriptor 'fd'. Small writes are
+ * staged in 'buf', big values written with the *_ref functions are referenced in place, and both
+ * are written out with writev. 'fd_sink' has to outlive the writer. jsonw_finish doesn't close
+ * 'fd'. */
+JSONWRITE_DEF void jsonw_init_fd(JSON_Write_Data *json, JSON_Write_Fd *fd_sink, int fd, char *buf, unsigned long buf_size);
+
+#ifndef JSONW_MMAP_EXTENT
+  #define JSONW_MMAP_EXTENT (1024*1024*64)
+#endif
+
+typedef struct {
+  int fd;
+  char *window;               /* currently mapped part of the file */
+  unsigned long window_size;
+  unsigned long window_offset; /* file offset of 'window' */
+  unsigned long extent;
+  unsigned long written;
+  char scratch[64]; /* written into after a failure, so the writer can keep going. */
+} JSON_Write_Mmap;
+
+/* Initialize the JSON_Write_Data structure to write straight into a memory mapping of the file at
+ * 'path'. The file is grown and mapped JSONW_MMAP_EXTENT bytes at a time, and jsonw_finish
+ * truncates it to the exact size of the output. 'mmap_sink' has to outlive the writer. Returns 0
+ * if the file could not be created or mapped. */
+JSONWRITE_DEF int jsonw_init_mmap(JSON_Write_Data *json, JSON_Write_Mmap *mmap_sink, const char *path);
+
+#ifndef JSONW_PARALLEL_BATCH
+  #define JSONW_PARALLEL_BATCH (1024*64)
+#endif
+
+/* Writes a single array value. Called from worker threads. */
+typedef void (*JSON_Write_Element)(JSON_Write_Data *json, unsigned long index, void *user);
+
+/* Write an array of 'count' values, where 'write_element' writes the value at 'index' (i.e
+ * jsonw_v_table_begin ... jsonw_v_table_end). Elements are split into rounds of
+ * thread_count*JSONW_PARALLEL_BATCH, each thread writes its part of a round into its own memory
+ * writer and the parts are then written to 'json' in order. If 'json' writes to a FILE with a
+ * file descriptor or to a jsonw_init_fd sink, the parts are written with writev instead of being
+ * copied.
+ * Returns 0 if memory ran out or the output could not be written. */
+JSONWRITE_DEF int jsonw_v_array_parallel(JSON_Write_Data *json, unsigned long count, int thread_count, JSON_Write_Element write_element, void *user);
+#endif
+
 /* ============================================ */
 /* ============== High-level API ============== */
 /* ============================================ */
@@ -63,6 +225,14 @@ JSONWRITE_DEF void jsonw_v_bool(JSON_Write_Data *json, int val);
 JSONWRITE_DEF void jsonw_v_stringlen(JSON_Write_Data *json, const char *val, unsigned long len);
 JSONWRITE_DEF void jsonw_v_string(JSON_Write_Data *json, const char *val);
 
+/* Write a whole array of values (i.e [1,2,3]) in one go. Values are formatted into a
+ * JSONW_ARRAY_CHUNK_SIZE sized stack buffer (at least 319 bytes) which gets written out when it fills up.
+ * 'stride' is the distance in bytes between two consecutive values. Pass 0 if they're tightly
+ * packed or sizeof(Your_Struct) to write a single member out of an array of structs. */
+JSONWRITE_DEF void jsonw_v_int_array(JSON_Write_Data *json, const long *vals, unsigned long count, unsigned long stride);
+JSONWRITE_DEF void jsonw_v_float_array(JSON_Write_Data *json, const double *vals, unsigned long count, unsigned long stride);
+JSONWRITE_DEF void jsonw_v_string_array(JSON_Write_Data *json, const char * const *vals, unsigned long count, unsigned long stride);
+
 /* Write both a key and a value (i.e "key": "my value here"). */
 JSONWRITE_DEF void jsonw_kv_int(JSON_Write_Data *json, const char *key, long val);
 JSONWRITE_DEF void jsonw_kv_uint(JSON_Write_Data *json, const char *key, unsigned long val);
@@ -80,6 +250,22 @@ JSONWRITE_DEF void jsonw_maybe_comma(JSON_Write_Data *json);
 /* Write an escaped string with the given length. */
 JSONWRITE_DEF void jsonw_escaped_string(JSON_Write_Data *json, const char *str, unsigned long length);
 
+/* Write already serialized json as a value. 'val' is written as is. */
+JSONWRITE_DEF void jsonw_v_raw(JSON_Write_Data *json, const char *val, unsigned long len);
+
+/* Same as jsonw_v_raw/jsonw_v_stringlen, but if the sink supports it (see jsonw_init_fd) and the
+ * value is at least JSONW_REF_THRESHOLD bytes long, only a reference to 'val' is kept instead of
+ * copying it. 'val' then has to stay alive and unchanged until the next jsonw_flush/jsonw_finish.
+ * Strings that need escaping are always copied. */
+JSONWRITE_DEF void jsonw_v_raw_ref(JSON_Write_Data *json, const char *val, unsigned long len);
+JSONWRITE_DEF void jsonw_v_stringlen_ref(JSON_Write_Data *json, const char *val, unsigned long len);
+
+#ifdef JSONWRITE_STATS
+/* Write the counters as a table value into 'out'. 'stats' may belong to 'out' itself, the values
+ * are copied before anything is written. Doesn't reset them. */
+JSONWRITE_DEF void jsonw_stats_write(JSON_Write_Data *out, const JSON_Write_Stats *stats);
+#endif
+
 /* ============================================ */
 /* ============== Implementation ============== */
 /* ============================================ */
@@ -87,19 +273,162 @@ JSONWRITE_DEF void jsonw_escaped_string(JSON_Write_Data *json, const char *str,
 #ifdef JSONWRITE_IMPL
 
 #include <assert.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#ifdef JSONWRITE_POSIX
+  #include <limits.h>
+  #include <unistd.h>
+  #include <errno.h>
+  #include <fcntl.h>
+  #include <sys/mman.h>
+#endif
+
+#ifdef JSONWRITE_STATS
+  #define _JSONW_STAT(field, n) (json->stats.field += (n))
+#else
+  #define _JSONW_STAT(field, n)
+#endif
+
 JSONWRITE_DEF void jsonw_init(JSON_Write_Data *json, FILE *f) {
   json->f = f;
   json->table_stack = 0;
   json->array_stack = 0;
   json->do_comma = 0;
+  json->buf = 0;
+  json->buf_used = 0;
+  json->buf_size = 0;
+  json->flush = 0;
+  json->ref = 0;
+  json->user = 0;
+  json->error = 0;
+  json->counted = 0;
+#ifdef JSONWRITE_STATS
+  memset(&json->stats, 0, sizeof(json->stats));
+#endif
+}
+
+JSONWRITE_DEF void jsonw_init_sink(JSON_Write_Data *json, char *buf, unsigned long buf_size, JSON_Write_Flush flush, void *user) {
+  jsonw_init(json, 0);
+  json->buf = buf;
+  json->buf_size = buf_size;
+  json->flush = flush;
+  json->user = user;
+}
+
+static int _jsonw_mem_flush(JSON_Write_Data *json, int finish) {
+  char *grown;
+
+  (void)finish;
+
+  /* Nothing to hand off, the whole output stays in the buffer. Only grow when we're full. */
+  if(json->buf_used < json->buf_size) return 1;
+
+  grown = (char*)realloc(json->buf, json->buf_size * 2);
+  if(!grown) {
+    /* Drop what doesn't fit so writing can go on, the error flag tells the caller. */
+    json->buf_used = 0;
+    return 0;
+  }
+  json->buf = grown;
+  json->buf_size *= 2;
+  return 1;
+}
+
+JSONWRITE_DEF int jsonw_init_mem(JSON_Write_Data *json, unsigned long initial_size) {
+  if(initial_size == 0) initial_size = 256;
+
+  jsonw_init_sink(json, (char*)malloc(initial_size), initial_size, _jsonw_mem_flush, 0);
+  return json->buf != 0;
+}
+
+/* A writer without a FILE and without a staging buffer is a jsonw_init_count writer. */
+#define _JSONW_COUNTING(json) (!(json)->buf && !(json)->f)
+
+JSONWRITE_DEF void jsonw_init_count(JSON_Write_Data *json) {
+  jsonw_init(json, 0);
+}
+
+JSONWRITE_DEF void jsonw_flush(JSON_Write_Data *json) {
+  if(_JSONW_COUNTING(json)) return;
+
+  _JSONW_STAT(flushes, 1);
+  if(json->buf) {
+    if(!json->flush(json, 0)) {
+      json->error = 1;
+    }
+  }
+  else if(fflush(json->f) != 0) {
+    json->error = 1;
+  }
+}
+
+JSONWRITE_DEF int jsonw_finish(JSON_Write_Data *json) {
+  if(_JSONW_COUNTING(json)) return 1;
+
+  _JSONW_STAT(flushes, 1);
+  if(json->buf) {
+    if(!json->flush(json, 1)) {
+      json->error = 1;
+    }
+  }
+  else if(fflush(json->f) != 0 || ferror(json->f)) {
+    json->error = 1;
+  }
+  return !json->error;
+}
+
+static void _jsonw_putc(JSON_Write_Data *json, char c) {
+  if(json->buf) {
+    _JSONW_STAT(bytes, 1);
+    if(json->buf_used == json->buf_size) {
+      jsonw_flush(json);
+    }
+    json->buf[json->buf_used] = c;
+    json->buf_used += 1;
+  }
+  else if(json->f) {
+    _JSONW_STAT(bytes, 1);
+    fputc(c, json->f);
+  }
+  else {
+    json->counted += 1;
+  }
+}
+
+static void _jsonw_write(JSON_Write_Data *json, const char *data, unsigned long length) {
+  unsigned long room;
+
+  if(json->buf) {
+    _JSONW_STAT(bytes, length);
+    while(length > 0) {
+      room = json->buf_size - json->buf_used;
+      if(room == 0) {
+        jsonw_flush(json);
+        continue;
+      }
+      if(room > length) room = length;
+
+      memcpy(json->buf + json->buf_used, data, room);
+      json->buf_used += room;
+      data += room;
+      length -= room;
+    }
+  }
+  else if(json->f) {
+    _JSONW_STAT(bytes, length);
+    fwrite(data, 1, length, json->f);
+  }
+  else {
+    json->counted += length;
+  }
 }
 
 JSONWRITE_DEF void jsonw_maybe_comma(JSON_Write_Data *json) {
   if(json->do_comma) {
-    fputc(',', json->f);
+    _jsonw_putc(json, ',');
     json->do_comma = 0;
   }
 }
@@ -144,15 +473,134 @@ static const char ESCAPE_LUT[256] = {
 
 static const char *ESCAPE_STR[] = { "\\\"", "\\\\", "\\b", "\\f", "\\n", "\\r", "\\t" };
 
+/* Longest possible "%ld" and "%f" outputs, plus one byte for the comma. A byte for the closing
+ * bracket is always kept free as well. */
+#define _JSONW_INT_MAX_CHARS (20+1)
+#define _JSONW_FLOAT_MAX_CHARS (1+309+1+6+1)
+
+/* The array writers need room for at least one value, or they'd never make progress. */
+#if JSONW_ARRAY_CHUNK_SIZE < _JSONW_FLOAT_MAX_CHARS + 1
+  #error "JSONW_ARRAY_CHUNK_SIZE has to fit at least one formatted float (319 bytes) plus the closing bracket"
+#endif
+
+#define _JSONW_STRIDED(type, ptr, stride, i) (*(type const *)((const char *)(ptr) + (stride)*(i)))
+
+static unsigned long _jsonw_format_uint(char *out, unsigned long val) {
+  char digits[20];
+  unsigned long count = 0;
+  unsigned long i;
+
+  do {
+    digits[count++] = '0' + (val % 10);
+    val /= 10;
+  } while(val);
+
+  for(i = 0; i < count; i++) {
+    out[i] = digits[count - 1 - i];
+  }
+  return count;
+}
+
+static unsigned long _jsonw_format_int(char *out, long val) {
+  if(val < 0) {
+    *out = '-';
+    /* negate in unsigned space so LONG_MIN doesn't overflow. */
+    return 1 + _jsonw_format_uint(out + 1, 0ul - (unsigned long)val);
+  }
+  return _jsonw_format_uint(out, (unsigned long)val);
+}
+
+static unsigned long _jsonw_uint_length(unsigned long val) {
+  unsigned long length = 1;
+
+  for(;;) {
+    if(val < 10) return length;
+    if(val < 100) return length + 1;
+    if(val < 1000) return length + 2;
+    if(val < 10000) return length + 3;
+    val /= 10000;
+    length += 4;
+  }
+}
+
+static unsigned long _jsonw_int_length(long val) {
+  if(val < 0) {
+    return 1 + _jsonw_uint_length(0ul - (unsigned long)val);
+  }
+  return _jsonw_uint_length((unsigned long)val);
+}
+
+/* Length of "%f" for 'val': sign, integer digits, a dot and 6 decimals. Falls back to asking
+ * snprintf when rounding the decimals could carry into a new integer digit, or for values that
+ * don't fit in a long (and inf/nan). */
+static unsigned long _jsonw_float_length(double val) {
+  double magnitude;
+  unsigned long integer;
+  unsigned long length;
+
+  if(!(val > -1e15 && val < 1e15)) {
+    return snprintf(0, 0, "%f", val);
+  }
+
+  magnitude = val < 0 ? -val : val;
+  integer = (unsigned long)magnitude;
+  length = _jsonw_uint_length(integer);
+
+  if(magnitude - integer >= 0.999999 && _jsonw_uint_length(integer + 1) != length) {
+    return snprintf(0, 0, "%f", val);
+  }
+
+  return (signbit(val) ? 1 : 0) + length + 1 + 6;
+}
+
+static unsigned long _jsonw_escaped_length(const char *str, unsigned long length) {
+  unsigned long escapes = 0;
+  unsigned long i;
+
+  for(i = 0; i < length; i++) {
+    escapes += ESCAPE_LUT[(unsigned char)str[i]] != 0;
+  }
+  return length + escapes;
+}
+
+/* Escape 'str' into 'out', which has to have room for at least length*2 bytes. */
+static unsigned long _jsonw_escape_into(char *out, const char *str, unsigned long length) {
+  char *cursor = out;
+  const char *escaped;
+  unsigned long i;
+  char escape;
+
+  for(i = 0; i < length; i++) {
+    escape = ESCAPE_LUT[(unsigned char)str[i]];
+    if(escape) {
+      escaped = ESCAPE_STR[escape-1];
+      cursor[0] = escaped[0];
+      cursor[1] = escaped[1];
+      cursor += 2;
+    }
+    else {
+      *cursor = str[i];
+      cursor += 1;
+    }
+  }
+  return cursor - out;
+}
+
 JSONWRITE_DEF void jsonw_escaped_string(JSON_Write_Data *json, const char *str, unsigned long length) {
   int char_it;
   char escape;
 
+  if(_JSONW_COUNTING(json)) {
+    json->counted += _jsonw_escaped_length(str, length);
+    return;
+  }
+
 search:
   for(char_it = 0; char_it < length; char_it++) {
-    escape = ESCAPE_LUT[str[char_it]];
+    escape = ESCAPE_LUT[(unsigned char)str[char_it]];
     if(escape) {
-      fprintf(json->f, "%.*s%s", char_it, str, ESCAPE_STR[escape-1]);
+      _jsonw_write(json, str, char_it);
+      _jsonw_write(json, ESCAPE_STR[escape-1], 2);
       length -= char_it;
       str += char_it;
 
@@ -164,17 +612,18 @@ search:
     }
   }
 
-  fprintf(json->f, "%.*s", (int)length, str);
+  _jsonw_write(json, str, length);
 }
 
 JSONWRITE_DEF void jsonw_klen(JSON_Write_Data *json, const char *str, unsigned long length) {
   jsonw_maybe_comma(json);
+  _JSONW_STAT(keys, 1);
 
-  fputc('\"', json->f);
+  _jsonw_putc(json, '\"');
   jsonw_escaped_string(json, str, length);
 
-  fputc('\"', json->f);
-  fputc(':', json->f);
+  _jsonw_putc(json, '\"');
+  _jsonw_putc(json, ':');
 }
 
 JSONWRITE_DEF void jsonw_k(JSON_Write_Data *json, const char * cstr) {
@@ -185,7 +634,8 @@ JSONWRITE_DEF void jsonw_v_table_begin(JSON_Write_Data *json) {
   jsonw_maybe_comma(json);
 
   json->table_stack++;
-  fputc('{', json->f);
+  _JSONW_STAT(tables, 1);
+  _jsonw_putc(json, '{');
 }
 
 JSONWRITE_DEF void jsonw_v_table_end(JSON_Write_Data *json) {
@@ -193,7 +643,7 @@ JSONWRITE_DEF void jsonw_v_table_end(JSON_Write_Data *json) {
     assert(0 && "Mismatched jsonw_v_table_start and jsonw_v_table_end calls!");
   }
   json->table_stack--;
-  fputc('}', json->f);
+  _jsonw_putc(json, '}');
 
   json->do_comma = 1;
 }
@@ -202,7 +652,8 @@ JSONWRITE_DEF void jsonw_v_array_begin(JSON_Write_Data *json) {
   jsonw_maybe_comma(json);
 
   json->array_stack++;
-  fputc('[', json->f);
+  _JSONW_STAT(arrays, 1);
+  _jsonw_putc(json, '[');
 }
 
 JSONWRITE_DEF void jsonw_v_array_end(JSON_Write_Data *json) {
@@ -210,45 +661,60 @@ JSONWRITE_DEF void jsonw_v_array_end(JSON_Write_Data *json) {
     assert(0 && "Mismatched jsonw_v_array_start and jsonw_v_array_end calls!");
   }
   json->array_stack--;
-  fputc(']', json->f);
+  _jsonw_putc(json, ']');
 
   json->do_comma = 1;
 }
 
 JSONWRITE_DEF void jsonw_v_int(JSON_Write_Data *json, long val) {
+  char buf[_JSONW_INT_MAX_CHARS];
+
   jsonw_maybe_comma(json);
+  _JSONW_STAT(numbers, 1);
 
-  fprintf(json->f, "%ld", val);
+  if(_JSONW_COUNTING(json)) json->counted += _jsonw_int_length(val);
+  else _jsonw_write(json, buf, _jsonw_format_int(buf, val));
   json->do_comma = 1;
 }
 
 JSONWRITE_DEF void jsonw_v_uint(JSON_Write_Data *json, unsigned long val) {
+  char buf[_JSONW_INT_MAX_CHARS];
+
   jsonw_maybe_comma(json);
+  _JSONW_STAT(numbers, 1);
 
-  fprintf(json->f, "%lu", val);
+  if(_JSONW_COUNTING(json)) json->counted += _jsonw_uint_length(val);
+  else _jsonw_write(json, buf, _jsonw_format_uint(buf, val));
   json->do_comma = 1;
 }
 
 JSONWRITE_DEF void jsonw_v_float(JSON_Write_Data *json, double val) {
+  char buf[_JSONW_FLOAT_MAX_CHARS];
+
   jsonw_maybe_comma(json);
+  _JSONW_STAT(numbers, 1);
 
-  fprintf(json->f, "%f", val);
+  if(_JSONW_COUNTING(json)) json->counted += _jsonw_float_length(val);
+  else _jsonw_write(json, buf, snprintf(buf, sizeof(buf), "%f", val));
   json->do_comma = 1;
 }
 
 JSONWRITE_DEF void jsonw_v_bool(JSON_Write_Data *json, int val) {
   jsonw_maybe_comma(json);
+  _JSONW_STAT(bools, 1);
 
-  fprintf(json->f, "%s", val == 0 ? "false" : "true");
+  if(val == 0) _jsonw_write(json, "false", 5);
+  else _jsonw_write(json, "true", 4);
   json->do_comma = 1;
 }
 
 JSONWRITE_DEF void jsonw_v_stringlen(JSON_Write_Data *json, const char *val, unsigned long len) {
   jsonw_maybe_comma(json);
+  _JSONW_STAT(strings, 1);
 
-  fputc('\"', json->f);
+  _jsonw_putc(json, '\"');
   jsonw_escaped_string(json, val, len);
-  fputc('\"', json->f);
+  _jsonw_putc(json, '\"');
 
   json->do_comma = 1;
 }
@@ -257,6 +723,214 @@ JSONWRITE_DEF void jsonw_v_string(JSON_Write_Data *json, const char *val) {
   jsonw_v_stringlen(json, val, strlen(val));
 }
 
+static void _jsonw_write_ref(JSON_Write_Data *json, const char *data, unsigned long length) {
+  if(json->ref && length >= JSONW_REF_THRESHOLD) {
+    _JSONW_STAT(bytes, length);
+    _JSONW_STAT(refs, 1);
+    if(!json->ref(json, data, length)) {
+      json->error = 1;
+    }
+  }
+  else {
+    _jsonw_write(json, data, length);
+  }
+}
+
+JSONWRITE_DEF void jsonw_v_raw(JSON_Write_Data *json, const char *val, unsigned long len) {
+  jsonw_maybe_comma(json);
+  _JSONW_STAT(raws, 1);
+
+  _jsonw_write(json, val, len);
+  json->do_comma = 1;
+}
+
+JSONWRITE_DEF void jsonw_v_raw_ref(JSON_Write_Data *json, const char *val, unsigned long len) {
+  jsonw_maybe_comma(json);
+  _JSONW_STAT(raws, 1);
+
+  _jsonw_write_ref(json, val, len);
+  json->do_comma = 1;
+}
+
+JSONWRITE_DEF void jsonw_v_stringlen_ref(JSON_Write_Data *json, const char *val, unsigned long len) {
+  unsigned long i;
+
+  if(!json->ref || len < JSONW_REF_THRESHOLD) {
+    jsonw_v_stringlen(json, val, len);
+    return;
+  }
+
+  for(i = 0; i < len; i++) {
+    if(ESCAPE_LUT[(unsigned char)val[i]]) {
+      jsonw_v_stringlen(json, val, len);
+      return;
+    }
+  }
+
+  jsonw_maybe_comma(json);
+  _JSONW_STAT(strings, 1);
+
+  _jsonw_putc(json, '\"');
+  _jsonw_write_ref(json, val, len);
+  _jsonw_putc(json, '\"');
+
+  json->do_comma = 1;
+}
+
+JSONWRITE_DEF void jsonw_v_int_array(JSON_Write_Data *json, const long *vals, unsigned long count, unsigned long stride) {
+  char chunk[JSONW_ARRAY_CHUNK_SIZE];
+  unsigned long used = 0;
+  unsigned long batch;
+  unsigned long i = 0;
+
+  if(stride == 0) stride = sizeof(*vals);
+
+  jsonw_maybe_comma(json);
+  _JSONW_STAT(arrays, 1);
+  _JSONW_STAT(numbers, count);
+  _jsonw_putc(json, '[');
+
+  if(_JSONW_COUNTING(json)) {
+    for(; i < count; i++) {
+      json->counted += (i > 0) + _jsonw_int_length(_JSONW_STRIDED(long, vals, stride, i));
+    }
+  }
+
+  while(i < count) {
+    batch = (JSONW_ARRAY_CHUNK_SIZE - 1 - used) / _JSONW_INT_MAX_CHARS;
+    if(batch == 0) {
+      _jsonw_write(json, chunk, used);
+      used = 0;
+      continue;
+    }
+    if(batch > count - i) batch = count - i;
+
+    for(; batch > 0; batch--, i++) {
+      if(i > 0) chunk[used++] = ',';
+      used += _jsonw_format_int(chunk + used, _JSONW_STRIDED(long, vals, stride, i));
+    }
+  }
+
+  chunk[used++] = ']';
+  _jsonw_write(json, chunk, used);
+
+  json->do_comma = 1;
+}
+
+JSONWRITE_DEF void jsonw_v_float_array(JSON_Write_Data *json, const double *vals, unsigned long count, unsigned long stride) {
+  char chunk[JSONW_ARRAY_CHUNK_SIZE];
+  unsigned long used = 0;
+  unsigned long batch;
+  unsigned long i = 0;
+
+  if(stride == 0) stride = sizeof(*vals);
+
+  jsonw_maybe_comma(json);
+  _JSONW_STAT(arrays, 1);
+  _JSONW_STAT(numbers, count);
+  _jsonw_putc(json, '[');
+
+  if(_JSONW_COUNTING(json)) {
+    for(; i < count; i++) {
+      json->counted += (i > 0) + _jsonw_float_length(_JSONW_STRIDED(double, vals, stride, i));
+    }
+  }
+
+  while(i < count) {
+    batch = (JSONW_ARRAY_CHUNK_SIZE - 1 - used) / _JSONW_FLOAT_MAX_CHARS;
+    if(batch == 0) {
+      _jsonw_write(json, chunk, used);
+      used = 0;
+      continue;
+    }
+    if(batch > count - i) batch = count - i;
+
+    for(; batch > 0; batch--, i++) {
+      if(i > 0) chunk[used++] = ',';
+      used += snprintf(chunk + used, JSONW_ARRAY_CHUNK_SIZE - used, "%f", _JSONW_STRIDED(double, vals, stride, i));
+    }
+  }
+
+  chunk[used++] = ']';
+  _jsonw_write(json, chunk, used);
+
+  json->do_comma = 1;
+}
+
+JSONWRITE_DEF void jsonw_v_string_array(JSON_Write_Data *json, const char * const *vals, unsigned long count, unsigned long stride) {
+  char chunk[JSONW_ARRAY_CHUNK_SIZE];
+  unsigned long used = 0;
+  unsigned long needed;
+  unsigned long len;
+  unsigned long i;
+  const char *str;
+
+  if(stride == 0) stride = sizeof(*vals);
+
+  jsonw_maybe_comma(json);
+  _JSONW_STAT(arrays, 1);
+  _JSONW_STAT(strings, count);
+  _jsonw_putc(json, '[');
+
+  for(i = 0; i < count; i++) {
+    str = _JSONW_STRIDED(const char *, vals, stride, i);
+    len = strlen(str);
+
+    if(_JSONW_COUNTING(json)) {
+      json->counted += (i > 0) + 2 + _jsonw_escaped_length(str, len);
+      continue;
+    }
+
+    /* comma, two quotes and every char escaped in the worst case. */
+    needed = 3 + len*2;
+    if(needed > JSONW_ARRAY_CHUNK_SIZE - used) {
+      _jsonw_write(json, chunk, used);
+      used = 0;
+    }
+
+    if(i > 0) chunk[used++] = ',';
+
+    if(needed > JSONW_ARRAY_CHUNK_SIZE) {
+      /* Doesn't fit into a chunk at all, so bypass it. */
+      _jsonw_write(json, chunk, used);
+      used = 0;
+
+      _jsonw_putc(json, '\"');
+      jsonw_escaped_string(json, str, len);
+      _jsonw_putc(json, '\"');
+      continue;
+    }
+
+    chunk[used++] = '\"';
+    used += _jsonw_escape_into(chunk + used, str, len);
+    chunk[used++] = '\"';
+  }
+
+  _jsonw_write(json, chunk, used);
+  _jsonw_putc(json, ']');
+
+  json->do_comma = 1;
+}
+
+#ifdef JSONWRITE_STATS
+JSONWRITE_DEF void jsonw_stats_write(JSON_Write_Data *out, const JSON_Write_Stats *stats) {
+  JSON_Write_Stats s = *stats;
+
+  jsonw_v_table_begin(out);
+    jsonw_kv_uint(out, "bytes", s.bytes);
+    jsonw_kv_uint(out, "keys", s.keys);
+    jsonw_kv_uint(out, "tables", s.tables);
+    jsonw_kv_uint(out, "arrays", s.arrays);
+    jsonw_kv_uint(out, "strings", s.strings);
+    jsonw_kv_uint(out, "numbers", s.numbers);
+    jsonw_kv_uint(out, "bools", s.bools);
+    jsonw_kv_uint(out, "raws", s.raws);
+    jsonw_kv_uint(out, "refs", s.refs);
+    jsonw_kv_uint(out, "flushes", s.flushes);
+  jsonw_v_table_end(out);
+}
+#endif
+
 JSONWRITE_DEF void jsonw_kv_int(JSON_Write_Data *json, const char *key, long val) {
   jsonw_k(json, key);
   jsonw_v_int(json, val);
@@ -281,6 +955,396 @@ JSONWRITE_DEF void jsonw_kv_string(JSON_Write_Data *json, const char *key, const
   jsonw_k(json, key);
   jsonw_v_string(json, val);
 }
+
+#ifdef JSONWRITE_POSIX
+static void *_jsonw_async_thread(void *arg) {
+  JSON_Write_Async *async = (JSON_Write_Async*)arg;
+  const char *data;
+  unsigned long length;
+  int failed;
+
+  pthread_mutex_lock(&async->mutex);
+  for(;;) {
+    while(!async->pending && !async->quit) {
+      pthread_cond_wait(&async->cond, &async->mutex);
+    }
+    if(!async->pending) break;
+
+    data = async->pending;
+    length = async->pending_length;
+    pthread_mutex_unlock(&async->mutex);
+
+    failed = fwrite(data, 1, length, async->f) != length;
+
+    pthread_mutex_lock(&async->mutex);
+    if(failed) async->error = 1;
+    async->pending = 0;
+    pthread_cond_broadcast(&async->cond);
+  }
+  pthread_mutex_unlock(&async->mutex);
+
+  return 0;
+}
+
+static int _jsonw_async_flush(JSON_Write_Data *json, int finish) {
+  JSON_Write_Async *async = (JSON_Write_Async*)json->user;
+  int error;
+
+  pthread_mutex_lock(&async->mutex);
+
+  /* Backpressure: wait until the other half has been written out. */
+  while(async->pending) {
+    pthread_cond_wait(&async->cond, &async->mutex);
+  }
+
+  if(json->buf_used > 0) {
+    async->pending = json->buf;
+    async->pending_length = json->buf_used;
+
+    json->buf = json->buf == async->halves[0] ? async->halves[1] : async->halves[0];
+    json->buf_used = 0;
+  }
+
+  if(finish) {
+    async->quit = 1;
+  }
+  pthread_cond_broadcast(&async->cond);
+  error = async->error;
+  pthread_mutex_unlock(&async->mutex);
+
+  if(finish) {
+    pthread_join(async->thread, 0);
+    pthread_mutex_destroy(&async->mutex);
+    pthread_cond_destroy(&async->cond);
+
+    if(fflush(async->f) != 0 || ferror(async->f)) {
+      async->error = 1;
+    }
+    error = async->error;
+  }
+
+  return !error;
+}
+
+static int _jsonw_async_failed_flush(JSON_Write_Data *json, int finish) {
+  (void)finish;
+  json->buf_used = 0;
+  return 0;
+}
+
+JSONWRITE_DEF int jsonw_init_async(JSON_Write_Data *json, JSON_Write_Async *async, FILE *f, char *mem, unsigned long mem_size) {
+  assert(mem && mem_size >= 2 && "jsonw_init_async needs at least a byte for each half!");
+
+  async->f = f;
+  async->half_size = mem_size / 2;
+  async->halves[0] = mem;
+  async->halves[1] = mem + async->half_size;
+  async->pending = 0;
+  async->pending_length = 0;
+  async->quit = 0;
+  async->error = 0;
+
+  jsonw_init_sink(json, async->halves[0], async->half_size, _jsonw_async_flush, async);
+
+  pthread_mutex_init(&async->mutex, 0);
+  pthread_cond_init(&async->cond, 0);
+
+  if(pthread_create(&async->thread, 0, _jsonw_async_thread, async) != 0) {
+    pthread_mutex_destroy(&async->mutex);
+    pthread_cond_destroy(&async->cond);
+    json->flush = _jsonw_async_failed_flush;
+    json->error = 1;
+    return 0;
+  }
+  return 1;
+}
+
+static int _jsonw_writev_all(int fd, struct iovec *iov, int count) {
+  ssize_t written;
+
+  while(count > 0) {
+    written = writev(fd, iov, count > IOV_MAX ? IOV_MAX : count);
+    if(written < 0) {
+      if(errno == EINTR) continue;
+      return 0;
+    }
+
+    while(count > 0 && (size_t)written >= iov->iov_len) {
+      written -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if(count > 0) {
+      iov->iov_base = (char*)iov->iov_base + written;
+      iov->iov_len -= written;
+    }
+  }
+  return 1;
+}
+
+static void _jsonw_fd_take_staged(JSON_Write_Data *json, JSON_Write_Fd *sink) {
+  if(json->buf_used > sink->staged_from) {
+    sink->iov[sink->iov_count].iov_base = json->buf + sink->staged_from;
+    sink->iov[sink->iov_count].iov_len = json->buf_used - sink->staged_from;
+    sink->iov_count++;
+    sink->staged_from = json->buf_used;
+  }
+}
+
+static int _jsonw_fd_flush(JSON_Write_Data *json, int finish) {
+  JSON_Write_Fd *sink = (JSON_Write_Fd*)json->user;
+  int ok;
+
+  (void)finish;
+
+  _jsonw_fd_take_staged(json, sink);
+  ok = _jsonw_writev_all(sink->fd, sink->iov, sink->iov_count);
+
+  sink->iov_count = 0;
+  sink->staged_from = 0;
+  json->buf_used = 0;
+  return ok;
+}
+
+static int _jsonw_fd_ref(JSON_Write_Data *json, const char *data, unsigned long length) {
+  JSON_Write_Fd *sink = (JSON_Write_Fd*)json->user;
+  int ok = 1;
+
+  /* Room for the staged range in front of the reference, the reference itself and the staged
+   * range the next flush takes. */
+  if(sink->iov_count + 3 > JSONW_IOV_COUNT) {
+    ok = _jsonw_fd_flush(json, 0);
+  }
+
+  _jsonw_fd_take_staged(json, sink);
+  sink->iov[sink->iov_count].iov_base = (void*)data;
+  sink->iov[sink->iov_count].iov_len = length;
+  sink->iov_count++;
+
+  return ok;
+}
+
+JSONWRITE_DEF void jsonw_init_fd(JSON_Write_Data *json, JSON_Write_Fd *fd_sink, int fd, char *buf, unsigned long buf_size) {
+  fd_sink->fd = fd;
+  fd_sink->iov_count = 0;
+  fd_sink->staged_from = 0;
+
+  jsonw_init_sink(json, buf, buf_size, _jsonw_fd_flush, fd_sink);
+  json->ref = _jsonw_fd_ref;
+}
+
+/* Map the next extent of the file. The window always ends on an extent boundary, so the offset
+ * stays page aligned. */
+static int _jsonw_mmap_next_window(JSON_Write_Data *json, JSON_Write_Mmap *sink) {
+  unsigned long offset = sink->window_offset + sink->window_size;
+  int result;
+
+  if(sink->window) {
+    munmap(sink->window, sink->window_size);
+    sink->window = 0;
+  }
+
+  result = posix_fallocate(sink->fd, offset, sink->extent);
+  if(result == ENOSPC) return 0;
+  if(result != 0 && ftruncate(sink->fd, offset + sink->extent) != 0) return 0;
+
+  sink->window = (char*)mmap(0, sink->extent, PROT_READ|PROT_WRITE, MAP_SHARED, sink->fd, offset);
+  if(sink->window == MAP_FAILED) {
+    sink->window = 0;
+    return 0;
+  }
+  sink->window_offset = offset;
+  sink->window_size = sink->extent;
+
+  json->buf = sink->window;
+  json->buf_size = sink->window_size;
+  json->buf_used = 0;
+  return 1;
+}
+
+static int _jsonw_mmap_flush(JSON_Write_Data *json, int finish) {
+  JSON_Write_Mmap *sink = (JSON_Write_Mmap*)json->user;
+  int ok = sink->window != 0;
+
+  if(ok) {
+    /* The bytes are already in the page cache, just move past them. */
+    sink->written += json->buf_used;
+    json->buf += json->buf_used;
+    json->buf_size -= json->buf_used;
+  }
+  json->buf_used = 0;
+
+  if(finish) {
+    if(sink->window) munmap(sink->window, sink->window_size);
+    sink->window = 0;
+
+    if(sink->fd >= 0) {
+      if(ftruncate(sink->fd, sink->written) != 0) ok = 0;
+      if(close(sink->fd) != 0) ok = 0;
+      sink->fd = -1;
+    }
+    return ok;
+  }
+
+  if(ok && json->buf_size == 0) {
+    ok = _jsonw_mmap_next_window(json, sink);
+  }
+  if(!ok) {
+    json->buf = sink->scratch;
+    json->buf_size = sizeof(sink->scratch);
+  }
+  return ok;
+}
+
+JSONWRITE_DEF int jsonw_init_mmap(JSON_Write_Data *json, JSON_Write_Mmap *mmap_sink, const char *path) {
+  unsigned long page = sysconf(_SC_PAGESIZE);
+
+  mmap_sink->fd = open(path, O_RDWR|O_CREAT|O_TRUNC, 0644);
+  mmap_sink->window = 0;
+  mmap_sink->window_size = 0;
+  mmap_sink->window_offset = 0;
+  mmap_sink->extent = (JSONW_MMAP_EXTENT + page - 1) / page * page;
+  mmap_sink->written = 0;
+
+  jsonw_init_sink(json, mmap_sink->scratch, sizeof(mmap_sink->scratch), _jsonw_mmap_flush, mmap_sink);
+
+  if(mmap_sink->fd < 0 || !_jsonw_mmap_next_window(json, mmap_sink)) {
+    json->error = 1;
+    return 0;
+  }
+  return 1;
+}
+
+typedef struct {
+  pthread_t thread;
+  JSON_Write_Data json;
+  unsigned long begin;
+  unsigned long end;
+  JSON_Write_Element write_element;
+  void *user;
+} _JSON_Write_Worker;
+
+static void *_jsonw_worker_thread(void *arg) {
+  _JSON_Write_Worker *worker = (_JSON_Write_Worker*)arg;
+  unsigned long i;
+
+  for(i = worker->begin; i < worker->end; i++) {
+    worker->write_element(&worker->json, i, worker->user);
+  }
+  return 0;
+}
+
+/* Write the fragments of one round as ",frag0,frag1..." (minus the leading comma for the first
+ * round). */
+static void _jsonw_stitch(JSON_Write_Data *json, _JSON_Write_Worker *workers, int worker_count, int first_round) {
+  struct iovec iov[2*64];
+  int iov_count = 0;
+  int fd = -1;
+  int i;
+
+  if(!json->buf && json->f) {
+    fd = fileno(json->f);
+    if(fd >= 0 && fflush(json->f) != 0) json->error = 1;
+  }
+
+  for(i = 0; i < worker_count; i++) {
+    if(workers[i].json.buf_used == 0) continue;
+
+    if(fd >= 0) {
+      _JSONW_STAT(bytes, workers[i].json.buf_used + !first_round);
+      if(!first_round) {
+        iov[iov_count].iov_base = (void*)",";
+        iov[iov_count].iov_len = 1;
+        iov_count++;
+      }
+      iov[iov_count].iov_base = workers[i].json.buf;
+      iov[iov_count].iov_len = workers[i].json.buf_used;
+      iov_count++;
+    }
+    else {
+      if(!first_round) _jsonw_putc(json, ',');
+      _jsonw_write_ref(json, workers[i].json.buf, workers[i].json.buf_used);
+    }
+    first_round = 0;
+  }
+
+  if(fd >= 0 && !_jsonw_writev_all(fd, iov, iov_count)) {
+    json->error = 1;
+  }
+
+  /* The worker buffers get reused by the next round. */
+  if(json->ref) {
+    jsonw_flush(json);
+  }
+}
+
+JSONWRITE_DEF int jsonw_v_array_parallel(JSON_Write_Data *json, unsigned long count, int thread_count, JSON_Write_Element write_element, void *user) {
+  _JSON_Write_Worker workers[64];
+  unsigned long round_begin;
+  unsigned long per_thread;
+  int started;
+  int i;
+
+  if(thread_count < 1) thread_count = 1;
+  if(thread_count > 64) thread_count = 64;
+
+  for(i = 0; i < thread_count; i++) {
+    if(!jsonw_init_mem(&workers[i].json, 1024*64)) {
+      json->error = 1;
+      thread_count = i;
+      break;
+    }
+    workers[i].write_element = write_element;
+    workers[i].user = user;
+  }
+
+  jsonw_v_array_begin(json);
+
+  for(round_begin = 0; round_begin < count && !json->error; ) {
+    per_thread = (count - round_begin + thread_count - 1) / thread_count;
+    if(per_thread > JSONW_PARALLEL_BATCH) per_thread = JSONW_PARALLEL_BATCH;
+
+    for(i = 0; i < thread_count; i++) {
+      workers[i].begin = round_begin;
+      workers[i].end = round_begin + per_thread < count ? round_begin + per_thread : count;
+      round_begin = workers[i].end;
+
+      workers[i].json.buf_used = 0;
+      workers[i].json.do_comma = 0;
+    }
+
+    /* Worker 0 runs on the calling thread. */
+    for(started = 1; started < thread_count; started++) {
+      if(pthread_create(&workers[started].thread, 0, _jsonw_worker_thread, &workers[started]) != 0) {
+        break;
+      }
+    }
+    _jsonw_worker_thread(&workers[0]);
+    for(i = started; i < thread_count; i++) {
+      _jsonw_worker_thread(&workers[i]);
+    }
+    for(i = 1; i < started; i++) {
+      pthread_join(workers[i].thread, 0);
+    }
+
+    for(i = 0; i < thread_count; i++) {
+      if(workers[i].json.error) json->error = 1;
+    }
+
+    _jsonw_stitch(json, workers, thread_count, workers[0].begin == 0);
+  }
+
+  jsonw_v_array_end(json);
+
+  for(i = 0; i < thread_count; i++) {
+    free(workers[i].json.buf);
+  }
+
+  return !json->error;
+}
+#endif
+
+#undef _JSONW_STAT
 #endif
 
 #ifdef __cplusplus
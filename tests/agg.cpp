@@ -0,0 +1,248 @@
+#define JSONREAD_IMPL
+#define JSONWRITE_IMPL
+#define JSONAGG_IMPL
+#define JSONAGG_POSIX
+#include "../json-agg.h"
+#include <assert.h>
+
+const char * data =
+  "{\"host\": \"a\", \"status\": 200, \"latency\": 10, \"user\": \"x\"}\n"
+  "{\"host\": \"b\", \"status\": 500, \"latency\": 1.5, \"user\": \"y\", \"extra\": [1, {\"k\": 2}]}\n"
+  "{\"status\": 500, \"host\": \"a\", \"latency\": 30, \"user\": \"y\"}\n"
+  "\n"
+  "{\"host\": \"a\", \"status\": 200, \"latency\": -5, \"user\": \"x\"}\n"
+  "{\"host\": \"b\", \"status\": 500, \"latency\": 2, \"user\": \"z\"}\n"
+  "{\"status\": 404, \"latency\": \"n/a\"}\n"
+  "{\"host\": \"a\", \"status\": 200, \"latency\": 9000000000000000000, \"user\": 1}\n"
+  "{\"host\": \"a\", \"status\": 200, \"latency\": 9000000000000000000, \"user\": \"1\"}";
+
+typedef struct {
+  char host[16];
+  int status;
+  double count, sum, min, max, users;
+  int sum_is_int;
+  int min_is_null;
+} Group;
+
+static JSON_Agg agg;
+static Group groups[4096];
+static int group_count;
+
+static double number_or_null(JSON_Read_Data *j, int *is_null) {
+  *is_null = jsonr_v_get_type(j) == JSONR_V_NULL;
+  if(*is_null) {
+    jsonr_v_skip(j);
+    return 0;
+  }
+  return jsonr_v_number(j);
+}
+
+/* Parse what jsona_write wrote back into 'groups'. */
+static void read_groups(const char *out, unsigned long length) {
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+  Group *g;
+  char *str;
+  unsigned long len;
+  unsigned long start;
+  int is_null;
+
+  group_count = 0;
+  jsonr_init_mem(j, out, length);
+  jsonr_v_array(j) {
+    g = &groups[group_count++];
+    memset(g, 0, sizeof(*g));
+    jsonr_v_table(j) {
+      if(jsonr_k_case(j, "host")) {
+        if(jsonr_v_get_type(j) == JSONR_V_NULL) { jsonr_v_skip(j); strcpy(g->host, "(null)"); }
+        else { jsonr_v_string(j, &str, &len); memcpy(g->host, str, len); }
+      }
+      else if(jsonr_k_case(j, "status")) g->status = (int)jsonr_v_number(j);
+      else if(jsonr_k_case(j, "count")) g->count = jsonr_v_number(j);
+      else if(jsonr_k_case(j, "sum")) {
+        start = j->offset;
+        g->sum = number_or_null(j, &is_null);
+        g->sum_is_int = !memchr(out + start, '.', j->offset - start);
+      }
+      else if(jsonr_k_case(j, "min")) g->min = number_or_null(j, &g->min_is_null);
+      else if(jsonr_k_case(j, "max")) g->max = number_or_null(j, &is_null);
+      else if(jsonr_k_case(j, "users")) g->users = jsonr_v_number(j);
+      else jsonr_kv_skip(j);
+    }
+  }
+  if(j->error) fprintf(stderr, "%s\n", jsonr_error_message(j, 0));
+  assert(!j->error);
+}
+
+static Group * find(const char *host, int status) {
+  int i;
+  for(i = 0; i < group_count; i++) {
+    if(strcmp(groups[i].host, host) == 0 && groups[i].status == status) return &groups[i];
+  }
+  return 0;
+}
+
+static void write_groups() {
+  JSON_Write_Data wjson;
+  JSON_Write_Data * w = &wjson;
+
+  assert(jsonw_init_mem(w, 64));
+  assert(jsona_write(&agg, w));
+  assert(jsonw_finish(w));
+  read_groups(w->buf, w->buf_used);
+  free(w->buf);
+}
+
+/* Records with g = i % 997 and s = i % 3, so i % 2991 picks the group. */
+static char * generate(unsigned long count, unsigned long *length) {
+  char *buf = (char*)malloc(count * 96);
+  unsigned long used = 0;
+  unsigned long i;
+
+  for(i = 0; i < count; i++) {
+    used += snprintf(buf + used, 96, "{\"u\": %lu, \"g\": \"g%lu\", \"v\": %lu, \"s\": %lu}\n", i % 7, i % 997, i, i % 3);
+  }
+  *length = used;
+  return buf;
+}
+
+static void check_generated(unsigned long count) {
+  unsigned long r, i, n, sum, max;
+  char host[16];
+  Group *g;
+
+  assert(group_count == 2991);
+  for(r = 0; r < 2991; r++) {
+    n = 0;
+    sum = 0;
+    max = 0;
+    for(i = r; i < count; i += 2991) {
+      n += 1;
+      sum += i;
+      max = i;
+    }
+
+    snprintf(host, sizeof(host), "g%lu", r % 997);
+    g = find(host, (int)(r % 3));
+    assert(g);
+    assert(g->count == n && g->sum == sum && g->sum_is_int);
+    assert(g->min == r && g->max == max);
+    /* i % 7 steps by 2991 % 7 = 2, so every record has a different one. */
+    assert(g->users >= n - 1 && g->users <= n + 1);
+  }
+}
+
+int main() {
+  JSON_Agg_Column columns[] = {
+    { JSONA_GROUP, "/host", "host" },
+    { JSONA_GROUP, "/status", "status" },
+    { JSONA_COUNT, 0, "count" },
+    { JSONA_SUM, "/latency", "sum" },
+    { JSONA_MIN, "/latency", "min" },
+    { JSONA_MAX, "/latency", "max" },
+    { JSONA_DISTINCT, "/user", "users" },
+  };
+  JSON_Agg_Column generated[] = {
+    { JSONA_GROUP, "/g", "host" },
+    { JSONA_GROUP, "/s", "status" },
+    { JSONA_COUNT, 0, "count" },
+    { JSONA_SUM, "/v", "sum" },
+    { JSONA_MIN, "/v", "min" },
+    { JSONA_MAX, "/v", "max" },
+    { JSONA_DISTINCT, "/u", "users" },
+  };
+  JSON_Agg_Column bad[] = { { JSONA_SUM, "latency", "sum" } };
+  JSON_Agg_Column twice[] = {
+    { JSONA_GROUP, "/host", "host" },
+    { JSONA_GROUP, "/host", "host_again" },
+  };
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+  unsigned long counts[] = { 1, 2990, 20000 };
+  unsigned long max_groups[] = { 0, 100, 1 };
+  int threads[] = { 1, 3, 8 };
+  unsigned long length;
+  unsigned long c, m;
+  char *records;
+  Group *g;
+  int t;
+
+  assert(jsona_init(&agg, columns, sizeof(columns)/sizeof(columns[0]), 0));
+  jsonr_init_mem(j, data, strlen(data));
+  assert(jsona_feed(&agg, j));
+  assert(agg.records == 8);
+  write_groups();
+  jsona_free(&agg);
+
+  assert(group_count == 4);
+
+  g = find("a", 200);
+  assert(g && g->count == 4 && g->min == -5 && g->users == 3);
+  /* 9e18 + 9e18 doesn't fit in a long. */
+  assert(!g->sum_is_int && g->sum == 5 + 18e18 && g->max == 9e18);
+
+  g = find("a", 500);
+  assert(g && g->count == 1 && g->sum == 30 && g->sum_is_int && g->min == 30 && g->max == 30 && g->users == 1);
+
+  g = find("b", 500);
+  assert(g && g->count == 2 && g->sum == 3.5 && !g->sum_is_int && g->min == 1.5 && g->max == 2 && g->users == 2);
+
+  g = find("(null)", 404);
+  assert(g && g->count == 1 && g->min_is_null && g->users == 0);
+
+  /* Same result no matter how it's split up or spilled. */
+  for(c = 0; c < sizeof(counts)/sizeof(counts[0]); c++) {
+    records = generate(counts[c], &length);
+
+    for(m = 0; m < sizeof(max_groups)/sizeof(max_groups[0]); m++) {
+      for(t = 0; t < (int)(sizeof(threads)/sizeof(threads[0])); t++) {
+        assert(jsona_init(&agg, generated, sizeof(generated)/sizeof(generated[0]), max_groups[m]));
+        if(threads[t] == 1) {
+          jsonr_init_mem(j, records, length);
+          assert(jsona_feed(&agg, j));
+        }
+        else {
+          assert(jsona_feed_mem_parallel(&agg, records, length, threads[t]));
+        }
+        assert(agg.records == counts[c]);
+        write_groups();
+        jsona_free(&agg);
+
+        if(counts[c] == 20000) check_generated(counts[c]);
+        else assert(group_count == (int)counts[c]);
+      }
+    }
+    free(records);
+  }
+
+  /* A broken record stops the feed. */
+  {
+    const char * broken = "{\"host\": \"a\"}\n{\"host\": \"b\", \"status\": tru}\n{\"host\": \"c\"}\n";
+    assert(jsona_init(&agg, columns, sizeof(columns)/sizeof(columns[0]), 0));
+    assert(!jsona_feed_mem_parallel(&agg, broken, strlen(broken), 2));
+    assert(agg.error == JSONA_E_READ && agg.read_error_code == JSONR_E_UNEXPECTED_CHAR);
+    assert(agg.error_offset > strlen("{\"host\": \"a\"}\n") && agg.error_offset < strlen(broken) - strlen("{\"host\": \"c\"}\n"));
+    jsona_free(&agg);
+  }
+
+  assert(!jsona_init(&agg, bad, 1, 0));
+  assert(agg.error == JSONA_E_SPEC);
+
+  /* The same path can't be grouped by twice, its text would go into the key twice. */
+  assert(!jsona_init(&agg, twice, 2, 0));
+  assert(agg.error == JSONA_E_SPEC);
+
+  /* Once, a value as long as JSONA_RECORD_TEXT allows fits. */
+  {
+    static char record[JSONA_RECORD_TEXT + 64];
+    length = snprintf(record, sizeof(record), "{\"host\": \"");
+    memset(record + length, 'h', JSONA_RECORD_TEXT - 200);
+    length += JSONA_RECORD_TEXT - 200;
+    length += snprintf(record + length, sizeof(record) - length, "\", \"status\": \"ok\"}\n");
+    assert(jsona_init(&agg, columns, sizeof(columns)/sizeof(columns[0]), 0));
+    assert(jsona_feed_mem_parallel(&agg, record, length, 1));
+    jsona_free(&agg);
+  }
+
+  return 0;
+}
@@ -0,0 +1,177 @@
+#define JSONREAD_IMPL
+#define JSONREAD_POSIX
+#define JSONR_PARALLEL_MIN_BYTES 64
+#include "../json-read.h"
+#include <assert.h>
+
+#define RECORD_COUNT 300
+
+static char data[1024*128];
+static unsigned long length;
+
+typedef struct {
+  double sums[JSONR_THREADS];
+  int counts[JSONR_THREADS];
+  char seen[RECORD_COUNT];
+} Totals;
+
+/* Pretty printed records whose strings are full of brackets, commas, quotes and backslashes. */
+static void generate(int broken) {
+  int i, k;
+
+  length = snprintf(data, sizeof(data), "{\"version\": 1,\n \"records\": [\n");
+  for(i = 0; i < RECORD_COUNT; i++) {
+    length += snprintf(data + length, sizeof(data) - length,
+      "  {\n    \"id\": %d,\n    \"text\": \"a, [b] {c}, \\\"d\\\" \\\\\",\n    \"slashes\": \"", i);
+    for(k = 0; k < i % 7; k++) length += snprintf(data + length, sizeof(data) - length, "\\\\");
+    length += snprintf(data + length, sizeof(data) - length,
+      "\\\"\",\n    \"items\": [{\"v\": %d}, {\"v\": [%d, \"]\"]}]\n  }%s\n", i, i, i < RECORD_COUNT - 1 ? "," : "");
+    if(broken && i == RECORD_COUNT * 2 / 3) length += snprintf(data + length, sizeof(data) - length, "  tru,\n");
+  }
+  length += snprintf(data + length, sizeof(data) - length, " ],\n \"tail\": 2}");
+  assert(length < sizeof(data));
+}
+
+static void read_record(JSON_Read_Data *j, int thread, void *user) {
+  Totals *totals = (Totals*)user;
+  char *str;
+  unsigned long len;
+  int id = -1;
+
+  jsonr_v_table(j) {
+    jsonr_k(j, &str, &len);
+    if(len == 2 && memcmp(str, "id", 2) == 0) id = (int)jsonr_v_number(j);
+    else if(len == 4 && memcmp(str, "text", 4) == 0) {
+      jsonr_v_string(j, &str, &len);
+      assert(len == 17);
+    }
+    else jsonr_v_skip(j);
+  }
+  if(j->error) return;
+
+  assert(id >= 0 && id < RECORD_COUNT && !totals->seen[id]);
+  totals->seen[id] = 1;
+  totals->sums[thread] += id;
+  totals->counts[thread] += 1;
+}
+
+/* Reads the whole document, the records with 'thread_count' threads. */
+static int read_document(JSON_Read_Data *j, int thread_count, Totals *totals) {
+  char *str;
+  unsigned long len;
+  int tail = 0;
+
+  memset(totals, 0, sizeof(*totals));
+  jsonr_v_table(j) {
+    jsonr_k(j, &str, &len);
+    if(len == 7 && memcmp(str, "records", 7) == 0) jsonr_v_array_parallel(j, thread_count, read_record, totals);
+    else if(len == 4 && memcmp(str, "tail", 4) == 0) tail = (int)jsonr_v_number(j);
+    else jsonr_v_skip(j);
+  }
+  return tail;
+}
+
+static void count(Totals *totals, double *sum, int *elements) {
+  int i;
+
+  *sum = 0;
+  *elements = 0;
+  for(i = 0; i < JSONR_THREADS; i++) {
+    *sum += totals->sums[i];
+    *elements += totals->counts[i];
+  }
+}
+
+int main() {
+  static Totals totals;
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+  JSON_Read_Data sequential;
+  char message[2048];
+  unsigned long line;
+  unsigned long column;
+  double sum;
+  int elements;
+  int threads;
+  FILE *f;
+
+  generate(0);
+
+  jsonr_init_mem(j, data, length);
+  assert(read_document(j, 1, &totals) == 2);
+  assert(!j->error && j->offset == length);
+  line = j->line;
+  column = j->column;
+  count(&totals, &sum, &elements);
+  assert(elements == RECORD_COUNT && sum == RECORD_COUNT * (RECORD_COUNT - 1) / 2);
+
+  /* Splits land everywhere: in strings, after backslashes, deep in records, between them. */
+  for(threads = 2; threads <= JSONR_THREADS; threads++) {
+    jsonr_init_mem(j, data, length);
+    assert(read_document(j, threads, &totals) == 2);
+    assert(!j->error && j->offset == length);
+#ifndef JSONREAD_LAZY_POSITION
+    assert(j->line == line && j->column == column);
+#endif
+    count(&totals, &sum, &elements);
+    assert(elements == RECORD_COUNT && sum == RECORD_COUNT * (RECORD_COUNT - 1) / 2);
+    assert(totals.counts[0] > 0 && totals.counts[1] > 0);
+  }
+
+  /* Other sources are read on the calling thread. */
+  f = fmemopen(data, length, "rb");
+  jsonr_init(j, f);
+  assert(read_document(j, 8, &totals) == 2);
+  assert(!j->error);
+  count(&totals, &sum, &elements);
+  assert(elements == RECORD_COUNT && totals.counts[0] == RECORD_COUNT);
+  fclose(f);
+
+  /* The same error as reading it on one thread. */
+  generate(1);
+  jsonr_init_mem(&sequential, data, length);
+  read_document(&sequential, 1, &totals);
+  assert(sequential.error);
+  snprintf(message, sizeof(message), "%s", jsonr_error_message(&sequential, 0));
+
+  for(threads = 2; threads <= 16; threads++) {
+    jsonr_init_mem(j, data, length);
+    read_document(j, threads, &totals);
+    assert(j->error && j->error_code == sequential.error_code && j->error_offset == sequential.error_offset);
+    assert(strcmp(jsonr_error_message(j, 0), message) == 0);
+  }
+
+  /* An array that doesn't end can't be split, it's read on the calling thread. */
+  generate(0);
+  length = strstr(data, " ],\n \"tail\"") - data;
+  jsonr_init_mem(&sequential, data, length);
+  read_document(&sequential, 1, &totals);
+  assert(sequential.error);
+
+  jsonr_init_mem(j, data, length);
+  read_document(j, 8, &totals);
+  assert(j->error && j->error_code == sequential.error_code && j->error_offset == sequential.error_offset);
+  count(&totals, &sum, &elements);
+  assert(elements == RECORD_COUNT && totals.counts[0] == RECORD_COUNT);
+
+  /* A small array is too small to split, however much comes after it. */
+  length = snprintf(data, sizeof(data), "{\"records\": [{\"id\": 1}, {\"id\": 2}], \"rest\": [");
+  while(length < sizeof(data) - 64) length += snprintf(data + length, sizeof(data) - length, "\"filler\", ");
+  length += snprintf(data + length, sizeof(data) - length, "0], \"tail\": 2}");
+  jsonr_init_mem(j, data, length);
+  assert(read_document(j, 8, &totals) == 2);
+  assert(!j->error);
+  count(&totals, &sum, &elements);
+  assert(elements == 2 && totals.counts[0] == 2);
+
+  /* A trailing comma. */
+  generate(0);
+  memcpy(strstr(data, "\n ],\n \"tail\""), ",", 1);
+  for(threads = 1; threads <= 8; threads++) {
+    jsonr_init_mem(j, data, length);
+    read_document(j, threads, &totals);
+    assert(j->error && j->error_code == JSONR_E_ARRAY_ENDED);
+  }
+
+  return 0;
+}
@@ -0,0 +1,130 @@
+#define JSONREAD_IMPL
+#include "../json-read.h"
+#include <assert.h>
+
+const char * data =
+  "{\n"
+  "  \"meshes\": [{\"name\": \"a\", \"vertices\": [1, 2, 3]}, {\"name\": \"b\", \"vertices\": [4, 5]}],\n"
+  "  \"title\": \"The \\\"Title\\\"\",\n"
+  "  \"broken\": {\"x\": [1, 2, tru]},\n"
+  "  \"count\": 42,\n"
+  "  \"version\": 2\n"
+  "}";
+
+typedef struct {
+  JSON_Read_Deferred meshes;
+  JSON_Read_Deferred title;
+  JSON_Read_Deferred broken;
+  JSON_Read_Deferred count;
+  int version;
+} Header;
+
+static void read_header(JSON_Read_Data *j, Header *h) {
+  jsonr_v_table(j) {
+    if(jsonr_k_case(j, "meshes")) h->meshes = jsonr_v_defer(j);
+    else if(jsonr_k_case(j, "title")) h->title = jsonr_v_defer(j);
+    else if(jsonr_k_case(j, "broken")) h->broken = jsonr_v_defer(j);
+    else if(jsonr_k_case(j, "count")) h->count = jsonr_v_defer(j);
+    else if(jsonr_k_case(j, "version")) h->version = (int)jsonr_v_number(j);
+    else jsonr_kv_skip(j);
+  }
+  assert(!j->error);
+}
+
+static double sum_meshes(JSON_Read_Data *j) {
+  double sum = 0;
+  char *str;
+  unsigned long len;
+
+  jsonr_v_array(j) {
+    jsonr_v_table(j) {
+      if(jsonr_k_case(j, "vertices")) {
+        jsonr_v_array(j) sum += jsonr_v_number(j);
+      }
+      else if(jsonr_k_case(j, "name")) {
+        jsonr_v_string(j, &str, &len);
+        assert(len == 1);
+      }
+      else jsonr_kv_skip(j);
+    }
+  }
+  return sum;
+}
+
+int main() {
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+  JSON_Read_Data other;
+  Header h;
+  FILE *f, *f2;
+  char *str;
+  unsigned long len;
+
+  /* One pass over the document, the sections are only looked at once the version is known. */
+  jsonr_init_mem(j, data, strlen(data));
+  read_header(j, &h);
+  assert(h.version == 2);
+  assert(h.meshes.type == JSONR_V_ARRAY && h.title.type == JSONR_V_STRING && h.count.type == JSONR_V_NUMBER);
+  assert(data[h.meshes.begin] == '[' && data[h.meshes.end - 1] == ']');
+  assert(h.count.end - h.count.begin == 2);
+#ifndef JSONREAD_LAZY_POSITION
+  assert(h.meshes.line == 2 && h.meshes.column == 12);
+#endif
+
+  /* On new contexts over the same memory, in any order. */
+  jsonr_init_mem(&other, data, strlen(data));
+  assert(jsonr_defer_open(&other, h.count));
+  assert(jsonr_v_number(&other) == 42);
+
+  jsonr_init_mem(&other, data, strlen(data));
+  assert(jsonr_defer_open(&other, h.meshes));
+  assert(sum_meshes(&other) == 15);
+  assert(!other.error);
+
+  /* And on the one that deferred them. */
+  assert(jsonr_defer_open(j, h.title));
+  jsonr_v_string(j, &str, &len);
+  assert(len == 11 && memcmp(str, "The \"Title\"", 11) == 0);
+  assert(jsonr_defer_open(j, h.meshes));
+  assert(sum_meshes(j) == 15);
+  assert(!j->error);
+
+  /* Errors in a deferred value point at where they are in the document. */
+  assert(jsonr_defer_open(j, h.broken));
+  jsonr_v_skip(j);
+  assert(j->error && j->error_code == JSONR_E_UNEXPECTED_CHAR);
+  assert(j->error_offset == (unsigned long)(strstr(data, "tru]") - data + 4));
+  jsonr_update_position(j);
+  assert(j->line == 4 && j->column == 29);
+  /* Only what was read since the jump is quoted. */
+  assert(strstr(jsonr_error_message(j, 0), "\n  4 | {\"x\": [1, 2, tru]\n"));
+  assert(!jsonr_defer_open(j, h.count));
+
+  /* A FILE: seek back on the same one, or read with another. */
+  f = fmemopen((void*)data, strlen(data), "rb");
+  f2 = fmemopen((void*)data, strlen(data), "rb");
+  jsonr_init(j, f);
+  read_header(j, &h);
+
+  assert(jsonr_defer_open(j, h.meshes));
+  assert(sum_meshes(j) == 15);
+  assert(!j->error);
+
+  jsonr_init(&other, f2);
+  assert(jsonr_defer_open(&other, h.count));
+  assert(jsonr_v_number(&other) == 42);
+  assert(!other.error);
+  fclose(f);
+  fclose(f2);
+
+  /* Nothing to defer. */
+  jsonr_init_mem(j, "  ", 2);
+  h.count = jsonr_v_defer(j);
+  assert(h.count.type == JSONR_V_INVALID && j->error);
+
+  jsonr_init_mem(&other, data, strlen(data));
+  assert(!jsonr_defer_open(&other, h.count));
+  assert(!other.error);
+
+  return 0;
+}
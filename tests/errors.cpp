@@ -0,0 +1,95 @@
+#define JSONREAD_IMPL
+#include "../json-read.h"
+#include <assert.h>
+#include <unistd.h>
+
+/* A pipe, so nothing can seek back into it. */
+static FILE *open_pipe(const char *data) {
+  int fds[2];
+  assert(pipe(fds) == 0);
+  assert(write(fds[1], data, strlen(data)) == (long)strlen(data));
+  close(fds[1]);
+  return fdopen(fds[0], "rb");
+}
+
+static void parse(JSON_Read_Data *j, const char *data) {
+  FILE *f = open_pipe(data);
+  char *str;
+  unsigned long len;
+
+  jsonr_init(j, f);
+  jsonr_v_table(j) {
+    if(jsonr_k_case(j, "name")) jsonr_v_string(j, &str, &len);
+    else if(jsonr_k_case(j, "alive")) jsonr_v_bool(j);
+    else if(jsonr_k_case(j, "list")) {
+      jsonr_v_array(j) {
+        jsonr_v_number(j);
+      }
+    }
+    else jsonr_kv_skip(j);
+  }
+  fclose(f);
+}
+
+int main() {
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+  const char *msg;
+  unsigned long len;
+
+  parse(j, "{\"name\": \"ok\", \"alive\": true, \"list\": [1, 2]}");
+  assert(!j->error);
+  assert(j->error_code == JSONR_E_NONE);
+  assert(jsonr_error_message(j, &len) == 0 && len == 0);
+
+  parse(j, "{\"name\": \"ok\", \"alive\": yes}");
+  assert(j->error_code == JSONR_E_EXPECTED_BOOL);
+  assert(j->error_got == 'y');
+  assert(strcmp(j->error_where, "jsonr_v_bool") == 0);
+  assert(j->error_msg == 0);
+
+  msg = jsonr_error_message(j, &len);
+  assert(msg && len == strlen(msg));
+  assert(msg == j->error_msg && len == j->error_msg_length);
+  assert(strcmp(msg,
+    "1:25: error: in 'jsonr_v_bool': expected a bool, got 'y'.\n"
+    "  1 | {\"name\": \"ok\", \"alive\": y\n"
+    "                              ^") == 0);
+
+  parse(j, "{\"list\": [1, 2,]}");
+  assert(j->error_code == JSONR_E_ARRAY_ENDED);
+  assert(strcmp(jsonr_error_name(j->error_code), "JSONR_E_ARRAY_ENDED") == 0);
+
+  /* The excerpt starts at the line, and at most 40 bytes back. */
+  parse(j, "{\"list\": [1,\n 2 3]}");
+  assert(j->error_code == JSONR_E_EXPECTED_COMMA);
+  msg = jsonr_error_message(j, 0);
+  assert(strstr(msg, "2:4: error: in 'jsonr_v_array_can_read': expected comma.\n  2 |  2 3\n"));
+
+  parse(j, "{\"name\": \"this one is long enough to not fit into the excerpt\" \"x\"}");
+  assert(j->error_code == JSONR_E_EXPECTED_COMMA);
+  msg = jsonr_error_message(j, 0);
+  assert(strstr(msg, "  1 | ng enough to not fit into the excerpt\" \"\n"));
+
+  parse(j, "{\"name\": \"unterminated");
+  assert(j->error_code == JSONR_E_STRING_EOF);
+
+  parse(j, "{\"list\": [1e5e5]}");
+  assert(j->error_code == JSONR_E_MALFORMED_NUMBER);
+
+  parse(j, "{\"other\": @}");
+  assert(j->error_code == JSONR_E_INVALID_VALUE);
+  assert(j->error_got == '@');
+
+  parse(j, "{\"name\" 1}");
+  assert(j->error_code == JSONR_E_UNEXPECTED_CHAR);
+  assert(j->error_expected == ':' && j->error_got == '1');
+
+  /* Custom errors are formatted right away. */
+  jsonr_init(j, 0);
+  jsonr_error(j, "in '%s': missing key: '%s'.", "load", "x");
+  assert(j->error_code == JSONR_E_CUSTOM);
+  assert(strcmp(jsonr_error_message(j, 0), "1:0: error: in 'load': missing key: 'x'.\n  1 | \n     ^") == 0);
+
+  return 0;
+}
@@ -0,0 +1,150 @@
+#define JSONREAD_IMPL
+#include "../json-read.h"
+#include <assert.h>
+
+const char * data =
+  "{\n"
+  "  \"tricky\": \"}]\\\"{[\",\n"
+  "  \"skipped\": {\"deep\": [[1, 2], {\"x\": \"]\"}], \"more\": null},\n"
+  "  \"a/b\": 1,\n"
+  "  \"m~n\": 2,\n"
+  "  \"text_inline\": [\n"
+  "    {\"id\": 1, \"origin\": {\"x\": 10, \"y\": 11}},\n"
+  "    {\"id\": 2, \"origin\": {\"x\": 20, \"y\": 21}, \"name\": \"second\"},\n"
+  "    true\n"
+  "  ],\n"
+  "  \"last\": \"end\"\n"
+  "}";
+
+/* Hands out 'data' a few bytes at a time. */
+typedef struct {
+  unsigned long pos;
+  unsigned long block_size;
+} Chunks;
+
+static int chunks_refill(JSON_Read_Data *j) {
+  Chunks *c = (Chunks*)j->user;
+  unsigned long remaining = strlen(data) - c->pos;
+  if(remaining == 0) return 0;
+
+  j->block = data + c->pos;
+  j->block_length = remaining < c->block_size ? remaining : c->block_size;
+  c->pos += j->block_length;
+  return 1;
+}
+
+static Chunks chunks;
+
+static void init(JSON_Read_Data *j, unsigned long block_size) {
+  if(block_size == 0) {
+    jsonr_init_mem(j, data, strlen(data));
+  }
+  else {
+    memset(&chunks, 0, sizeof(chunks));
+    chunks.block_size = block_size;
+    jsonr_init_source(j, chunks_refill, 0, &chunks);
+  }
+}
+
+static double number_at(const char *pointer, unsigned long block_size) {
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+  double val;
+
+  init(j, block_size);
+  assert(jsonr_extract(j, pointer));
+  val = jsonr_v_number(j);
+  assert(!j->error);
+  return val;
+}
+
+static int missing(const char *pointer) {
+  JSON_Read_Data json;
+  init(&json, 0);
+  return !jsonr_extract(&json, pointer);
+}
+
+int main() {
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+  char *str;
+  unsigned long len;
+  unsigned long block_size;
+  unsigned long line, column, offset;
+
+  for(block_size = 0; block_size < 20; block_size++) {
+    assert(number_at("/text_inline/0/origin/x", block_size) == 10);
+    assert(number_at("/text_inline/1/origin/y", block_size) == 21);
+    assert(number_at("/text_inline/1/id", block_size) == 2);
+    assert(number_at("/a~1b", block_size) == 1);
+    assert(number_at("/m~0n", block_size) == 2);
+    assert(number_at("/skipped/deep/0/1", block_size) == 2);
+
+    init(j, block_size);
+    assert(jsonr_extract(j, "/last"));
+    jsonr_v_string(j, &str, &len);
+    assert(len == 3 && memcmp(str, "end", 3) == 0);
+
+    init(j, block_size);
+    assert(jsonr_extract(j, "/text_inline/2"));
+    assert(jsonr_v_bool(j));
+  }
+
+  assert(missing("/nope"));
+  assert(missing("/text_inline/3"));
+  assert(missing("/text_inline/01"));
+  assert(missing("/text_inline/x"));
+  assert(missing("/a~1b/0"));
+  assert(missing("/last/0"));
+  assert(missing("no_slash"));
+
+  /* "" is the document itself. */
+  init(j, 0);
+  assert(jsonr_extract(j, ""));
+  assert(jsonr_v_get_type(j) == JSONR_V_TABLE);
+
+  /* Stops right after the value. */
+  init(j, 0);
+  assert(jsonr_extract(j, "/a~1b"));
+  jsonr_v_number(j);
+  assert(j->offset < strlen(data) / 2);
+
+  /* Fast skipping keeps the position as if every byte went through the regular path. */
+  init(j, 0);
+  assert(jsonr_extract(j, "/text_inline/1/name"));
+  line = j->line;
+  column = j->column;
+  offset = j->offset;
+
+  init(j, 0);
+  jsonr_v_table(j) {
+    if(jsonr_k_case(j, "text_inline")) break;
+    jsonr_kv_skip(j);
+  }
+  jsonr_v_array_begin(j);
+  assert(jsonr_v_array_can_read(j));
+  jsonr_v_skip(j);
+  assert(jsonr_v_array_can_read(j));
+  jsonr_v_table(j) {
+    if(jsonr_k_case(j, "name")) break;
+    jsonr_kv_skip(j);
+  }
+  assert(!j->error);
+  assert(j->line == line && j->column == column && j->offset == offset);
+  assert(line == 8 && j->recent[(offset - 1) & (JSONR_RECENT_SIZE-1)] == ':');
+
+  /* Broken input is still noticed when it ends the skipped value. */
+  {
+    const char * broken = "{\"a\": [1, {\"b\": \"x}]}";
+    jsonr_init_mem(j, broken, strlen(broken));
+    assert(!jsonr_extract(j, "/c"));
+    assert(j->error && j->error_code == JSONR_E_STRING_EOF);
+
+    broken = "{\"a\": [1, {\"b\": 2}";
+    jsonr_init_mem(j, broken, strlen(broken));
+    assert(!jsonr_extract(j, "/c"));
+    assert(j->error && j->error_code == JSONR_E_UNEXPECTED_EOF);
+  }
+
+  return 0;
+}
@@ -0,0 +1,89 @@
+#define JSONREAD_IMPL
+#include "../json-read.h"
+#include <assert.h>
+
+const char * data =
+  "{\"status\": 200, \"latency\": 12.5, \"method\": \"GET\", \"path\": \"/a\", \"tags\": [\"x\"]}\n"
+  "{\"status\": 500, \"latency\": 250, \"method\": \"POST\", \"path\": \"/b\", \"tags\": [\"y\", \"slow\"]}\n"
+  "\n"
+  "{\"latency\": 300, \"status\": 500, \"method\": \"GET\", \"ok\": false, \"tags\": [\"z\"]}\n"
+  "{\"status\": 404, \"method\": \"say \\\"hi\\\"\", \"extra\": {\"deep\": [1, 2, {\"x\": null}]}}\n"
+  "{\"status\": 500, \"latency\": 90, \"user\": null}";
+
+/* Which records match, as a string of 0/1. */
+static void matches(const char *expr, const char *expected) {
+  static JSON_Read_Filter filter;
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+  char got[16];
+  unsigned long begin, end;
+  int count = 0;
+  int result;
+
+  assert(jsonr_filter_compile(&filter, expr));
+
+  jsonr_init_mem(j, data, strlen(data));
+  while((result = jsonr_filter_record(j, &filter, &begin, &end))) {
+    got[count++] = result == JSONR_FILTER_MATCH ? '1' : '0';
+    assert(data[begin] == '{');
+    assert(end == strlen(data) || data[end] == '{');
+  }
+  got[count] = 0;
+
+  if(j->error) fprintf(stderr, "'%s' %s got=%s\n", expr, jsonr_error_message(j, 0), got);
+  assert(!j->error);
+  if(strcmp(got, expected) != 0) {
+    printf("'%s': expected %s, got %s\n", expr, expected, got);
+    assert(0);
+  }
+}
+
+int main() {
+  static JSON_Read_Filter filter;
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+  unsigned long begin, end;
+
+  matches("/status == 500", "01101");
+  matches("/status == 500 && /latency > 200", "01100");
+  matches("/status==500&&/latency>=100&&/latency<=260", "01000");
+  matches("/status != 500", "10010");
+  matches("/method == \"GET\"", "10100");
+  matches("/method == \"say \\\"hi\\\"\"", "00010");
+  matches("!(/method == \"GET\")", "01011");
+  matches("/latency < 100 || /method == \"POST\"", "11001");
+  matches("/ok == false || /user == null", "00101");
+  matches("/tags/* == \"slow\"", "01000");
+  matches("/tags/0 == \"x\" || /extra/deep/2/x == null", "10010");
+  matches("/tags/* == \"x\" && /tags/0 == \"x\"", "10000");
+  matches("/tags/* == \"slow\" && /tags/0 == \"y\"", "01000");
+  matches("/missing == 1", "00000");
+  matches("/status > \"500\"", "00000");
+  matches("/status != \"500\"", "00000");
+  matches("/user != 1 || /missing != 1", "00000");
+
+  /* Rejected as soon as "status" is read, the rest of the line is jumped over. */
+  assert(jsonr_filter_compile(&filter, "/status == 404"));
+  jsonr_init_mem(j, data, strlen(data));
+  assert(jsonr_filter_record(j, &filter, &begin, &end) == JSONR_FILTER_REJECT);
+  assert(begin == 0 && data[end - 1] == '\n' && data[end] == '{');
+  assert(j->line == 2);
+
+  assert(!jsonr_filter_compile(&filter, "/status =="));
+  assert(!jsonr_filter_compile(&filter, "(/status == 1"));
+  assert(!jsonr_filter_compile(&filter, "/status ~ 1"));
+  assert(!jsonr_filter_compile(&filter, "/status == 1 junk"));
+  assert(filter.error_offset == strlen("/status == 1 "));
+
+  /* Records that are broken before the result is known are errors. */
+  {
+    const char * broken = "{\"status\": 500}\n{\"latency\": \"unterminated}\n";
+    assert(jsonr_filter_compile(&filter, "/status == 500 && /latency > 1"));
+    jsonr_init_mem(j, broken, strlen(broken));
+    assert(jsonr_filter_record(j, &filter, &begin, &end) == JSONR_FILTER_REJECT);
+    assert(jsonr_filter_record(j, &filter, &begin, &end) == JSONR_FILTER_END);
+    assert(j->error);
+  }
+
+  return 0;
+}
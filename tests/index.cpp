@@ -0,0 +1,140 @@
+#define JSONREAD_IMPL
+#define JSONINDEX_IMPL
+#include "../json-index.h"
+#include <assert.h>
+
+const char * data =
+  "{\n"
+  "  \"version\": 3,\n"
+  "  \"records\": [\n"
+  "    {\"id\": 10, \"name\": \"a\", \"pos\": {\"x\": 1, \"y\": 2}},\n"
+  "    {\"id\": 11, \"name\": \"b\", \"pos\": {\"x\": 3, \"y\": 4}},\n"
+  "    {\"id\": 12, \"name\": \"c\", \"pos\": {\"x\": 5, \"y\": 6}}\n"
+  "  ],\n"
+  "  \"a/b~c\": [true, null, \"s\"],\n"
+  "  \"last\": 1.5\n"
+  "}";
+
+typedef struct {
+  int count;
+  char paths[64][32];
+  unsigned long begin[64];
+  unsigned long end[64];
+} Walked;
+
+static int walked(const char *path, unsigned long path_length, unsigned long begin, unsigned long end, void *user) {
+  Walked *w = (Walked*)user;
+  memcpy(w->paths[w->count], path, path_length);
+  w->paths[w->count][path_length] = 0;
+  w->begin[w->count] = begin;
+  w->end[w->count] = end;
+  w->count += 1;
+  return 1;
+}
+
+static const char * value_at(Walked *w, const char *path, unsigned long *length) {
+  int i;
+  for(i = 0; i < w->count; i++) {
+    if(strcmp(w->paths[i], path) == 0) {
+      *length = w->end[i] - w->begin[i];
+      return data + w->begin[i];
+    }
+  }
+  return 0;
+}
+
+static int value_is(Walked *w, const char *path, const char *expected) {
+  unsigned long length;
+  const char *value = value_at(w, path, &length);
+  return value && length == strlen(expected) && memcmp(value, expected, length) == 0;
+}
+
+int main() {
+  static Walked w;
+  JSON_Read_Index index;
+  JSON_Read_Index_Entry entry;
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+  FILE *f = tmpfile();
+  FILE *idx = tmpfile();
+  char *str;
+  unsigned long len;
+
+  /* Values end right after their last character, whatever comes after them. */
+  jsonr_init_mem(j, data, strlen(data));
+  assert(jsonr_index_walk(j, 1, walked, &w));
+  assert(w.count == 1 + 4);
+  assert(strcmp(w.paths[w.count - 1], "") == 0 && w.begin[w.count - 1] == 0 && w.end[w.count - 1] == strlen(data));
+  assert(value_is(&w, "/version", "3"));
+  assert(value_is(&w, "/last", "1.5"));
+  assert(value_is(&w, "/a~1b~0c", "[true, null, \"s\"]"));
+
+  memset(&w, 0, sizeof(w));
+  jsonr_init_mem(j, data, strlen(data));
+  assert(jsonr_index_walk(j, 3, walked, &w));
+  assert(value_is(&w, "/records/1", "{\"id\": 11, \"name\": \"b\", \"pos\": {\"x\": 3, \"y\": 4}}"));
+  assert(value_is(&w, "/records/2/pos", "{\"x\": 5, \"y\": 6}"));
+  assert(value_is(&w, "/a~1b~0c/1", "null"));
+  assert(value_is(&w, "/a~1b~0c/2", "\"s\""));
+  assert(!value_at(&w, "/records/2/pos/x", &len));
+
+  /* A number at the very end of the input. */
+  memset(&w, 0, sizeof(w));
+  jsonr_init_mem(j, "12", 2);
+  assert(jsonr_index_walk(j, 0, walked, &w));
+  assert(w.count == 1 && w.begin[0] == 0 && w.end[0] == 2);
+
+  fputs(data, f);
+  fflush(f);
+  assert(jsoni_build(f, idx, 2));
+  assert(jsoni_open(&index, f, idx));
+  assert(index.header.depth == 2);
+  assert(index.header.count == 1 + 4 + 3 + 3);
+
+  assert(jsonr_index_find(&index, "/records/1", strlen("/records/1"), &entry));
+  assert(memcmp(data + entry.begin, "{\"id\": 11", 9) == 0 && data[entry.end - 1] == '}');
+  assert(!jsonr_index_find(&index, "/records/1/id", strlen("/records/1/id"), &entry));
+  assert(!jsonr_index_find(&index, "/records/3", strlen("/records/3"), &entry));
+
+  /* Jump around the same file in any order: indexed paths, deeper ones and missing ones. */
+  jsonr_init(j, f);
+  assert(jsonr_seek_path(j, &index, "/records/2/name"));
+  jsonr_v_string(j, &str, &len);
+  assert(len == 1 && str[0] == 'c');
+
+  assert(jsonr_seek_path(j, &index, "/records/0/pos/y"));
+  assert(jsonr_v_number(j) == 2);
+
+  assert(jsonr_seek_path(j, &index, "/version"));
+  assert(jsonr_v_number(j) == 3);
+
+  assert(jsonr_seek_path(j, &index, "/a~1b~0c/2"));
+  jsonr_v_string(j, &str, &len);
+  assert(len == 1 && str[0] == 's');
+
+  assert(!jsonr_seek_path(j, &index, "/records/1/missing"));
+  assert(!j->error);
+  assert(!jsonr_seek_path(j, &index, "/nope"));
+
+  assert(jsonr_seek_path(j, &index, "/last"));
+  assert(jsonr_v_number(j) == 1.5);
+  assert(!j->error);
+
+  /* The same index works on the same bytes in memory. */
+  jsonr_init_mem(j, data, strlen(data));
+  assert(jsonr_seek_path(j, &index, "/records/1/pos/x"));
+  assert(jsonr_v_number(j) == 3);
+
+  /* Stale once the file changes. */
+  fseek(f, 0, SEEK_END);
+  fputs("\n", f);
+  fflush(f);
+  assert(!jsoni_open(&index, f, idx));
+
+  /* Not an index. */
+  assert(!jsonr_index_open(&index, f));
+
+  fclose(f);
+  fclose(idx);
+  return 0;
+}
@@ -0,0 +1,80 @@
+#define JSONREAD_IMPL
+#define JSONREAD_LAZY_POSITION
+#include "../json-read.h"
+#include <assert.h>
+
+/* Parses 'data' as a table of numbers/bools/arrays of numbers and returns where it stopped. */
+static void parse(const char *data, unsigned long *line, unsigned long *column) {
+  FILE *f = fmemopen((void*)data, strlen(data), "rb");
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+  char *key;
+  unsigned long len;
+
+  jsonr_init(j, f);
+  jsonr_v_table(j) {
+    jsonr_k(j, &key, &len);
+    if(jsonr_v_get_type(j) == JSONR_V_BOOL) {
+      jsonr_v_bool(j);
+    }
+    else if(jsonr_v_get_type(j) == JSONR_V_ARRAY) {
+      jsonr_v_array(j) {
+        jsonr_v_number(j);
+      }
+    }
+    else {
+      jsonr_v_number(j);
+    }
+  }
+  assert(j->error);
+
+  jsonr_update_position(j);
+  *line = j->line;
+  *column = j->column;
+  fclose(f);
+}
+
+int main() {
+  unsigned long line, column;
+
+  parse("{\n  \"a\": 1,\n  \"b\": tru\n}", &line, &column);
+  assert(line == 4 && column == 0);
+
+  parse("{\"a\": [1, 2,]}", &line, &column);
+  assert(line == 1 && column == 13);
+
+  parse("{\n\n\n  \"a\": [1,\n 2 3]}", &line, &column);
+  assert(line == 5 && column == 4);
+
+  /* Updating as we go, and after a peek took us back. */
+  {
+    const char *data = "{\n  \"a\": 1,\n  \"b\": 2\n}";
+    FILE *f = fmemopen((void*)data, strlen(data), "rb");
+    JSON_Read_Data json;
+    JSON_Read_Data * j = &json;
+    JSON_Read_Peek peek;
+
+    jsonr_init(j, f);
+    jsonr_v_table_begin(j);
+    assert(jsonr_v_table_can_read(j));
+    assert(jsonr_k_case(j, "a"));
+    jsonr_update_position(j);
+    assert(j->line == 2 && j->column == 6);
+
+    peek = jsonr_peek_begin(j);
+    jsonr_v_number(j);
+    assert(jsonr_v_table_can_read(j));
+    assert(jsonr_k_case(j, "b"));
+    jsonr_update_position(j);
+    assert(j->line == 3 && j->column == 6);
+    jsonr_peek_end(j, peek);
+
+    jsonr_update_position(j);
+    assert(j->line == 2 && j->column == 6);
+    assert(jsonr_v_number(j) == 1);
+    assert(!j->error);
+    fclose(f);
+  }
+
+  return 0;
+}
@@ -0,0 +1,44 @@
+#define JSONREAD_IMPL
+#include "../json-read.h"
+#include <assert.h>
+
+const char * data = "{\"yes\": true, \"no\":false , \"nothing\": null, \"list\": [true,false,null], \"after\": 1}";
+
+int main() {
+  auto * f = fmemopen((void*)data, strlen(data), "rb");
+
+  JSON_Read_Data json;
+  auto * j = &json;
+  jsonr_init(j, f);
+
+  int got_after = 0;
+
+  jsonr_v_table(j) {
+    if(jsonr_k_case(j, "yes")) {
+      assert(jsonr_v_bool(j) == 1);
+    }
+    else if(jsonr_k_case(j, "no")) {
+      assert(jsonr_v_bool(j) == 0);
+    }
+    else if(jsonr_k_case(j, "nothing")) {
+      assert(jsonr_v_get_type(j) == JSONR_V_NULL);
+      jsonr_v_skip(j);
+    }
+    else if(jsonr_k_case(j, "after")) {
+      assert(jsonr_v_number(j) == 1);
+      got_after = 1;
+    }
+    else {
+      jsonr_kv_skip(j);
+    }
+  }
+
+  if(j->error) {
+    printf("%s\n", jsonr_error_message(j, 0));
+    assert(false);
+    return 1;
+  }
+
+  assert(got_after);
+  return 0;
+}
@@ -0,0 +1,190 @@
+/*
+  Writes and then parses a few MB of json through FILE streams whose I/O is counted, with malloc &
+  friends interposed. Fails if the hot paths allocate, if plain forward parsing seeks, or if the
+  stream is read/written in more pieces than its buffer size accounts for.
+*/
+#define JSONREAD_IMPL
+#define JSONWRITE_IMPL
+#include "../json-read.h"
+#include "../json-write.h"
+#include <assert.h>
+
+#define STREAM_BUFFER_SIZE (64*1024)
+
+static int counting;
+static unsigned long allocs;
+
+extern "C" {
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+void *malloc(size_t size) { if(counting) allocs++; return __libc_malloc(size); }
+void *calloc(size_t count, size_t size) { if(counting) allocs++; return __libc_calloc(count, size); }
+void *realloc(void *ptr, size_t size) { if(counting) allocs++; return __libc_realloc(ptr, size); }
+void free(void *ptr) { if(counting && ptr) allocs++; __libc_free(ptr); }
+}
+
+/* A memory backed stream that counts the calls the FILE layer makes into it. Every call stands in
+ * for a read/write/lseek syscall on a real fd. */
+typedef struct {
+  char * data;
+  unsigned long size;
+  unsigned long pos;
+  unsigned long reads, writes, seeks;
+} Stream;
+
+static ssize_t stream_read(void *cookie, char *buf, size_t size) {
+  Stream *s = (Stream*)cookie;
+  if(size > s->size - s->pos) size = s->size - s->pos;
+  memcpy(buf, s->data + s->pos, size);
+  s->pos += size;
+  s->reads++;
+  return size;
+}
+
+static ssize_t stream_write(void *cookie, const char *buf, size_t size) {
+  Stream *s = (Stream*)cookie;
+  if(size > s->size - s->pos) return -1;
+  memcpy(s->data + s->pos, buf, size);
+  s->pos += size;
+  s->writes++;
+  return size;
+}
+
+static int stream_seek(void *cookie, off64_t *offset, int whence) {
+  Stream *s = (Stream*)cookie;
+  if(whence == SEEK_SET) s->pos = *offset;
+  else if(whence == SEEK_CUR) s->pos += *offset;
+  else s->pos = s->size + *offset;
+  *offset = s->pos;
+  s->seeks++;
+  return 0;
+}
+
+static FILE *stream_open(Stream *s, const char *mode, char *buffer) {
+  cookie_io_functions_t io = { stream_read, stream_write, stream_seek, 0 };
+  FILE *f = fopencookie(s, mode, io);
+  assert(f);
+  assert(setvbuf(f, buffer, _IOFBF, STREAM_BUFFER_SIZE) == 0);
+  return f;
+}
+
+static const int entity_count = 40000;
+
+static void write_document(JSON_Write_Data *j) {
+  int i;
+
+  jsonw_v_table_begin(j);
+    jsonw_kv_int(j, "version", 3);
+
+    jsonw_k(j, "entities");
+    jsonw_v_array_begin(j);
+    for(i = 0; i < entity_count; i++) {
+      jsonw_v_table_begin(j);
+        jsonw_kv_int(j, "id", i);
+        jsonw_kv_string(j, "name", "entity \"with\" escapes\n");
+        jsonw_kv_float(j, "x", i * 0.25);
+        jsonw_kv_float(j, "y", i * -1.5e-3);
+        jsonw_kv_bool(j, "alive", i & 1);
+        jsonw_k(j, "tags");
+        jsonw_v_array_begin(j);
+          jsonw_v_string(j, "a");
+          jsonw_v_int(j, 0);
+        jsonw_v_array_end(j);
+        jsonw_kv_int(j, "unknown", -i);
+      jsonw_v_table_end(j);
+    }
+    jsonw_v_array_end(j);
+  jsonw_v_table_end(j);
+}
+
+static int read_document(JSON_Read_Data *j) {
+  int count = 0;
+  double id_sum = 0;
+  char * str;
+  unsigned long len;
+
+  jsonr_v_table(j) {
+    if(jsonr_k_case(j, "version")) {
+      assert(jsonr_v_number(j) == 3);
+    }
+    else if(jsonr_k_case(j, "entities")) {
+      jsonr_v_array(j) {
+        jsonr_v_table(j) {
+          if(jsonr_k_case(j, "id")) id_sum += jsonr_v_number(j);
+          else if(jsonr_k_case(j, "name")) jsonr_v_string(j, &str, &len);
+          else if(jsonr_k_case(j, "x")) jsonr_v_number(j);
+          else if(jsonr_k_case(j, "y")) jsonr_v_number(j);
+          else if(jsonr_k_case(j, "alive")) jsonr_v_bool(j);
+          else jsonr_kv_skip(j);
+        }
+        count++;
+      }
+    }
+    else {
+      jsonr_kv_skip(j);
+    }
+  }
+
+  assert(id_sum == (double)entity_count * (entity_count - 1) / 2);
+  return count;
+}
+
+static void report(const char *name, Stream *s) {
+  double mb = s->pos / (1024.0 * 1024.0);
+  printf("%-6s %6.2f MB  allocs/MB: %.1f  reads/MB: %.1f  writes/MB: %.1f  seeks/MB: %.1f\n",
+    name, mb, allocs / mb, s->reads / mb, s->writes / mb, s->seeks / mb);
+}
+
+int main() {
+  static char data[8*1024*1024];
+  static char write_buffer[STREAM_BUFFER_SIZE];
+  static char read_buffer[STREAM_BUFFER_SIZE];
+  unsigned long max_calls;
+  Stream out = { data, sizeof(data), 0, 0, 0, 0 };
+  Stream in = { data, 0, 0, 0, 0, 0 };
+  FILE *f;
+
+  JSON_Write_Data wjson;
+  JSON_Read_Data rjson;
+
+  /* Opening and closing the streams may allocate, only the work in between is counted. */
+  f = stream_open(&out, "w", write_buffer);
+  allocs = 0;
+  counting = 1;
+  jsonw_init(&wjson, f);
+  write_document(&wjson);
+  assert(jsonw_finish(&wjson));
+  counting = 0;
+  report("write", &out);
+  fclose(f);
+
+  max_calls = out.pos / STREAM_BUFFER_SIZE + 2;
+  assert(allocs == 0);
+  assert(out.seeks == 0);
+  assert(out.writes <= max_calls);
+
+  in.size = out.pos;
+  f = stream_open(&in, "r", read_buffer);
+  allocs = 0;
+  counting = 1;
+  jsonr_init(&rjson, f);
+  assert(read_document(&rjson) == entity_count);
+  counting = 0;
+  if(rjson.error) {
+    printf("%s\n", jsonr_error_message(&rjson, 0));
+    assert(false);
+    return 1;
+  }
+  report("read", &in);
+  fclose(f);
+
+  max_calls = in.size / STREAM_BUFFER_SIZE + 2;
+  assert(allocs == 0);
+  assert(in.seeks == 0);
+  assert(in.reads <= max_calls);
+
+  return 0;
+}
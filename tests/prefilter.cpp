@@ -0,0 +1,149 @@
+#define JSONREAD_IMPL
+#include "../json-read.h"
+#include <assert.h>
+
+const char * data =
+  "{\"status\": 200, \"latency\": 12, \"msg\": \"ok\"}\n"
+  "{\"status\": 500, \"latency\": 250, \"msg\": \"timeout talking to db\"}\n"
+  "\n"
+  "{\"status\": 200, \"latency\": 500, \"msg\": \"slow\"}\n"
+  "{\"status\": 500, \"latency\": 30, \"msg\": \"timeout\"}\n"
+  "{\"msg\": \"status 500 timeout, but no status key\"}";
+
+typedef struct {
+  unsigned long pos;
+  unsigned long block_size;
+  char *copy;
+} Chunks;
+
+static int chunks_refill(JSON_Read_Data *j) {
+  Chunks *c = (Chunks*)j->user;
+  unsigned long remaining = strlen(data) - c->pos;
+  if(remaining == 0) return 0;
+
+  j->block = data + c->pos;
+  j->block_length = remaining < c->block_size ? remaining : c->block_size;
+  c->pos += j->block_length;
+  return 1;
+}
+
+/* Blocks that end right after the first byte of every line. Each one is a fresh copy, the
+ * previous one is freed when the next comes in. */
+static int first_byte_refill(JSON_Read_Data *j) {
+  Chunks *c = (Chunks*)j->user;
+  unsigned long length = strlen(data);
+  unsigned long end = c->pos;
+
+  free(c->copy);
+  c->copy = 0;
+  if(c->pos == length) return 0;
+
+  while(end < length && (end == c->pos || data[end - 1] != '\n')) end += 1;
+  if(end < length) end += 1;
+
+  c->copy = (char*)malloc(end - c->pos);
+  memcpy(c->copy, data + c->pos, end - c->pos);
+  j->block = c->copy;
+  j->block_length = end - c->pos;
+  c->pos = end;
+  return 1;
+}
+
+static int naive_contains(const char *hay, unsigned long length, const char *needle) {
+  unsigned long needle_length = strlen(needle);
+  unsigned long i;
+
+  for(i = 0; i + needle_length <= length; i++) {
+    if(memcmp(hay + i, needle, needle_length) == 0) return 1;
+  }
+  return 0;
+}
+
+int main() {
+  static JSON_Read_Filter filter;
+  static char hay[96];
+  JSON_Read_Prefilter prefilter;
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+  Chunks chunks;
+  const char *needles[] = { "a", "ab", "ba", "aab", "abba", "aaaaaaaaaaaaaaaaab", "bbbbbbbbbbbbbbbbbbbbbb" };
+  unsigned long length, begin, end;
+  unsigned long block_size;
+  unsigned long seed = 1;
+  unsigned long i;
+  int n, round;
+  int parsed, matched;
+
+  /* Every needle length against every haystack length, with matches at every alignment. */
+  for(round = 0; round < 2000; round++) {
+    length = round % sizeof(hay);
+    for(i = 0; i < length; i++) {
+      seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+      hay[i] = (seed >> 60) < 13 ? 'a' : 'b';
+    }
+
+    for(n = 0; n < (int)(sizeof(needles)/sizeof(needles[0])); n++) {
+      jsonr_prefilter_init(&prefilter);
+      assert(jsonr_prefilter_add(&prefilter, needles[n]));
+      assert(jsonr_prefilter_match(&prefilter, hay, length) == naive_contains(hay, length, needles[n]));
+    }
+  }
+
+  jsonr_prefilter_init(&prefilter);
+  assert(!jsonr_prefilter_add(&prefilter, ""));
+  assert(jsonr_prefilter_match(&prefilter, "", 0));
+  assert(jsonr_prefilter_add(&prefilter, "timeout"));
+  assert(jsonr_prefilter_add(&prefilter, "500"));
+  assert(jsonr_filter_compile(&filter, "/status == 500 && /latency > 100"));
+
+  /* Only the lines that have both needles get parsed, the filter has the final say. */
+  for(block_size = 1; block_size < 300; block_size += block_size < 20 ? 1 : 50) {
+    memset(&chunks, 0, sizeof(chunks));
+    chunks.block_size = block_size;
+    jsonr_init_source(j, chunks_refill, 0, &chunks);
+
+    parsed = 0;
+    matched = 0;
+    while(jsonr_prefilter_skip(j, &prefilter)) {
+      parsed += 1;
+      if(jsonr_filter_record(j, &filter, &begin, &end) == JSONR_FILTER_MATCH) {
+        matched += 1;
+        assert(memcmp(data + begin, "{\"status\": 500, \"latency\": 250", 30) == 0);
+      }
+    }
+
+    assert(!j->error);
+    assert(matched == 1);
+    assert(parsed >= 3);
+    if(block_size > strlen(data)) assert(parsed == 3);
+  }
+
+  /* The next line's first byte is the last one of the block, already in j->c. */
+  memset(&chunks, 0, sizeof(chunks));
+  jsonr_init_source(j, first_byte_refill, 0, &chunks);
+  parsed = 0;
+  matched = 0;
+  while(jsonr_prefilter_skip(j, &prefilter)) {
+    parsed += 1;
+    if(jsonr_filter_record(j, &filter, &begin, &end) == JSONR_FILTER_MATCH) matched += 1;
+  }
+  assert(!j->error);
+  assert(matched == 1);
+  assert(parsed >= 3);
+  free(chunks.copy);
+
+  /* Lines are rejected from memory without going through the parser. */
+  jsonr_init_mem(j, data, strlen(data));
+  assert(jsonr_prefilter_skip(j, &prefilter));
+  assert(j->line == 2 && j->column == 0);
+  assert(jsonr_filter_record(j, &filter, &begin, &end) == JSONR_FILTER_MATCH);
+  assert(jsonr_prefilter_skip(j, &prefilter));
+  assert(j->line == 5);
+  assert(jsonr_filter_record(j, &filter, &begin, &end) == JSONR_FILTER_REJECT);
+  assert(jsonr_prefilter_skip(j, &prefilter));
+  assert(jsonr_filter_record(j, &filter, &begin, &end) == JSONR_FILTER_REJECT);
+  assert(!jsonr_prefilter_skip(j, &prefilter));
+  assert(!j->error);
+
+  return 0;
+}
@@ -0,0 +1,94 @@
+#define JSONREAD_IMPL
+#define JSONREAD_PROFILE
+#include "../json-read.h"
+#include <assert.h>
+
+const char * data = "{\"version\": 1, \"entities\": [{\"id\": 1, \"name\": \"a\"}, {\"id\": 2, \"name\": \"bb\"}], \"meta\": {\"author\": \"x\"}}";
+
+static JSON_Read_Profile profile;
+
+static const JSON_Read_Profile_Entry *find(long parent, const char *key) {
+  int i;
+  for(i = 0; i < JSONR_PROFILE_SLOTS; i++) {
+    const JSON_Read_Profile_Entry *entry = &profile.entries[i];
+    if(entry->used && entry->parent == parent && entry->key_length == strlen(key) && memcmp(entry->key, key, entry->key_length) == 0) {
+      return entry;
+    }
+  }
+  return 0;
+}
+
+int main() {
+  static char folded[4096];
+  const JSON_Read_Profile_Entry *version, *entities, *id, *name, *meta, *author;
+  FILE *f = fmemopen((void*)data, strlen(data), "rb");
+  char * str;
+  unsigned long len;
+  int pass;
+
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+
+  jsonr_profile_init(&profile);
+
+  /* Twice, the profile aggregates over every read pointed at it. */
+  for(pass = 0; pass < 2; pass++) {
+    fseek(f, 0, SEEK_SET);
+    jsonr_init(j, f);
+    j->profile = &profile;
+
+    jsonr_v_table(j) {
+      if(jsonr_k_case(j, "version")) {
+        jsonr_v_number(j);
+      }
+      else if(jsonr_k_case(j, "entities")) {
+        jsonr_v_array(j) {
+          jsonr_v_table(j) {
+            if(jsonr_k_case(j, "id")) jsonr_v_number(j);
+            else if(jsonr_k_case(j, "name")) jsonr_v_string(j, &str, &len);
+            else jsonr_kv_skip(j);
+          }
+        }
+      }
+      else {
+        jsonr_kv_skip(j);
+      }
+    }
+    assert(!j->error);
+    assert(j->frame_count == 0);
+  }
+  fclose(f);
+
+  version = find(-1, "version");
+  entities = find(-1, "entities");
+  meta = find(-1, "meta");
+  assert(version && entities && meta);
+
+  id = find(entities - profile.entries, "id");
+  name = find(entities - profile.entries, "name");
+  author = find(meta - profile.entries, "author");
+  assert(id && name && author);
+  assert(!find(-1, "id"));
+
+  assert(version->hits == 2 && entities->hits == 2 && meta->hits == 2);
+  assert(id->hits == 4 && name->hits == 4 && author->hits == 2);
+  assert(profile.dropped == 0);
+
+  /* A key spans from its name to the opening quote of the next key at its level. */
+  assert(version->bytes == 2 * strlen("version\": 1, \""));
+  assert(entities->child_bytes == id->bytes + name->bytes);
+  assert(entities->bytes > entities->child_bytes);
+  assert(version->bytes + entities->bytes + meta->bytes <= 2 * strlen(data));
+  assert(version->cycles > 0 && entities->cycles >= entities->child_cycles);
+
+  f = fmemopen(folded, sizeof(folded), "w");
+  jsonr_profile_write_folded(&profile, f, JSONR_PROFILE_BYTES);
+  fclose(f);
+
+  assert(strstr(folded, "version 28\n"));
+  assert(strstr(folded, "entities;id "));
+  assert(strstr(folded, "entities;name "));
+  assert(strstr(folded, "meta;author "));
+
+  return 0;
+}
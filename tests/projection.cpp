@@ -0,0 +1,177 @@
+#define JSONREAD_IMPL
+#include "../json-read.h"
+#include <assert.h>
+
+const char * data =
+  "{\"version\": 3, \"records\": ["
+    "{\"id\": 10, \"pos\": {\"x\": 1, \"y\": 2}, \"name\": \"first\"},"
+    "{\"id\": 11, \"pos\": {\"x\": 3, \"y\": 4}, \"name\": \"second\", \"tags\": [\"a\", \"b\"]},"
+    "{\"id\": 12, \"pos\": {\"x\": 5, \"y\": 6}, \"name\": \"third\"}"
+  "], \"meta\": {\"author\": \"x\", \"big\": [[[1, 2, 3]], {\"k\": \"]}\"}]}, \"tail\": true}";
+
+enum {
+  VERSION,
+  RECORD_ID,
+  RECORD_X,
+  SECOND_NAME,
+  AUTHOR,
+  MISSING,
+  ANY,
+  PATH_COUNT,
+};
+
+typedef struct {
+  double version;
+  double ids[8];
+  int id_count;
+  double x_sum;
+  char name[16];
+  char author[16];
+  int hits[PATH_COUNT];
+} Out;
+
+static int hit(JSON_Read_Data *j, int path, void *user) {
+  Out *out = (Out*)user;
+  char *str;
+  unsigned long len;
+
+  out->hits[path] += 1;
+  switch(path) {
+    case VERSION: out->version = jsonr_v_number(j); break;
+    case RECORD_ID: out->ids[out->id_count++] = jsonr_v_number(j); break;
+    case RECORD_X: out->x_sum += jsonr_v_number(j); break;
+    case SECOND_NAME: {
+      jsonr_v_string(j, &str, &len);
+      memcpy(out->name, str, len);
+      break;
+    }
+    case AUTHOR: {
+      jsonr_v_string(j, &str, &len);
+      memcpy(out->author, str, len);
+      break;
+    }
+    default: jsonr_v_skip(j); break;
+  }
+  return 1;
+}
+
+int main() {
+  static JSON_Read_Projection projection;
+  static char paths[JSONR_PROJECTION_NODES][16];
+  JSON_Read_Projection *p = &projection;
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+  Out out;
+  int i;
+
+  jsonr_projection_init(p);
+  assert(jsonr_projection_add(p, "/version", VERSION));
+  assert(jsonr_projection_add(p, "/records/*/id", RECORD_ID));
+  assert(jsonr_projection_add(p, "/records/*/pos/x", RECORD_X));
+  assert(jsonr_projection_add(p, "/records/1/name", SECOND_NAME));
+  assert(jsonr_projection_add(p, "/meta/author", AUTHOR));
+  assert(jsonr_projection_add(p, "/meta/nope", MISSING));
+  assert(!jsonr_projection_add(p, "/version", MISSING));
+  assert(!jsonr_projection_add(p, "version", MISSING));
+
+  /* "records" and "meta" are shared. */
+  assert(p->node_count == 1 + 1 + 1 + 1 + 1 + 2 + 1 + 1 + 1 + 1 + 1);
+
+  memset(&out, 0, sizeof(out));
+  jsonr_init_mem(j, data, strlen(data));
+  assert(jsonr_project(j, p, hit, &out));
+  assert(!j->error);
+  assert(j->offset == strlen(data));
+
+  assert(out.version == 3);
+  assert(out.id_count == 3 && out.ids[0] == 10 && out.ids[1] == 11 && out.ids[2] == 12);
+  assert(out.x_sum == 1 + 3 + 5);
+  assert(strcmp(out.name, "second") == 0);
+  assert(strcmp(out.author, "x") == 0);
+  assert(out.hits[MISSING] == 0);
+
+  /* Without wildcards we stop as soon as everything was found. */
+  jsonr_projection_init(p);
+  assert(jsonr_projection_add(p, "/records/0/id", RECORD_ID));
+  assert(jsonr_projection_add(p, "/version", VERSION));
+
+  memset(&out, 0, sizeof(out));
+  jsonr_init_mem(j, data, strlen(data));
+  assert(!jsonr_project(j, p, hit, &out));
+  assert(!j->error);
+  assert(out.version == 3 && out.id_count == 1 && out.ids[0] == 10);
+  assert(j->offset < strlen(data) / 4);
+
+  /* A path that's the prefix of another one gets the whole value. */
+  jsonr_projection_init(p);
+  assert(jsonr_projection_add(p, "/records/2", MISSING));
+  assert(jsonr_projection_add(p, "/records/2/id", RECORD_ID));
+
+  memset(&out, 0, sizeof(out));
+  jsonr_init_mem(j, data, strlen(data));
+  jsonr_project(j, p, hit, &out);
+  assert(!j->error);
+  assert(out.hits[MISSING] == 1 && out.hits[RECORD_ID] == 0);
+
+  /* A value on a wildcard path and a concrete one goes to both. */
+  jsonr_projection_init(p);
+  assert(jsonr_projection_add(p, "/records/*/name", ANY));
+  assert(jsonr_projection_add(p, "/records/1/name", SECOND_NAME));
+
+  memset(&out, 0, sizeof(out));
+  jsonr_init_mem(j, data, strlen(data));
+  assert(jsonr_project(j, p, hit, &out));
+  assert(!j->error && j->offset == strlen(data));
+  assert(strcmp(out.name, "second") == 0);
+  assert(out.hits[ANY] == 3 && out.hits[SECOND_NAME] == 1);
+
+  {
+    const char * shared = "{\"a\": [\"q\\\"\\\\\\n\", {\"b\": [1]}], \"version\": 2}";
+    jsonr_projection_init(p);
+    assert(jsonr_projection_add(p, "/a/*", ANY));
+    assert(jsonr_projection_add(p, "/a/0", AUTHOR));
+    assert(jsonr_projection_add(p, "/a/1", MISSING));
+
+    memset(&out, 0, sizeof(out));
+    jsonr_init_mem(j, shared, strlen(shared));
+    assert(jsonr_project(j, p, hit, &out));
+    assert(!j->error && j->offset == strlen(shared));
+    assert(strcmp(out.author, "q\"\\\n") == 0);
+    assert(out.hits[ANY] == 2 && out.hits[AUTHOR] == 1 && out.hits[MISSING] == 1);
+  }
+
+  /* A repeated key doesn't count as another path found. */
+  {
+    const char * repeated = "{\"id\": 1, \"id\": 2, \"version\": 3}";
+    jsonr_projection_init(p);
+    assert(jsonr_projection_add(p, "/id", RECORD_ID));
+    assert(jsonr_projection_add(p, "/version", VERSION));
+
+    memset(&out, 0, sizeof(out));
+    jsonr_init_mem(j, repeated, strlen(repeated));
+    jsonr_project(j, p, hit, &out);
+    assert(!j->error);
+    assert(out.id_count == 2 && out.version == 3);
+  }
+
+  /* Running out of nodes. */
+  jsonr_projection_init(p);
+  for(i = 0; i < JSONR_PROJECTION_NODES; i++) {
+    snprintf(paths[i], sizeof(paths[i]), "/k%d", i);
+    assert(jsonr_projection_add(p, paths[i], i) == (i < JSONR_PROJECTION_NODES - 1));
+  }
+
+  /* Errors in skipped values still stop the walk. */
+  {
+    const char * broken = "{\"skipped\": [1, \"oops], \"version\": 1}";
+    jsonr_projection_init(p);
+    assert(jsonr_projection_add(p, "/version", VERSION));
+
+    memset(&out, 0, sizeof(out));
+    jsonr_init_mem(j, broken, strlen(broken));
+    jsonr_project(j, p, hit, &out);
+    assert(j->error && out.hits[VERSION] == 0);
+  }
+
+  return 0;
+}
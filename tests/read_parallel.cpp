@@ -0,0 +1,145 @@
+#define JSONREAD_IMPL
+#define JSONREAD_POSIX
+#define JSONR_PARALLEL_SECTIONS 4
+#include "../json-read.h"
+#include <assert.h>
+
+#define SECTION_COUNT 10
+
+static char data[1024*64];
+static unsigned long length;
+
+typedef struct {
+  double sums[SECTION_COUNT];
+  int counts[SECTION_COUNT];
+  int others;
+  int reject; /* fail on anything but the s* sections. */
+  pthread_mutex_t mutex;
+} Sums;
+
+/* Sections of different sizes in a table that isn't the whole document. */
+static void generate(const char *broken_a, const char *broken_b) {
+  int s, i;
+
+  length = snprintf(data, sizeof(data), "{\"version\": 1,\n \"sections\": {\n");
+  for(s = 0; s < SECTION_COUNT; s++) {
+    length += snprintf(data + length, sizeof(data) - length, "  \"s%d\": [", s);
+    for(i = 0; i < (s * 37) % 200 + 1; i++) {
+      length += snprintf(data + length, sizeof(data) - length, "%s%d", i ? ", " : "", s * 1000 + i);
+    }
+    if(s == 3 && broken_a) length += snprintf(data + length, sizeof(data) - length, "%s", broken_a);
+    if(s == 7 && broken_b) length += snprintf(data + length, sizeof(data) - length, "%s", broken_b);
+    length += snprintf(data + length, sizeof(data) - length, "],\n");
+  }
+  length += snprintf(data + length, sizeof(data) - length, "  \"other\": {\"nested\": [1, 2]}\n },\n \"tail\": 2}");
+  assert(length < sizeof(data));
+}
+
+static void read_section(JSON_Read_Data *j, const char *key, unsigned long key_length, void *user) {
+  Sums *sums = (Sums*)user;
+  int s;
+
+  /* Not 0 terminated. */
+  if(key_length == 2 && key[0] == 's') {
+    s = key[1] - '0';
+    jsonr_v_array(j) {
+      sums->sums[s] += jsonr_v_number(j);
+      sums->counts[s] += 1;
+    }
+  }
+  else {
+    if(sums->reject) jsonr_error(j, "unexpected section '%.*s'", (int)key_length, key);
+    pthread_mutex_lock(&sums->mutex);
+    sums->others += 1;
+    pthread_mutex_unlock(&sums->mutex);
+    jsonr_v_skip(j);
+  }
+}
+
+/* Reads the whole document, the sections with 'thread_count' threads. */
+static int read_document(JSON_Read_Data *j, int thread_count, Sums *sums) {
+  char *str;
+  unsigned long len;
+  int tail = 0;
+
+  memset(sums->sums, 0, sizeof(sums->sums));
+  memset(sums->counts, 0, sizeof(sums->counts));
+  sums->others = 0;
+
+  jsonr_v_table(j) {
+    jsonr_k(j, &str, &len);
+    if(len == 8 && memcmp(str, "sections", 8) == 0) jsonr_v_table_parallel(j, thread_count, read_section, sums);
+    else if(len == 4 && memcmp(str, "tail", 4) == 0) tail = (int)jsonr_v_number(j);
+    else jsonr_v_skip(j);
+  }
+  return tail;
+}
+
+int main() {
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+  JSON_Read_Data other;
+  Sums expected;
+  Sums sums;
+  char message[2048];
+  FILE *f;
+  int threads[] = {1, 2, 4, 64, 1000};
+  int i;
+
+  memset(&expected, 0, sizeof(expected));
+  memset(&sums, 0, sizeof(sums));
+  pthread_mutex_init(&expected.mutex, 0);
+  pthread_mutex_init(&sums.mutex, 0);
+
+  generate(0, 0);
+
+  jsonr_init_mem(j, data, length);
+  assert(read_document(j, 1, &expected) == 2);
+  assert(!j->error && j->offset == length);
+  assert(expected.others == 1 && expected.counts[9] == (9 * 37) % 200 + 1);
+
+  /* The same thing on any number of threads, and the cursor ends up after the table. */
+  for(i = 0; i < (int)(sizeof(threads)/sizeof(threads[0])); i++) {
+    jsonr_init_mem(j, data, length);
+    assert(read_document(j, threads[i], &sums) == 2);
+    assert(!j->error && j->offset == length);
+    assert(memcmp(sums.sums, expected.sums, sizeof(sums.sums)) == 0);
+    assert(memcmp(sums.counts, expected.counts, sizeof(sums.counts)) == 0);
+    assert(sums.others == 1);
+  }
+
+  /* Other sources are read on the calling thread. */
+  f = fmemopen(data, length, "rb");
+  jsonr_init(j, f);
+  assert(read_document(j, 4, &sums) == 2);
+  assert(!j->error);
+  assert(memcmp(sums.sums, expected.sums, sizeof(sums.sums)) == 0);
+  fclose(f);
+
+  /* The error is the first one in the document, whichever thread ran into it first. */
+  generate(", tru", ", }");
+  jsonr_init_mem(&other, data, length);
+  read_document(&other, 1, &expected);
+  assert(other.error && other.error_code == JSONR_E_EXPECTED_NUMBER);
+  assert(other.error_offset < (unsigned long)(strstr(data, "\"s4\"") - data));
+  snprintf(message, sizeof(message), "%s", jsonr_error_message(&other, 0));
+
+  for(i = 0; i < 20; i++) {
+    jsonr_init_mem(j, data, length);
+    read_document(j, 4, &sums);
+    assert(j->error && j->error_code == other.error_code && j->error_offset == other.error_offset);
+    assert(strcmp(jsonr_error_message(j, 0), message) == 0);
+  }
+
+  /* jsonr_error text from a thread, and each context keeps its own message. */
+  generate(0, 0);
+  sums.reject = 1;
+  jsonr_init_mem(j, data, length);
+  read_document(j, 4, &sums);
+  assert(j->error && j->error_code == JSONR_E_CUSTOM);
+  assert(strstr(jsonr_error_message(j, 0), "unexpected section 'other'"));
+  assert(strstr(jsonr_error_message(&other, 0), "unexpected section") == 0);
+  assert(strcmp(jsonr_error_message(&other, 0), message) == 0);
+
+  return 0;
+}
@@ -0,0 +1,217 @@
+#define JSONREAD_IMPL
+#define JSONREAD_STATS
+#include "../json-read.h"
+#include <assert.h>
+
+static char data[1024*64];
+static unsigned long length;
+
+static JSON_Read_Skip slots[1024];
+static JSON_Read_Skips skips;
+
+static void generate() {
+  int i;
+
+  length = snprintf(data, sizeof(data), "{\"header\": {\"version\": 3, \"count\": 200},\n \"meshes\": [\n");
+  for(i = 0; i < 200; i++) {
+    length += snprintf(data + length, sizeof(data) - length, "  {\"id\": %d, \"v\": [%d, %d, %d]}%s\n", i, i, i + 1, i + 2, i < 199 ? "," : "");
+  }
+  /* A string long enough to be worth recording where it ends. */
+  length += snprintf(data + length, sizeof(data) - length, " ],\n \"text\": \"");
+  for(i = 0; i < JSONR_SKIP_MIN_LENGTH; i++) data[length++] = 'a' + i % 26;
+  length += snprintf(data + length, sizeof(data) - length,
+    "\",\n"
+    " \"nested\": {\"deep\": {\"list\": [\"one\", \"two\", \"three\", \"four\", \"five\", \"six\", \"seven\"]}},\n"
+    " \"tail\": 1}");
+  assert(length < sizeof(data));
+}
+
+/* Every recorded offset has to be what reading without the table finds. */
+static void check_table() {
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+  unsigned long i;
+  unsigned long begin;
+
+  for(i = 0; i < skips.capacity; i++) {
+    if(!slots[i].begin) continue;
+    begin = slots[i].begin - 1;
+
+    jsonr_init_mem(j, data + begin, length - begin);
+    if(slots[i].element == 0) {
+      jsonr_v_skip_fast(j);
+      assert(!j->error && begin + j->value_end == slots[i].to);
+    }
+    else {
+      assert(jsonr_v_array_at(j, (long)slots[i].element));
+      assert(begin + j->offset - 1 == slots[i].to);
+    }
+  }
+}
+
+static int refill_100(JSON_Read_Data *j) {
+  unsigned long offset = j->block_offset;
+  if(offset >= length) return 0;
+  j->block = data + offset;
+  j->block_length = length - offset < 100 ? length - offset : 100;
+  return 1;
+}
+
+/* The first pass: reads the header, skips the meshes, reads the rest. */
+static void first_pass(JSON_Read_Data *j) {
+  char *str;
+  unsigned long len;
+
+  jsonr_v_table(j) {
+    if(jsonr_k_case(j, "header")) {
+      jsonr_v_table(j) {
+        if(jsonr_k_case(j, "count")) assert(jsonr_v_number(j) == 200);
+        else jsonr_kv_skip(j);
+      }
+    }
+    else if(jsonr_k_case(j, "text")) {
+      jsonr_v_string(j, &str, &len);
+    }
+    else if(jsonr_k_case(j, "nested")) {
+      assert(jsonr_extract(j, "/deep/list/6"));
+      jsonr_v_string(j, &str, &len);
+      assert(len == 5 && memcmp(str, "seven", 5) == 0);
+      jsonr_v_array_can_read(j);
+      jsonr_v_table_can_read(j);
+      jsonr_v_table_can_read(j);
+    }
+    else jsonr_kv_skip(j);
+  }
+  assert(!j->error);
+}
+
+/* Different handlers pulling out their own section. */
+static void navigate(JSON_Read_Data *j, unsigned long *bytes) {
+  char *str;
+  unsigned long len;
+  long count = 0;
+
+  assert(jsonr_extract(j, "/meshes/150/v/2"));
+  assert(jsonr_v_number(j) == 152);
+  *bytes = j->stats.bytes;
+
+  jsonr_init_mem(j, data, length);
+  j->skips = &skips;
+  assert(jsonr_extract(j, "/tail"));
+  assert(jsonr_v_number(j) == 1);
+  *bytes += j->stats.bytes;
+
+  jsonr_init_mem(j, data, length);
+  j->skips = &skips;
+  jsonr_v_table_begin(j);
+  while(jsonr_v_table_can_read(j)) {
+    if(jsonr_k_case(j, "meshes")) {
+      /* Jump in, then read the rest of the array. */
+      assert(jsonr_v_array_at(j, 197));
+      do {
+        jsonr_v_table(j) {
+          if(jsonr_k_case(j, "id")) assert(jsonr_v_number(j) == 197 + count);
+          else jsonr_kv_skip(j);
+        }
+        count += 1;
+      } while(jsonr_v_array_can_read(j));
+    }
+    else if(jsonr_k_case(j, "text")) {
+      jsonr_v_string(j, &str, &len);
+      assert(len == JSONR_SKIP_MIN_LENGTH);
+    }
+    else jsonr_kv_skip(j);
+  }
+  assert(!j->error && count == 3);
+  *bytes += j->stats.bytes;
+}
+
+int main() {
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+  JSON_Read_Peek peek;
+  FILE *f;
+  unsigned long bytes;
+  unsigned long count;
+
+  generate();
+
+  /* Without a table everything is scanned. */
+  jsonr_init_mem(j, data, length);
+  assert(jsonr_extract(j, "/meshes/150/v/2"));
+  assert(jsonr_v_number(j) == 152);
+  assert(j->stats.jumps == 0 && j->stats.bytes > length / 2);
+
+  jsonr_skips_init(&skips, slots, sizeof(slots)/sizeof(slots[0]));
+  jsonr_init_mem(j, data, length);
+  j->skips = &skips;
+  first_pass(j);
+  assert(j->stats.jumps == 0);
+  assert(skips.count > 0 && skips.dropped == 0);
+  check_table();
+
+  /* The meshes and every 64th mesh are known now. */
+  jsonr_init_mem(j, data, length);
+  j->skips = &skips;
+  navigate(j, &bytes);
+  assert(bytes < length / 3);
+
+  /* A second first pass finds nothing new. */
+  count = skips.count;
+  jsonr_init_mem(j, data, length);
+  j->skips = &skips;
+  first_pass(j);
+  assert(j->stats.jumps > 0 && skips.count == count);
+
+  /* A seekable file source jumps past its blocks. */
+  f = fmemopen(data, length, "rb");
+  jsonr_init(j, f);
+  j->skips = &skips;
+  assert(jsonr_extract(j, "/meshes/199/id"));
+  assert(jsonr_v_number(j) == 199);
+  assert(j->stats.jumps > 0 && j->stats.seeks > 0);
+  assert(!j->error);
+  fclose(f);
+
+  /* A source that can't seek only jumps inside its block, and scans otherwise. */
+  jsonr_init_source(j, refill_100, 0, 0);
+  j->skips = &skips;
+  assert(jsonr_extract(j, "/tail"));
+  assert(jsonr_v_number(j) == 1);
+  assert(!j->error);
+
+  /* Tables and arrays begun in a peek don't leave anything wrong behind. */
+  jsonr_skips_init(&skips, slots, sizeof(slots)/sizeof(slots[0]));
+  jsonr_init_mem(j, data, length);
+  j->skips = &skips;
+  jsonr_v_table_begin(j);
+  jsonr_v_table_can_read(j);
+  jsonr_k_eat(j);
+  jsonr_v_skip(j);
+  jsonr_v_table_can_read(j);
+  jsonr_k_eat(j);
+  peek = jsonr_peek_begin(j);
+  jsonr_v_array_begin(j);
+  jsonr_v_array_can_read(j);
+  jsonr_v_skip(j);
+  jsonr_v_array_can_read(j);
+  jsonr_v_table_begin(j);
+  jsonr_peek_end(j, peek);
+  jsonr_v_skip(j);
+  while(jsonr_v_table_can_read(j)) jsonr_kv_skip(j);
+  assert(!j->error && j->offset == length);
+  check_table();
+
+  /* A full table stops recording but still works. */
+  jsonr_skips_init(&skips, slots, 4);
+  jsonr_init_mem(j, data, length);
+  j->skips = &skips;
+  first_pass(j);
+  assert(skips.count == 3 && skips.dropped > 0);
+  check_table();
+  jsonr_init_mem(j, data, length);
+  j->skips = &skips;
+  navigate(j, &bytes);
+
+  return 0;
+}
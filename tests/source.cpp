@@ -0,0 +1,116 @@
+#define JSONREAD_IMPL
+#include "../json-read.h"
+#include <assert.h>
+
+const char * data = "{\"name\": \"split over many blocks\", \"values\": [1, 22, 333, -4.5e1], \"ok\": true}";
+
+/* Hands out 'data' a few bytes at a time, like a socket or a decompressor would. */
+typedef struct {
+  unsigned long pos;
+  unsigned long block_size;
+  int refills;
+  int seeks;
+} Chunks;
+
+static int chunks_refill(JSON_Read_Data *j) {
+  Chunks *c = (Chunks*)j->user;
+  unsigned long remaining = strlen(data) - c->pos;
+
+  c->refills++;
+  if(remaining == 0) return 0;
+
+  j->block = data + c->pos;
+  j->block_length = remaining < c->block_size ? remaining : c->block_size;
+  c->pos += j->block_length;
+  return 1;
+}
+
+static int chunks_seek(JSON_Read_Data *j, unsigned long offset) {
+  Chunks *c = (Chunks*)j->user;
+  c->seeks++;
+  c->pos = offset;
+  return 1;
+}
+
+static void parse(JSON_Read_Data *j, int peek_values) {
+  char *str;
+  unsigned long len;
+  double sum = 0;
+  JSON_Read_Peek peek;
+
+  jsonr_v_table(j) {
+    if(jsonr_k_case(j, "name")) {
+      jsonr_v_string(j, &str, &len);
+      assert(len == strlen("split over many blocks"));
+      assert(memcmp(str, "split over many blocks", len) == 0);
+    }
+    else if(jsonr_k_case(j, "values")) {
+      if(peek_values) {
+        /* Goes over a few blocks and back. */
+        peek = jsonr_peek_begin(j);
+        jsonr_v_skip(j);
+        jsonr_peek_end(j, peek);
+      }
+      jsonr_v_array(j) {
+        sum += jsonr_v_number(j);
+      }
+      assert(j->error || sum == 1 + 22 + 333 - 45);
+    }
+    else if(jsonr_k_case(j, "ok")) {
+      assert(jsonr_v_bool(j));
+    }
+    else {
+      assert(false);
+    }
+  }
+}
+
+int main() {
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+  Chunks chunks;
+  unsigned long block_size;
+
+  for(block_size = 1; block_size < 16; block_size++) {
+    memset(&chunks, 0, sizeof(chunks));
+    chunks.block_size = block_size;
+
+    jsonr_init_source(j, chunks_refill, chunks_seek, &chunks);
+    parse(j, 0);
+    assert(!j->error);
+
+    /* The source is only called on block boundaries, plus once to find the end. */
+    assert(chunks.refills == (int)((strlen(data) + block_size - 1) / block_size) + 1);
+    assert(chunks.seeks == 0);
+
+    memset(&chunks, 0, sizeof(chunks));
+    chunks.block_size = block_size;
+
+    jsonr_init_source(j, chunks_refill, chunks_seek, &chunks);
+    parse(j, 1);
+    assert(!j->error);
+    assert(chunks.seeks == 1);
+  }
+
+  /* Peeking inside a single block doesn't need the seek. */
+  memset(&chunks, 0, sizeof(chunks));
+  chunks.block_size = 1024;
+  jsonr_init_source(j, chunks_refill, 0, &chunks);
+  parse(j, 1);
+  assert(!j->error);
+
+  /* But over block boundaries it does. */
+  memset(&chunks, 0, sizeof(chunks));
+  chunks.block_size = 4;
+  jsonr_init_source(j, chunks_refill, 0, &chunks);
+  parse(j, 1);
+  assert(j->error);
+  assert(j->error_code == JSONR_E_SEEK);
+
+  jsonr_init_mem(j, data, strlen(data));
+  parse(j, 1);
+  assert(!j->error);
+  assert(j->offset == strlen(data));
+
+  return 0;
+}
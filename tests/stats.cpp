@@ -0,0 +1,80 @@
+#define JSONREAD_IMPL
+#define JSONREAD_STATS
+#define JSONWRITE_IMPL
+#define JSONWRITE_STATS
+#include "../json-write.h"
+#include "../json-read.h"
+#include <assert.h>
+
+const char * data = "{\"a\": 1, \"b\": [true, null, \"x\"], \"c\": {\"d\": 2}, \"e\": \"skip me\"}";
+
+int main() {
+  static char out[1024];
+  FILE *f = fmemopen((void*)data, strlen(data), "rb");
+  char * str;
+  unsigned long len;
+
+  JSON_Read_Data json;
+  JSON_Read_Data * j = &json;
+  JSON_Write_Data wjson;
+  JSON_Write_Data * w = &wjson;
+
+  jsonr_init(j, f);
+  jsonr_v_table(j) {
+    if(jsonr_k_case(j, "a")) {
+      jsonr_v_number(j);
+    }
+    else if(jsonr_k_case(j, "b")) {
+      jsonr_v_array_begin(j);
+      jsonr_v_array_can_read(j); jsonr_v_bool(j);
+      jsonr_v_array_can_read(j); jsonr_v_null(j);
+      jsonr_v_array_can_read(j); jsonr_v_string(j, &str, &len);
+      jsonr_v_array_can_read(j);
+    }
+    else {
+      jsonr_kv_skip(j);
+    }
+  }
+  assert(!j->error);
+  fclose(f);
+
+  assert(j->stats.bytes == strlen(data));
+  assert(j->stats.tables == 2);
+  assert(j->stats.arrays == 1);
+  assert(j->stats.strings == 2);
+  assert(j->stats.numbers == 2);
+  assert(j->stats.bools == 1);
+  assert(j->stats.nulls == 1);
+  assert(j->stats.keys == 5);
+  /* a: "a" | b: "a" "b" | c: "a" "b" | e: "a" "b" */
+  assert(j->stats.keys_compared == 7);
+  assert(j->stats.keys_matched == 2);
+  assert(j->stats.skips == 2);
+  assert(j->stats.skipped_bytes > strlen("{\"d\": 2}\"skip me\""));
+  assert(j->stats.peeks == 0);
+  assert(j->stats.seeks == 0);
+  /* One block with the whole document, one that finds the end. */
+  assert(j->stats.refills == 2);
+  assert(j->stats.errors == 0);
+
+  assert(jsonw_init_mem(w, 0));
+  jsonw_v_table_begin(w);
+    jsonw_k(w, "read");
+    jsonr_stats_write(w, &j->stats);
+    jsonw_k(w, "write");
+    jsonw_stats_write(w, &w->stats);
+  jsonw_v_table_end(w);
+  assert(jsonw_finish(w));
+
+  assert(w->buf_used < sizeof(out));
+  memcpy(out, w->buf, w->buf_used);
+  free(w->buf);
+
+  assert(strstr(out, "\"read\":{\"bytes\":63,\"tables\":2,"));
+  assert(strstr(out, "\"keys_compared\":7,\"keys_matched\":2,"));
+  /* The writer's own counters as of the "write" key: the outer and the "read" tables, their 19
+   * keys and the seventeen numbers in "read". */
+  assert(strstr(out, "\"write\":{\"bytes\":"));
+  assert(strstr(out, "\"keys\":19,\"tables\":2,\"arrays\":0,\"strings\":0,\"numbers\":17,"));
+  return 0;
+}
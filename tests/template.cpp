@@ -0,0 +1,250 @@
+#define JSONREAD_IMPL
+#define JSONWRITE_IMPL
+#include "../json-read.h"
+#include "../json-write.h"
+#include "../json-cpp.h"
+#include <assert.h>
+#include <unistd.h>
+
+const char * data =
+  "{\"version\": 2, \"name\": \"te\\\"st\\n\", \"ok\": true, \"none\": null,\n"
+  " \"list\": [1, -2.5, 3e2, {\"skip\": [\"me\", {\"a\": false}]}],\n"
+  " \"nested\": {\"x\": 0.25, \"unknown\": \"?\", \"y\": -1}}";
+
+/* Everything that was read, to compare the C and C++ readers. */
+typedef struct {
+  double version;
+  char name[32];
+  unsigned long name_length;
+  int ok;
+  int none;
+  double list_sum;
+  int list_skipped;
+  double x, y;
+} Result;
+
+static void read_c(JSON_Read_Data *j, Result *r) {
+  char *str;
+  unsigned long len;
+
+  memset(r, 0, sizeof(*r));
+  jsonr_v_table(j) {
+    if(jsonr_k_case(j, "version")) r->version = jsonr_v_number(j);
+    else if(jsonr_k_case(j, "name")) {
+      jsonr_v_string(j, &str, &len);
+      memcpy(r->name, str, len);
+      r->name_length = len;
+    }
+    else if(jsonr_k_case(j, "ok")) r->ok = jsonr_v_bool(j);
+    else if(jsonr_k_case(j, "none")) r->none = jsonr_v_null(j);
+    else if(jsonr_k_case(j, "list")) {
+      jsonr_v_array(j) {
+        if(jsonr_v_get_type(j) == JSONR_V_NUMBER) r->list_sum += jsonr_v_number(j);
+        else { jsonr_v_skip(j); r->list_skipped++; }
+      }
+    }
+    else if(jsonr_k_case(j, "nested")) {
+      jsonr_v_table(j) {
+        if(jsonr_k_case(j, "x")) r->x = jsonr_v_number(j);
+        else if(jsonr_k_case(j, "y")) r->y = jsonr_v_number(j);
+        else jsonr_kv_skip(j);
+      }
+    }
+    else jsonr_kv_skip(j);
+  }
+}
+
+template<typename Source>
+static void read_cpp(jsonr::reader<Source> &j, Result *r) {
+  char *str;
+  unsigned long len;
+
+  memset(r, 0, sizeof(*r));
+  for(j.table_begin(); j.table_can_read(); ) {
+    if(j.k_case("version")) r->version = j.v_number();
+    else if(j.k_case("name")) {
+      j.v_string(&str, &len);
+      memcpy(r->name, str, len);
+      r->name_length = len;
+    }
+    else if(j.k_case("ok")) r->ok = j.v_bool();
+    else if(j.k_case("none")) r->none = j.v_null();
+    else if(j.k_case("list")) {
+      for(j.array_begin(); j.array_can_read(); ) {
+        if(j.v_get_type() == JSONR_V_NUMBER) r->list_sum += j.v_number();
+        else { j.v_skip(); r->list_skipped++; }
+      }
+    }
+    else if(j.k_case("nested")) {
+      for(j.table_begin(); j.table_can_read(); ) {
+        if(j.k_case("x")) r->x = j.v_number();
+        else if(j.k_case("y")) r->y = j.v_number();
+        else j.kv_skip();
+      }
+    }
+    else j.kv_skip();
+  }
+}
+
+static void write_c(JSON_Write_Data *j) {
+  jsonw_v_table_begin(j);
+    jsonw_kv_int(j, "int", -1234567890123L);
+    jsonw_kv_uint(j, "uint", 18446744073709551615UL);
+    jsonw_kv_float(j, "float", -0.125);
+    jsonw_kv_bool(j, "yes", 1);
+    jsonw_kv_string(j, "escaped", "a\"b\\c\n\td\r\b\f");
+    jsonw_k(j, "list");
+    jsonw_v_array_begin(j);
+      jsonw_v_int(j, 0);
+      jsonw_v_raw(j, "null", 4);
+      jsonw_v_array_begin(j);
+      jsonw_v_array_end(j);
+      jsonw_v_table_begin(j);
+      jsonw_v_table_end(j);
+      jsonw_v_string(j, "");
+    jsonw_v_array_end(j);
+  jsonw_v_table_end(j);
+}
+
+template<typename Sink>
+static void write_cpp(jsonw::writer<Sink> &j) {
+  j.table_begin();
+    j.kv_int("int", -1234567890123L);
+    j.kv_uint("uint", 18446744073709551615UL);
+    j.kv_float("float", -0.125);
+    j.kv_bool("yes", 1);
+    j.kv_string("escaped", "a\"b\\c\n\td\r\b\f");
+    j.k("list");
+    j.array_begin();
+      j.v_int(0);
+      j.v_raw("null", 4);
+      j.array_begin();
+      j.array_end();
+      j.table_begin();
+      j.table_end();
+      j.v_string("");
+    j.array_end();
+  j.table_end();
+}
+
+static FILE *open_pipe(const char *data) {
+  int fds[2];
+  assert(pipe(fds) == 0);
+  assert(write(fds[1], data, strlen(data)) == (long)strlen(data));
+  close(fds[1]);
+  return fdopen(fds[0], "rb");
+}
+
+static void check_errors(const char *input, int code) {
+  JSON_Read_Data json;
+  Result expected, got;
+
+  jsonr_init_mem(&json, input, strlen(input));
+  read_c(&json, &expected);
+  assert(json.error_code == code);
+
+  jsonr::reader<jsonr::span_source> j(jsonr::span_source(input, strlen(input)));
+  read_cpp(j, &got);
+  assert(j.error && j.error_code == code);
+}
+
+int main() {
+  static char expected_out[1024];
+  static char out[1024];
+  unsigned long expected_length;
+  JSON_Read_Data json;
+  JSON_Write_Data jw;
+  Result expected, got;
+  FILE *f;
+  int fds[2];
+
+  jsonr_init_mem(&json, data, strlen(data));
+  read_c(&json, &expected);
+  assert(!json.error);
+  assert(expected.version == 2 && expected.name_length == 6 && memcmp(expected.name, "te\"st\n", 6) == 0);
+  assert(expected.ok && expected.none && expected.list_skipped == 1);
+  assert(expected.list_sum == 1 - 2.5 + 300 && expected.x == 0.25 && expected.y == -1);
+
+  {
+    jsonr::reader<jsonr::span_source> j(jsonr::span_source(data, strlen(data)));
+    read_cpp(j, &got);
+    assert(!j.error);
+    assert(memcmp(&expected, &got, sizeof(got)) == 0);
+  }
+
+  /* Tiny blocks, so every token gets split somewhere. */
+  {
+    f = open_pipe(data);
+    jsonr::reader<jsonr::file_source<3> > j((jsonr::file_source<3>(f)));
+    read_cpp(j, &got);
+    assert(!j.error);
+    assert(memcmp(&expected, &got, sizeof(got)) == 0);
+    fclose(f);
+  }
+
+  {
+    f = open_pipe(data);
+    jsonr::reader<jsonr::fd_source<7> > j((jsonr::fd_source<7>(fileno(f))));
+    read_cpp(j, &got);
+    assert(!j.error);
+    assert(memcmp(&expected, &got, sizeof(got)) == 0);
+    fclose(f);
+  }
+
+  check_errors("{\"list\": [1, 2,]}", JSONR_E_ARRAY_ENDED);
+  check_errors("{\"ok\": true,}", JSONR_E_TABLE_ENDED);
+  check_errors("{\"list\": [1 2]}", JSONR_E_EXPECTED_COMMA);
+  check_errors("{\"ok\": yes}", JSONR_E_EXPECTED_BOOL);
+  check_errors("{\"ok\": tru}", JSONR_E_UNEXPECTED_CHAR);
+  check_errors("{\"version\": 1e5e5}", JSONR_E_MALFORMED_NUMBER);
+  check_errors("{\"name\": \"unterminated", JSONR_E_STRING_EOF);
+  check_errors("{\"other\": @}", JSONR_E_INVALID_VALUE);
+  check_errors("{\"name\" 1}", JSONR_E_UNEXPECTED_CHAR);
+
+  /* The writers have to produce the same bytes. */
+  f = fmemopen(expected_out, sizeof(expected_out), "wb");
+  jsonw_init(&jw, f);
+  write_c(&jw);
+  assert(jsonw_finish(&jw));
+  expected_length = ftell(f);
+  fclose(f);
+
+  {
+    jsonw::writer<jsonw::span_sink> j(jsonw::span_sink(out, sizeof(out)));
+    write_cpp(j);
+    assert(j.finish());
+    assert(j.sink.used() == expected_length);
+    assert(memcmp(out, expected_out, expected_length) == 0);
+  }
+
+  {
+    jsonw::writer<jsonw::span_sink> j(jsonw::span_sink(out, 10));
+    write_cpp(j);
+    assert(!j.finish());
+    assert(memcmp(out, expected_out, 10) == 0);
+  }
+
+  {
+    memset(out, 0, sizeof(out));
+    f = fmemopen(out, sizeof(out), "wb");
+    jsonw::writer<jsonw::file_sink<5> > j((jsonw::file_sink<5>(f)));
+    write_cpp(j);
+    assert(j.finish());
+    assert((unsigned long)ftell(f) == expected_length);
+    fclose(f);
+    assert(memcmp(out, expected_out, expected_length) == 0);
+  }
+
+  {
+    assert(pipe(fds) == 0);
+    jsonw::writer<jsonw::fd_sink<16> > j((jsonw::fd_sink<16>(fds[1])));
+    write_cpp(j);
+    assert(j.finish());
+    close(fds[1]);
+    assert(read(fds[0], out, sizeof(out)) == (long)expected_length);
+    assert(memcmp(out, expected_out, expected_length) == 0);
+    close(fds[0]);
+  }
+
+  return 0;
+}
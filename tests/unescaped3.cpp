@@ -26,7 +26,7 @@ int main() {
   }
 
   if(j->error) {
-    printf("%.*s\n", (int)j->error_msg_length, j->error_msg);
+    printf("%s\n", jsonr_error_message(j, 0));
     return 0;
   }
 
@@ -0,0 +1,123 @@
+#define JSONWRITE_IMPL
+#include "../json-write.h"
+#include <assert.h>
+
+typedef struct {
+  long id;
+  double weight;
+  const char * name;
+} Record;
+
+static const int record_count = 4;
+static Record records[] = {
+  { 1, 0.5, "first" },
+  { -20, -1234.125, "has \"quotes\"\n" },
+  { 300000000000, 1e20, "" },
+  { -9223372036854775807l - 1, 0, "last" },
+};
+
+static char expected[1024*1024];
+static char got[1024*1024];
+
+static void write_one_by_one(FILE *f, const long *ints, const double *floats, unsigned long count) {
+  JSON_Write_Data json;
+  JSON_Write_Data * j = &json;
+  unsigned long i;
+
+  jsonw_init(j, f);
+  jsonw_v_table_begin(j);
+
+    jsonw_k(j, "ids");
+    jsonw_v_array_begin(j);
+    for(i = 0; i < record_count; i++) jsonw_v_int(j, records[i].id);
+    jsonw_v_array_end(j);
+
+    jsonw_k(j, "weights");
+    jsonw_v_array_begin(j);
+    for(i = 0; i < record_count; i++) jsonw_v_float(j, records[i].weight);
+    jsonw_v_array_end(j);
+
+    jsonw_k(j, "names");
+    jsonw_v_array_begin(j);
+    for(i = 0; i < record_count; i++) jsonw_v_string(j, records[i].name);
+    jsonw_v_array_end(j);
+
+    jsonw_k(j, "empty");
+    jsonw_v_array_begin(j);
+    jsonw_v_array_end(j);
+
+    jsonw_k(j, "many_ints");
+    jsonw_v_array_begin(j);
+    for(i = 0; i < count; i++) jsonw_v_int(j, ints[i]);
+    jsonw_v_array_end(j);
+
+    jsonw_k(j, "many_floats");
+    jsonw_v_array_begin(j);
+    for(i = 0; i < count; i++) jsonw_v_float(j, floats[i]);
+    jsonw_v_array_end(j);
+
+  jsonw_v_table_end(j);
+}
+
+static void write_bulk(FILE *f, const long *ints, const double *floats, unsigned long count) {
+  JSON_Write_Data json;
+  JSON_Write_Data * j = &json;
+
+  jsonw_init(j, f);
+  jsonw_v_table_begin(j);
+
+    jsonw_k(j, "ids");
+    jsonw_v_int_array(j, &records[0].id, record_count, sizeof(Record));
+
+    jsonw_k(j, "weights");
+    jsonw_v_float_array(j, &records[0].weight, record_count, sizeof(Record));
+
+    jsonw_k(j, "names");
+    jsonw_v_string_array(j, &records[0].name, record_count, sizeof(Record));
+
+    jsonw_k(j, "empty");
+    jsonw_v_int_array(j, ints, 0, 0);
+
+    jsonw_k(j, "many_ints");
+    jsonw_v_int_array(j, ints, count, 0);
+
+    jsonw_k(j, "many_floats");
+    jsonw_v_float_array(j, floats, count, 0);
+
+  jsonw_v_table_end(j);
+}
+
+int main() {
+  static long ints[10000];
+  static double floats[10000];
+  static char long_name[JSONW_ARRAY_CHUNK_SIZE*2];
+  unsigned long count = sizeof(ints)/sizeof(ints[0]);
+  unsigned long i;
+  FILE *f;
+
+  for(i = 0; i < count; i++) {
+    ints[i] = (long)(i * 2654435761ul) - 1000000;
+    floats[i] = (double)ints[i] / 7.0;
+  }
+
+  /* Bigger than a whole chunk, so it has to bypass it. */
+  memset(long_name, '\n', sizeof(long_name) - 1);
+  records[2].name = long_name;
+
+  f = fmemopen(expected, sizeof(expected), "w");
+  write_one_by_one(f, ints, floats, count);
+  fclose(f);
+
+  f = fmemopen(got, sizeof(got), "w");
+  write_bulk(f, ints, floats, count);
+  fclose(f);
+
+  if(strcmp(expected, got) != 0) {
+    printf("expected: %.200s\n", expected);
+    printf("got:      %.200s\n", got);
+    assert(false);
+    return 1;
+  }
+
+  return 0;
+}
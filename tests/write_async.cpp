@@ -0,0 +1,75 @@
+#define JSONWRITE_IMPL
+#define JSONWRITE_POSIX
+#include "../json-write.h"
+#include <assert.h>
+
+static void write_snapshot(JSON_Write_Data *j) {
+  int i;
+
+  jsonw_v_table_begin(j);
+    jsonw_kv_int(j, "version", 1);
+    jsonw_kv_string(j, "name", "snapshot\twith\nescapes");
+
+    jsonw_k(j, "entities");
+    jsonw_v_array_begin(j);
+    for(i = 0; i < 5000; i++) {
+      jsonw_v_table_begin(j);
+        jsonw_kv_int(j, "id", i);
+        jsonw_kv_float(j, "x", i * 0.25);
+        jsonw_kv_bool(j, "alive", i & 1);
+      jsonw_v_table_end(j);
+    }
+    jsonw_v_array_end(j);
+  jsonw_v_table_end(j);
+}
+
+static long read_all(FILE *f, char *buf, long size) {
+  long len;
+  fflush(f);
+  fseek(f, 0, SEEK_SET);
+  len = fread(buf, 1, size, f);
+  return len;
+}
+
+int main() {
+  static char expected[1024*1024];
+  static char got[1024*1024];
+  /* Tiny on purpose so the writer keeps running into backpressure. */
+  static char mem[256];
+  long expected_len, got_len;
+
+  JSON_Write_Data json;
+  JSON_Write_Data * j = &json;
+  JSON_Write_Async async;
+
+  FILE *sync_f = tmpfile();
+  FILE *async_f = tmpfile();
+
+  jsonw_init(j, sync_f);
+  write_snapshot(j);
+  assert(jsonw_finish(j));
+
+  assert(jsonw_init_async(j, &async, async_f, mem, sizeof(mem)));
+  write_snapshot(j);
+  assert(jsonw_finish(j));
+
+  expected_len = read_all(sync_f, expected, sizeof(expected));
+  got_len = read_all(async_f, got, sizeof(got));
+
+  assert(expected_len > 0);
+  assert(expected_len == got_len);
+  assert(memcmp(expected, got, expected_len) == 0);
+
+  /* Writing into a read-only stream has to be reported by jsonw_finish. */
+  {
+    FILE *ro = fopen("/dev/null", "r");
+    assert(jsonw_init_async(j, &async, ro, mem, sizeof(mem)));
+    write_snapshot(j);
+    assert(!jsonw_finish(j));
+    fclose(ro);
+  }
+
+  fclose(sync_f);
+  fclose(async_f);
+  return 0;
+}
@@ -0,0 +1,98 @@
+#define JSONWRITE_IMPL
+#include "../json-write.h"
+#include <assert.h>
+
+static const double floats[] = {
+  0, -0.0, 1, -1, 0.5, 3.1415, 9.9999994, 9.9999996, 99.9999996, -999.99999951, 0.0000004,
+  -0.0000004, 123456789.123456, 999999999999999.0, 1e15, -1e15, 1e20, -1e300, 1.0/0.0, -1.0/0.0,
+};
+
+static const long ints[] = {
+  0, 1, -1, 9, 10, 99, 100, 12345, -99999, 1000000000, -9223372036854775807l - 1, 9223372036854775807l,
+};
+
+static const char * strings[] = {
+  "", "plain", "with \"quotes\" and \\ slashes", "\n\r\t\b\f", "\x80\xff high bytes",
+};
+
+static void write_document(JSON_Write_Data *j) {
+  unsigned long i;
+
+  jsonw_v_table_begin(j);
+    jsonw_k(j, "floats");
+    jsonw_v_array_begin(j);
+    for(i = 0; i < sizeof(floats)/sizeof(floats[0]); i++) jsonw_v_float(j, floats[i]);
+    jsonw_v_array_end(j);
+
+    jsonw_k(j, "ints");
+    jsonw_v_array_begin(j);
+    for(i = 0; i < sizeof(ints)/sizeof(ints[0]); i++) jsonw_v_int(j, ints[i]);
+    jsonw_v_array_end(j);
+
+    jsonw_kv_uint(j, "big", 18446744073709551615ul);
+
+    jsonw_k(j, "strings");
+    jsonw_v_array_begin(j);
+    for(i = 0; i < sizeof(strings)/sizeof(strings[0]); i++) jsonw_v_string(j, strings[i]);
+    jsonw_v_array_end(j);
+
+    jsonw_k(j, "esc\"aped key");
+    jsonw_v_float_array(j, floats, sizeof(floats)/sizeof(floats[0]), 0);
+    jsonw_k(j, "int_array");
+    jsonw_v_int_array(j, ints, sizeof(ints)/sizeof(ints[0]), 0);
+    jsonw_k(j, "string_array");
+    jsonw_v_string_array(j, strings, sizeof(strings)/sizeof(strings[0]), 0);
+
+    jsonw_kv_bool(j, "yes", 1);
+    jsonw_kv_bool(j, "no", 0);
+    jsonw_k(j, "raw");
+    jsonw_v_raw(j, "[1,2,3]", 7);
+  jsonw_v_table_end(j);
+}
+
+/* Only the final flush is allowed, anything before that means the buffer was too small. */
+static int fail_flush(JSON_Write_Data *json, int finish) {
+  (void)json;
+  return finish;
+}
+
+int main() {
+  JSON_Write_Data json;
+  JSON_Write_Data * j = &json;
+  unsigned long size;
+  char * buf;
+  double val;
+  int i;
+
+  jsonw_init_count(j);
+  write_document(j);
+  assert(jsonw_finish(j));
+  size = j->counted;
+
+  assert(jsonw_init_mem(j, 16));
+  write_document(j);
+  assert(jsonw_finish(j));
+  assert(size == j->buf_used);
+  free(j->buf);
+
+  /* Allocate once, serialize straight into the final buffer. The flush fails if anything ever
+   * overflows. */
+  buf = (char*)malloc(size);
+  jsonw_init_sink(j, buf, size, fail_flush, 0);
+  write_document(j);
+  assert(jsonw_finish(j));
+  assert(j->buf_used == size);
+  free(buf);
+
+  /* Hammer the float fast path. */
+  for(i = 0; i < 100000; i++) {
+    char printed[512];
+    val = (i - 50000) * 1.37e-3 * (i % 7 == 0 ? 1e9 : 1) + (i % 3) * 0.9999996;
+
+    jsonw_init_count(j);
+    jsonw_v_float(j, val);
+    assert(j->counted == (unsigned long)snprintf(printed, sizeof(printed), "%f", val));
+  }
+
+  return 0;
+}
@@ -0,0 +1,68 @@
+#define JSONWRITE_IMPL
+#define JSONWRITE_POSIX
+/* One page per extent, so the test goes through plenty of windows. */
+#define JSONW_MMAP_EXTENT 1
+#include "../json-write.h"
+#include <assert.h>
+
+static void write_document(JSON_Write_Data *j, int count) {
+  int i;
+
+  jsonw_v_table_begin(j);
+    jsonw_kv_int(j, "version", 1);
+    jsonw_k(j, "entities");
+    jsonw_v_array_begin(j);
+    for(i = 0; i < count; i++) {
+      jsonw_v_table_begin(j);
+        jsonw_kv_int(j, "id", i);
+        jsonw_kv_string(j, "name", "entity\nname");
+        jsonw_kv_float(j, "x", i * 0.25);
+      jsonw_v_table_end(j);
+      if(i % 1000 == 0) jsonw_flush(j);
+    }
+    jsonw_v_array_end(j);
+  jsonw_v_table_end(j);
+}
+
+int main() {
+  static char expected[1024*1024];
+  static char got[1024*1024];
+  const char *path = "/tmp/jsonw_test_mmap.json";
+  int counts[] = { 0, 10, 10000 };
+  long expected_len, got_len;
+  unsigned long i;
+  FILE *f;
+
+  JSON_Write_Data json;
+  JSON_Write_Data * j = &json;
+  JSON_Write_Mmap mmap_sink;
+
+  for(i = 0; i < sizeof(counts)/sizeof(counts[0]); i++) {
+    f = fmemopen(expected, sizeof(expected), "w");
+    jsonw_init(j, f);
+    write_document(j, counts[i]);
+    assert(jsonw_finish(j));
+    expected_len = ftell(f);
+    fclose(f);
+
+    assert(jsonw_init_mmap(j, &mmap_sink, path));
+    write_document(j, counts[i]);
+    assert(jsonw_finish(j));
+
+    /* The file has to be truncated down to exactly the output. */
+    f = fopen(path, "rb");
+    got_len = fread(got, 1, sizeof(got), f);
+    fclose(f);
+
+    assert(expected_len == got_len);
+    assert(memcmp(expected, got, expected_len) == 0);
+  }
+
+  remove(path);
+
+  assert(!jsonw_init_mmap(j, &mmap_sink, "/nonexistent/dir/file.json"));
+  write_document(j, 10);
+  assert(!jsonw_finish(j));
+
+  return 0;
+}
@@ -0,0 +1,86 @@
+#define JSONWRITE_IMPL
+#define JSONWRITE_POSIX
+/* Small batches so the test goes through a bunch of rounds. */
+#define JSONW_PARALLEL_BATCH 100
+#include "../json-write.h"
+#include <assert.h>
+
+static const unsigned long record_count = 10007;
+
+static void write_record(JSON_Write_Data *j, unsigned long index, void *user) {
+  jsonw_v_table_begin(j);
+    jsonw_kv_int(j, "id", index);
+    jsonw_kv_string(j, "name", (const char *)user);
+    jsonw_kv_float(j, "x", index * 0.5);
+  jsonw_v_table_end(j);
+}
+
+static void write_document(JSON_Write_Data *j, unsigned long count, int thread_count) {
+  unsigned long i;
+
+  jsonw_v_table_begin(j);
+    jsonw_kv_int(j, "version", 1);
+    jsonw_k(j, "records");
+    if(thread_count == 0) {
+      jsonw_v_array_begin(j);
+      for(i = 0; i < count; i++) write_record(j, i, (void*)"rec\"ord");
+      jsonw_v_array_end(j);
+    }
+    else {
+      assert(jsonw_v_array_parallel(j, count, thread_count, write_record, (void*)"rec\"ord"));
+    }
+    jsonw_kv_bool(j, "done", 1);
+  jsonw_v_table_end(j);
+}
+
+static long read_all(FILE *f, char *buf, long size) {
+  fflush(f);
+  fseek(f, 0, SEEK_SET);
+  return fread(buf, 1, size, f);
+}
+
+int main() {
+  static char expected[1024*1024];
+  static char got[1024*1024];
+  unsigned long counts[] = { 0, 1, 3, record_count };
+  int threads[] = { 1, 3, 8 };
+  long expected_len, got_len;
+  unsigned long c;
+  int t;
+
+  JSON_Write_Data json;
+  JSON_Write_Data * j = &json;
+
+  for(c = 0; c < sizeof(counts)/sizeof(counts[0]); c++) {
+    FILE *f = tmpfile();
+    jsonw_init(j, f);
+    write_document(j, counts[c], 0);
+    assert(jsonw_finish(j));
+    expected_len = read_all(f, expected, sizeof(expected));
+    fclose(f);
+
+    for(t = 0; t < (int)(sizeof(threads)/sizeof(threads[0])); t++) {
+      /* FILE with a descriptor: fragments go out through writev. */
+      f = tmpfile();
+      jsonw_init(j, f);
+      write_document(j, counts[c], threads[t]);
+      assert(jsonw_finish(j));
+      got_len = read_all(f, got, sizeof(got));
+      fclose(f);
+
+      assert(expected_len == got_len);
+      assert(memcmp(expected, got, expected_len) == 0);
+
+      /* Memory writer: fragments are copied. */
+      assert(jsonw_init_mem(j, 16));
+      write_document(j, counts[c], threads[t]);
+      assert(jsonw_finish(j));
+
+      assert(expected_len == (long)j->buf_used);
+      assert(memcmp(expected, j->buf, expected_len) == 0);
+      free(j->buf);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,121 @@
+#define JSONWRITE_IMPL
+#define JSONWRITE_POSIX
+#include "../json-write.h"
+#include <assert.h>
+
+static char fragment[JSONW_REF_THRESHOLD*3];
+static char clean_string[JSONW_REF_THRESHOLD*2];
+static char dirty_string[JSONW_REF_THRESHOLD*2];
+
+static void write_document(JSON_Write_Data *j, int use_refs) {
+  int i;
+
+  jsonw_v_table_begin(j);
+    jsonw_kv_int(j, "version", 1);
+
+    jsonw_k(j, "blobs");
+    jsonw_v_array_begin(j);
+    for(i = 0; i < 100; i++) {
+      if(use_refs) {
+        jsonw_v_raw_ref(j, fragment, strlen(fragment));
+        jsonw_v_stringlen_ref(j, clean_string, strlen(clean_string));
+        jsonw_v_stringlen_ref(j, dirty_string, strlen(dirty_string));
+        jsonw_v_stringlen_ref(j, "short", 5);
+      }
+      else {
+        jsonw_v_raw(j, fragment, strlen(fragment));
+        jsonw_v_stringlen(j, clean_string, strlen(clean_string));
+        jsonw_v_stringlen(j, dirty_string, strlen(dirty_string));
+        jsonw_v_stringlen(j, "short", 5);
+      }
+      jsonw_v_int(j, i);
+    }
+    jsonw_v_array_end(j);
+  jsonw_v_table_end(j);
+}
+
+static long read_all(FILE *f, char *buf, long size) {
+  fflush(f);
+  fseek(f, 0, SEEK_SET);
+  return fread(buf, 1, size, f);
+}
+
+int main() {
+  static char expected[1024*1024*4];
+  static char got[1024*1024*4];
+  static char buf[64];
+  static char big_buf[1024*64];
+  long expected_len, got_len;
+  unsigned long i;
+  FILE *f;
+
+  JSON_Write_Data json;
+  JSON_Write_Data * j = &json;
+  JSON_Write_Fd fd_sink;
+
+  /* [1,1,1,...,1] */
+  fragment[0] = '[';
+  for(i = 1; i + 2 < sizeof(fragment); i += 2) {
+    fragment[i] = '1';
+    fragment[i+1] = ',';
+  }
+  fragment[i-1] = ']';
+
+  memset(clean_string, 'a', sizeof(clean_string) - 1);
+  memset(dirty_string, 'b', sizeof(dirty_string) - 1);
+  dirty_string[100] = '\n';
+
+  f = tmpfile();
+  jsonw_init(j, f);
+  write_document(j, 0);
+  assert(jsonw_finish(j));
+  expected_len = read_all(f, expected, sizeof(expected));
+  fclose(f);
+
+  f = tmpfile();
+  jsonw_init_fd(j, &fd_sink, fileno(f), buf, sizeof(buf));
+  write_document(j, 1);
+  assert(jsonw_finish(j));
+  got_len = read_all(f, got, sizeof(got));
+  fclose(f);
+
+  assert(expected_len > 0);
+  assert(expected_len == got_len);
+  assert(memcmp(expected, got, expected_len) == 0);
+
+  /* Referenced memory is only read on flush, so changing it before that shows up in the output. */
+  f = tmpfile();
+  jsonw_init_fd(j, &fd_sink, fileno(f), buf, sizeof(buf));
+  jsonw_v_stringlen_ref(j, clean_string, strlen(clean_string));
+  clean_string[0] = 'z';
+  assert(jsonw_finish(j));
+  got_len = read_all(f, got, sizeof(got));
+  fclose(f);
+
+  assert(got_len == (long)strlen(clean_string) + 2);
+  assert(got[0] == '\"' && got[1] == 'z');
+
+  /* More references than fit in the iovec list between two flushes of a big buffer. */
+  f = tmpfile();
+  jsonw_init(j, f);
+  jsonw_v_array_begin(j);
+  for(i = 0; i < JSONW_IOV_COUNT; i++) jsonw_v_raw(j, fragment, strlen(fragment));
+  jsonw_v_array_end(j);
+  assert(jsonw_finish(j));
+  expected_len = read_all(f, expected, sizeof(expected));
+  fclose(f);
+
+  f = tmpfile();
+  jsonw_init_fd(j, &fd_sink, fileno(f), big_buf, sizeof(big_buf));
+  jsonw_v_array_begin(j);
+  for(i = 0; i < JSONW_IOV_COUNT; i++) jsonw_v_raw_ref(j, fragment, strlen(fragment));
+  jsonw_v_array_end(j);
+  assert(jsonw_finish(j));
+  got_len = read_all(f, got, sizeof(got));
+  fclose(f);
+
+  assert(expected_len == got_len);
+  assert(memcmp(expected, got, expected_len) == 0);
+
+  return 0;
+}